@@ -0,0 +1,130 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+
+// Times a resize down to a quarter, a blur and a resize back up of 1080p and
+// 1440p sources, run as separate passes of each filter and as the sequence,
+// which folds them into a single pyramid blur. Also times a 33 tap blur
+// repeated at full resolution, as separate passes and as the repeat filter.
+
+#include <silicabackground/convolutionfilter.h>
+#include <silicabackground/repeatfilter.h>
+#include <silicabackground/resizefilter.h>
+#include <silicabackground/sequencefilter.h>
+#include <silicabackground/task.h>
+
+#include <QElapsedTimer>
+#include <QGuiApplication>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLFunctions>
+#include <QScopedPointer>
+#include <QTextStream>
+
+using namespace Sailfish::Silica::Background;
+
+namespace {
+
+const int Iterations = 200;
+const int Scale = 4;
+const int Repetitions = 3;
+
+TextureInfo texture(const QOpenGLFramebufferObject &buffer)
+{
+    return TextureInfo(buffer.texture(), GL_RGBA, buffer.size());
+}
+
+// Milliseconds per run, waiting for the GPU to finish each one.
+template <typename Run>
+qreal time(Run run)
+{
+    QOpenGLFunctions *gl = QOpenGLContext::currentContext()->functions();
+    run();
+    gl->glFinish();
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < Iterations; ++i) {
+        run();
+        gl->glFinish();
+    }
+    return timer.nsecsElapsed() / 1e6 / Iterations;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QGuiApplication application(argc, argv);
+
+    QOffscreenSurface surface;
+    surface.create();
+    QOpenGLContext context;
+    if (!context.create() || !context.makeCurrent(&surface)) {
+        qWarning("Unable to create an OpenGL context");
+        return 1;
+    }
+
+    QTextStream out(stdout);
+    for (const QSize &size : { QSize(1920, 1080), QSize(2560, 1440) }) {
+        ResizeFilter down;
+        down.setSize(size / Scale);
+        down.setKernel(Kernel::gaussian(Kernel::SampleSize5, 1));
+        ConvolutionFilter blur;
+        blur.setKernel(Kernel::gaussian(Kernel::SampleSize17, 3));
+        ResizeFilter up;
+        up.setSize(size);
+
+        SequenceFilter sequence;
+        sequence.setFilters({ &down, &blur, &up });
+
+        QOpenGLFramebufferObject source(size);
+        QOpenGLFramebufferObject small(size / Scale);
+        QOpenGLFramebufferObject blurred(size / Scale);
+        QOpenGLFramebufferObject target(size);
+
+        const QScopedPointer<Task> downTask(down.createTask());
+        const QScopedPointer<Task> blurTask(blur.createTask());
+        const QScopedPointer<Task> upTask(up.createTask());
+        const qreal passes = time([&]() {
+            downTask->execute(texture(source), texture(small));
+            blurTask->execute(texture(small), texture(blurred));
+            upTask->execute(texture(blurred), texture(target));
+        });
+
+        const QScopedPointer<Task> sequenceTask(sequence.createTask());
+        const qreal pyramid = time([&]() {
+            sequenceTask->execute(texture(source), texture(target));
+        });
+
+        ConvolutionFilter wideBlur;
+        wideBlur.setKernel(Kernel::gaussian(Kernel::SampleSize33, 6));
+        RepeatFilter repeat;
+        repeat.setFilters({ &wideBlur });
+        repeat.setRepetitions(Repetitions);
+
+        QOpenGLFramebufferObject intermediate(size);
+
+        const QScopedPointer<Task> wideBlurTask(wideBlur.createTask());
+        const qreal fullPasses = time([&]() {
+            const QOpenGLFramebufferObject *input = &source;
+            for (int i = 0; i < Repetitions; ++i) {
+                QOpenGLFramebufferObject *output = i % 2 ? &target : &intermediate;
+                wideBlurTask->execute(texture(*input), texture(*output));
+                input = output;
+            }
+        });
+
+        const QScopedPointer<Task> repeatTask(repeat.createTask());
+        const qreal fullPyramid = time([&]() {
+            repeatTask->execute(texture(source), texture(target));
+        });
+
+        out << size.width() << 'x' << size.height()
+            << ": passes " << passes << " ms, pyramid " << pyramid << " ms\n"
+            << size.width() << 'x' << size.height() << ' ' << Repetitions << "x33 taps"
+            << ": passes " << fullPasses << " ms, pyramid " << fullPyramid << " ms\n";
+        out.flush();
+    }
+
+    return 0;
+}
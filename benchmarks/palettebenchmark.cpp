@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+
+// Times theme changes with 10000 palettes, one in ten with a connected
+// change signal as if bound from QML.
+//
+// Theme::_setHighlightColor() doesn't reach palettes at all, their default
+// highlight color is a constant of ThemeColors, so its time is independent
+// of the palettes and only included for comparison. Switching the color
+// scheme is what refreshes palettes: the watched ones are notified at once,
+// the rest only resolve their colors when next read, which is timed
+// separately.
+
+#include <silicapalette.h>
+#include <silicatheme.h>
+
+#include <QElapsedTimer>
+#include <QGuiApplication>
+#include <QTextStream>
+
+#include <memory>
+#include <vector>
+
+using namespace Silica;
+
+namespace {
+
+const int PaletteCount = 10000;
+const int WatchedInterval = 10;
+const int Iterations = 100;
+
+}
+
+int main(int argc, char *argv[])
+{
+    QGuiApplication application(argc, argv);
+
+    Theme *theme = Theme::instance();
+
+    int notifications = 0;
+    std::vector<std::unique_ptr<Palette>> palettes;
+    palettes.reserve(PaletteCount);
+    for (int i = 0; i < PaletteCount; ++i) {
+        palettes.emplace_back(new Palette);
+        if (i % WatchedInterval == 0) {
+            QObject::connect(palettes.back().get(), &Palette::primaryColorChanged,
+                             [&notifications]() { ++notifications; });
+        }
+    }
+
+    QTextStream out(stdout);
+    QElapsedTimer timer;
+
+    timer.start();
+    for (int i = 0; i < Iterations; ++i) {
+        theme->_setHighlightColor(QColor::fromHsv(i * 360 / Iterations, 255, 255));
+    }
+    out << "highlight color: " << timer.nsecsElapsed() / 1e3 / Iterations << " us per change\n";
+    out.flush();
+
+    qint64 schemeTime = 0;
+    qint64 readTime = 0;
+    for (int i = 0; i < Iterations; ++i) {
+        timer.start();
+        theme->setColorScheme(i % 2 ? Theme::LightOnDark : Theme::DarkOnLight);
+        schemeTime += timer.nsecsElapsed();
+
+        timer.start();
+        for (const std::unique_ptr<Palette> &palette : palettes) {
+            palette->primaryColor();
+        }
+        readTime += timer.nsecsElapsed();
+    }
+    out << "color scheme: " << schemeTime / 1e3 / Iterations << " us per change, "
+        << notifications << " notifications\n";
+    out << "reading all palettes: " << readTime / 1e3 / Iterations << " us per change\n";
+    out.flush();
+
+    return 0;
+}
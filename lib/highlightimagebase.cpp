@@ -1,14 +1,147 @@
 #include "highlightimagebase.h"
 #include "silicatheme.h"
 #include "silicapalette.h"
-#include "silicapalette.h"
+#include "themetexturefactory.h"
+
+#include <QOpenGLShaderProgram>
+#include <QSGGeometryNode>
+#include <QSGMaterial>
+#include <QSGMaterialShader>
+#include <QVector4D>
+
+#include <private/qquickimagebase_p_p.h>
+#include <private/qquickwindow_p.h>
+#include <private/qsgcontext_p.h>
 
 namespace Silica {
 
+namespace {
+
+// Colors the alpha mask of a monochrome icon, so a color change only updates
+// a uniform.
+class TintMaterial : public QSGMaterial
+{
+public:
+    TintMaterial()
+    {
+        setFlag(Blending);
+    }
+
+    QSGMaterialType *type() const override
+    {
+        static QSGMaterialType type;
+        return &type;
+    }
+
+    QSGMaterialShader *createShader() const override;
+
+    int compare(const QSGMaterial *other) const override
+    {
+        const TintMaterial *material = static_cast<const TintMaterial *>(other);
+        if (const int diff = texture->textureId() - material->texture->textureId()) {
+            return diff;
+        }
+        for (int i = 0; i < 4; ++i) {
+            if (color[i] != material->color[i]) {
+                return color[i] < material->color[i] ? -1 : 1;
+            }
+        }
+        return 0;
+    }
+
+    QSGTexture *texture = nullptr;
+    // Premultiplied
+    QVector4D color;
+};
+
+class TintShader : public QSGMaterialShader
+{
+public:
+    const char *vertexShader() const override
+    {
+        return "attribute highp vec4 qt_Vertex;\n"
+               "attribute highp vec2 qt_MultiTexCoord0;\n"
+               "uniform highp mat4 qt_Matrix;\n"
+               "varying highp vec2 texCoord;\n"
+               "void main() {\n"
+               "    texCoord = qt_MultiTexCoord0;\n"
+               "    gl_Position = qt_Matrix * qt_Vertex;\n"
+               "}";
+    }
+
+    const char *fragmentShader() const override
+    {
+        return "uniform sampler2D qt_Texture;\n"
+               "uniform lowp vec4 color;\n"
+               "uniform lowp float qt_Opacity;\n"
+               "varying highp vec2 texCoord;\n"
+               "void main() {\n"
+               "    gl_FragColor = color * (texture2D(qt_Texture, texCoord).a * qt_Opacity);\n"
+               "}";
+    }
+
+    char const *const *attributeNames() const override
+    {
+        static char const *const names[] = { "qt_Vertex", "qt_MultiTexCoord0", nullptr };
+        return names;
+    }
+
+    void initialize() override
+    {
+        id_matrix = program()->uniformLocation("qt_Matrix");
+        id_opacity = program()->uniformLocation("qt_Opacity");
+        id_color = program()->uniformLocation("color");
+    }
+
+    void updateState(const RenderState &state, QSGMaterial *newMaterial, QSGMaterial *) override
+    {
+        TintMaterial *material = static_cast<TintMaterial *>(newMaterial);
+        if (state.isMatrixDirty()) {
+            program()->setUniformValue(id_matrix, state.combinedMatrix());
+        }
+        if (state.isOpacityDirty()) {
+            program()->setUniformValue(id_opacity, state.opacity());
+        }
+        program()->setUniformValue(id_color, material->color);
+        material->texture->bind();
+    }
+
+private:
+    int id_matrix = -1;
+    int id_opacity = -1;
+    int id_color = -1;
+};
+
+QSGMaterialShader *TintMaterial::createShader() const
+{
+    return new TintShader;
+}
+
+class TintedImageNode : public QSGGeometryNode
+{
+public:
+    TintedImageNode()
+        : m_geometry(QSGGeometry::defaultAttributes_TexturedPoint2D(), 4)
+    {
+        setGeometry(&m_geometry);
+        setMaterial(&m_material);
+    }
+
+    QSGGeometry m_geometry;
+    TintMaterial m_material;
+};
+
+QVector4D premultiplied(const QColor &color)
+{
+    const float alpha = color.alphaF();
+    return QVector4D(color.redF() * alpha, color.greenF() * alpha, color.blueF() * alpha, alpha);
+}
+
+}
+
 HighlightImageBase::HighlightImageBase(QQuickItem *parent)
     : QQuickImage(parent)
     , m_highlighted(false)
-    , m_color(Qt::black)
     , m_highlightColor(Qt::white)
     , m_colorWeight(1.0)
     , m_monochromeWeight(0.0)
@@ -46,10 +179,78 @@ double HighlightImageBase::monochromeWeight() const
     return m_monochromeWeight;
 }
 
+QSGNode *HighlightImageBase::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data)
+{
+    QQuickImageBasePrivate *d = static_cast<QQuickImageBasePrivate *>(QQuickItemPrivate::get(this));
+    ThemeTextureFactory *factory = qobject_cast<ThemeTextureFactory *>(d->pix.textureFactory());
+    TintedImageNode *node = dynamic_cast<TintedImageNode *>(oldNode);
+
+    // Monochrome theme icons are tinted from their shared mask, anything else
+    // and fill modes that tile or crop are drawn by QQuickImage.
+    if (!factory || width() <= 0 || height() <= 0
+            || (fillMode() != Stretch && fillMode() != PreserveAspectFit)) {
+        if (node) {
+            delete node;
+            oldNode = nullptr;
+        }
+        return QQuickImage::updatePaintNode(oldNode, data);
+    }
+
+    if (!node) {
+        delete oldNode;
+        node = new TintedImageNode;
+    }
+
+    QSGTexture *texture = QQuickWindowPrivate::get(window())->context->textureForFactory(
+                factory->maskFactory(), window());
+    if (!texture) {
+        delete node;
+        return nullptr;
+    }
+    texture->setFiltering(smooth() ? QSGTexture::Linear : QSGTexture::Nearest);
+
+    QRectF target(0, 0, width(), height());
+    if (fillMode() == PreserveAspectFit) {
+        target.setSize(QSizeF(paintedWidth(), paintedHeight()));
+        if (horizontalAlignment() == AlignRight) {
+            target.moveLeft(width() - target.width());
+        } else if (horizontalAlignment() == AlignHCenter) {
+            target.moveLeft((width() - target.width()) / 2);
+        }
+        if (verticalAlignment() == AlignBottom) {
+            target.moveTop(height() - target.height());
+        } else if (verticalAlignment() == AlignVCenter) {
+            target.moveTop((height() - target.height()) / 2);
+        }
+    }
+    QSGGeometry::updateTexturedRectGeometry(&node->m_geometry, target,
+                                            mirror() ? QRectF(1, 0, -1, 1) : QRectF(0, 0, 1, 1));
+
+    QColor tint;
+    if (m_highlighted) {
+        tint = m_highlightColor;
+    } else if (m_color.isValid()) {
+        const QColor base = factory->color();
+        const qreal weight = qBound(0.0, m_colorWeight, 1.0);
+        tint = QColor::fromRgbF(base.redF() + (m_color.redF() - base.redF()) * weight,
+                                base.greenF() + (m_color.greenF() - base.greenF()) * weight,
+                                base.blueF() + (m_color.blueF() - base.blueF()) * weight,
+                                base.alphaF() + (m_color.alphaF() - base.alphaF()) * weight);
+    } else {
+        tint = factory->color();
+    }
+
+    node->m_material.texture = texture;
+    node->m_material.color = premultiplied(tint);
+    node->markDirty(QSGNode::DirtyGeometry | QSGNode::DirtyMaterial);
+    return node;
+}
+
 void HighlightImageBase::setHighlighted(bool highlighted)
 {
     if (m_highlighted != highlighted) {
         m_highlighted = highlighted;
+        update();
         emit highlightedChanged();
     }
 }
@@ -58,6 +259,7 @@ void HighlightImageBase::setColor(const QColor &color)
 {
     if (m_color != color) {
         m_color = color;
+        update();
         emit colorChanged();
     }
 }
@@ -66,6 +268,7 @@ void HighlightImageBase::setHighlightColor(const QColor &highlightColor)
 {
     if (m_highlightColor != highlightColor) {
         m_highlightColor = highlightColor;
+        update();
         emit highlightColorChanged();
     }
 }
@@ -74,6 +277,7 @@ void HighlightImageBase::setColorWeight(double weight)
 {
     if (m_colorWeight != weight) {
         m_colorWeight = weight;
+        update();
         emit colorWeightChanged();
     }
 }
@@ -36,6 +36,9 @@ public:
     void setColorWeight(double weight);
     void setMonochromeWeight(double weight);
 
+protected:
+    QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data) override;
+
 signals:
     void highlightedChanged();
     void colorChanged();
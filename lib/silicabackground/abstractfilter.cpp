@@ -2,17 +2,71 @@
 
 #include "abstractfilter.h"
 #include "abstractfilter_p.h"
+#include "task_p.h"
 
+#include <QDataStream>
 #include <QImage>
+#include <QMetaProperty>
+#include <QOpenGLContext>
 #include <QQuickWindow>
 
 namespace Sailfish { namespace Silica { namespace Background {
 
+static QVariantMap propertyValues(QObject *object, int offset)
+{
+    QVariantMap values;
+    if (object) {
+        const QMetaObject *metaObject = object->metaObject();
+        for (int i = offset; i < metaObject->propertyCount(); ++i) {
+            const QMetaProperty property = metaObject->property(i);
+            values.insert(QString::fromLatin1(property.name()), property.read(object));
+        }
+    }
+    return values;
+}
+
+FilterTask *AbstractFilterPrivate::createTask() const
+{
+    return new CopyTask;
+}
+
+bool AbstractFilterPrivate::writeKey(QDataStream &) const
+{
+    return false;
+}
+
+AbstractFilterPrivate::ImageFunction AbstractFilterPrivate::imageFunction() const
+{
+    return [](const QImage &source) { return source; };
+}
+
+AbstractFilterPrivate::ImageFunction AbstractFilterPrivate::filterImageFunction(const AbstractFilter *filter)
+{
+    if (!filter || !filter->isValid()) {
+        return [](const QImage &source) { return source; };
+    }
+    return get(filter)->imageFunction();
+}
+
+bool AbstractFilterPrivate::writeFilterKey(const AbstractFilter *filter, QDataStream &stream)
+{
+    if (!filter) {
+        return false;
+    }
+    const bool valid = filter->isValid();
+    stream << QByteArray(filter->metaObject()->className()) << valid;
+    return !valid || get(filter)->writeKey(stream);
+}
+
 AbstractFilter::AbstractFilter(AbstractFilterPrivate &dd, QObject *parent)
     : QObject(parent)
     , d_ptr(&dd)
 {
     d_ptr->q_ptr = this;
+
+    connect(this, &AbstractFilter::filterChanged, this, [this]() {
+        ++d_ptr->revision;
+    });
 }
 
 AbstractFilter::~AbstractFilter() = default;
@@ -35,7 +89,8 @@ void AbstractFilter::setEnabled(bool enabled)
 
 QSize AbstractFilter::targetSize(const QSize &sourceSize) const
 {
-    return sourceSize;
+    Q_D(const AbstractFilter);
+    return isValid() ? d->targetSize(sourceSize) : sourceSize;
 }
 
 bool AbstractFilter::isValid() const
@@ -43,39 +98,53 @@ bool AbstractFilter::isValid() const
     return isEnabled();
 }
 
-bool AbstractFilter::apply(const TextureInfo &/*source*/, const TextureInfo &/*target*/, QObject * /*properties*/, int /*propertyOffset*/, QQuickWindow * /*window*/)
+bool AbstractFilter::apply(const TextureInfo &source, const TextureInfo &target, QObject *properties, int propertyOffset, QQuickWindow *window)
 {
-    // Not implemented for texture path in minimal version
-    return false;
+    Q_UNUSED(window)
+    return apply(source, target, propertyValues(properties, propertyOffset));
 }
 
 bool AbstractFilter::apply(const TextureInfo &source, const TextureInfo &target, const QVariantMap &properties)
 {
-    Q_UNUSED(source)
-    Q_UNUSED(target)
-    Q_UNUSED(properties)
-    return false;
+    if (!QOpenGLContext::currentContext() || !target.id) {
+        return false;
+    }
+
+    QScopedPointer<Task> task(updateTask(nullptr, properties));
+    task->execute(source, target);
+    return true;
 }
 
 QImage AbstractFilter::apply(const QImage &source, QObject * /*properties*/, int /*propertyOffset*/, QQuickWindow * /*window*/)
 {
-    // Default: return unchanged
-    return source;
+    Q_D(const AbstractFilter);
+    // Disabled filters pass the source through.
+    return isValid() ? d->applyToImage(source) : source;
 }
 
 QImage AbstractFilter::apply(const QImage &source, const QVariantMap &/*properties*/)
 {
-    return source;
+    return apply(source);
 }
 
-Task *AbstractFilter::updateTask(Task *task, QObject * /*properties*/, int /*propertyOffset*/, QQuickWindow * /*window*/, const QMetaMethod &/*update*/)
+Task *AbstractFilter::updateTask(Task *task, QObject *properties, int propertyOffset, QQuickWindow *window, const QMetaMethod &update)
 {
-    return task; // no-op
+    Q_UNUSED(window)
+    Q_UNUSED(update)
+    return updateTask(task, propertyValues(properties, propertyOffset));
 }
 
-Task *AbstractFilter::updateTask(Task *task, const QVariantMap &/*properties*/)
+Task *AbstractFilter::updateTask(Task *task, const QVariantMap &properties)
 {
-    return task; // no-op
+    Q_D(const AbstractFilter);
+
+    // Tasks passed back in were created by this filter.
+    FilterTask *filterTask = static_cast<FilterTask *>(task);
+    if (!filterTask) {
+        filterTask = d->createTask();
+    }
+    filterTask->update(this, properties);
+    return filterTask;
 }
 
 }}}
@@ -3,16 +3,58 @@
 #ifndef SAILFISH_SILICA_BACKGROUND_ABSTRACTFILTER_P_H
 #define SAILFISH_SILICA_BACKGROUND_ABSTRACTFILTER_P_H
 
+#include "abstractfilter.h"
+
+#include <QImage>
 #include <QtGlobal>
 
+#include <functional>
+
+QT_BEGIN_NAMESPACE
+class QDataStream;
+QT_END_NAMESPACE
+
 namespace Sailfish { namespace Silica { namespace Background {
 
-class AbstractFilter;
+class FilterTask;
 
 class AbstractFilterPrivate {
 public:
     Q_DECLARE_PUBLIC(AbstractFilter)
+    typedef std::function<QImage(const QImage &)> ImageFunction;
+
+    virtual ~AbstractFilterPrivate() = default;
+
+    // CPU implementation of the filter, called only while the filter is valid.
+    virtual QImage applyToImage(const QImage &source) const { return source; }
+
+    // applyToImage() bound to a copy of the current state of the filter, so
+    // images can be filtered on other threads while the filter changes or is
+    // destroyed. Called on the GUI thread, only while the filter is valid.
+    virtual ImageFunction imageFunction() const;
+
+    virtual QSize targetSize(const QSize &sourceSize) const { return sourceSize; }
+
+    // Render thread implementation of the filter.
+    virtual FilterTask *createTask() const;
+
+    // Writes the state that determines the output of applyToImage(), for
+    // FilterCache keys. Returns false if the output depends on more than that.
+    virtual bool writeKey(QDataStream &stream) const;
+
+    // Writes the type and enabled state of the filter, followed by its key if
+    // enabled.
+    static bool writeFilterKey(const AbstractFilter *filter, QDataStream &stream);
+
+    // imageFunction() of the filter, or one passing the image through if the
+    // filter is not valid.
+    static ImageFunction filterImageFunction(const AbstractFilter *filter);
+
+    static const AbstractFilterPrivate *get(const AbstractFilter *filter) { return filter->d_func(); }
+
     AbstractFilter *q_ptr = nullptr;
+    // Incremented whenever filterChanged() is emitted.
+    uint revision = 0;
     bool enabled = true;
 };
 
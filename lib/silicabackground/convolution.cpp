@@ -0,0 +1,212 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+
+#include "convolution_p.h"
+
+#include <QThread>
+#include <QVarLengthArray>
+#include <QVector>
+#include <QtConcurrent>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace Sailfish { namespace Silica { namespace Background {
+
+namespace {
+
+const int WeightShift = 14;
+const int MinimumBandHeight = 16;
+const int TransposeBlock = 32;
+
+struct Band
+{
+    int begin;
+    int end;
+};
+
+// Splits rows into a few bands per thread so that uneven scheduling evens out.
+QVector<Band> bands(int rows)
+{
+    const int threads = qMax(1, QThread::idealThreadCount());
+    const int height = qMax(MinimumBandHeight, (rows + threads * 2 - 1) / (threads * 2));
+
+    QVector<Band> result;
+    for (int begin = 0; begin < rows; begin += height) {
+        result.append({ begin, qMin(rows, begin + height) });
+    }
+    return result;
+}
+
+template <typename Function>
+void forEachBand(int rows, Function function)
+{
+    QVector<Band> list = bands(rows);
+    if (list.count() == 1) {
+        function(list.first());
+    } else {
+        QtConcurrent::blockingMap(list, function);
+    }
+}
+
+// Weights in fixed point, taken in pairs so two source rows are multiplied and
+// summed in one step. An odd kernel gets a trailing zero weight.
+QVector<qint16> fixedWeights(const Kernel &kernel)
+{
+    const int count = kernel.weightCount();
+    const float *weights = kernel.weights();
+
+    QVector<qint16> result((count + 1) & ~1, 0);
+    int sum = 0;
+    float weightSum = 0;
+    for (int i = 0; i < count; ++i) {
+        result[i] = qint16(qBound(-32768, qRound(weights[i] * (1 << WeightShift)), 32767));
+        sum += result[i];
+        weightSum += weights[i];
+    }
+
+    // Keep a normalized kernel from drifting the brightness through rounding.
+    if (qAbs(weightSum - 1.0f) < 1e-3f) {
+        result[count / 2] += (1 << WeightShift) - sum;
+    }
+    return result;
+}
+
+inline uchar clampChannel(int value)
+{
+    return uchar(qBound(0, (value + (1 << (WeightShift - 1))) >> WeightShift, 255));
+}
+
+// Convolves the columns of source into target, which has the same size. Every
+// channel of every pixel is independent, so a row is processed as bytes. The
+// target is written through its bits, scanLine() would detach it from every
+// band's thread.
+void convolveRows(const QImage &source, uchar *target, const QVector<qint16> &weights, const Band &band)
+{
+    const int taps = weights.count();
+    const int radius = (taps - 1) / 2;
+    const int bytes = source.width() * 4;
+    const int lastRow = source.height() - 1;
+
+    QVarLengthArray<const uchar *, 34> rows(taps);
+
+    for (int y = band.begin; y < band.end; ++y) {
+        for (int k = 0; k < taps; ++k) {
+            rows[k] = source.constScanLine(qBound(0, y + k - radius, lastRow));
+        }
+        uchar *out = target + qptrdiff(y) * source.bytesPerLine();
+        int x = 0;
+
+#if defined(__SSE2__)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i rounding = _mm_set1_epi32(1 << (WeightShift - 1));
+        for (; x + 16 <= bytes; x += 16) {
+            __m128i acc[4] = { zero, zero, zero, zero };
+            for (int k = 0; k < taps; k += 2) {
+                const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[k] + x));
+                const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[k + 1] + x));
+                const __m128i weight = _mm_set1_epi32(int((uint(quint16(weights[k + 1])) << 16) | quint16(weights[k])));
+                const __m128i aLo = _mm_unpacklo_epi8(a, zero);
+                const __m128i aHi = _mm_unpackhi_epi8(a, zero);
+                const __m128i bLo = _mm_unpacklo_epi8(b, zero);
+                const __m128i bHi = _mm_unpackhi_epi8(b, zero);
+                acc[0] = _mm_add_epi32(acc[0], _mm_madd_epi16(_mm_unpacklo_epi16(aLo, bLo), weight));
+                acc[1] = _mm_add_epi32(acc[1], _mm_madd_epi16(_mm_unpackhi_epi16(aLo, bLo), weight));
+                acc[2] = _mm_add_epi32(acc[2], _mm_madd_epi16(_mm_unpacklo_epi16(aHi, bHi), weight));
+                acc[3] = _mm_add_epi32(acc[3], _mm_madd_epi16(_mm_unpackhi_epi16(aHi, bHi), weight));
+            }
+            for (__m128i &value : acc) {
+                value = _mm_srai_epi32(_mm_add_epi32(value, rounding), WeightShift);
+            }
+            const __m128i lo = _mm_packs_epi32(acc[0], acc[1]);
+            const __m128i hi = _mm_packs_epi32(acc[2], acc[3]);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x), _mm_packus_epi16(lo, hi));
+        }
+#elif defined(__ARM_NEON)
+        for (; x + 16 <= bytes; x += 16) {
+            int32x4_t acc[4] = { vdupq_n_s32(0), vdupq_n_s32(0), vdupq_n_s32(0), vdupq_n_s32(0) };
+            for (int k = 0; k < taps; ++k) {
+                const uint8x16_t values = vld1q_u8(rows[k] + x);
+                const int16x8_t lo = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(values)));
+                const int16x8_t hi = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(values)));
+                acc[0] = vmlal_n_s16(acc[0], vget_low_s16(lo), weights[k]);
+                acc[1] = vmlal_n_s16(acc[1], vget_high_s16(lo), weights[k]);
+                acc[2] = vmlal_n_s16(acc[2], vget_low_s16(hi), weights[k]);
+                acc[3] = vmlal_n_s16(acc[3], vget_high_s16(hi), weights[k]);
+            }
+            const int16x8_t lo = vcombine_s16(vqrshrn_n_s32(acc[0], WeightShift), vqrshrn_n_s32(acc[1], WeightShift));
+            const int16x8_t hi = vcombine_s16(vqrshrn_n_s32(acc[2], WeightShift), vqrshrn_n_s32(acc[3], WeightShift));
+            vst1q_u8(out + x, vcombine_u8(vqmovun_s16(lo), vqmovun_s16(hi)));
+        }
+#endif
+
+        for (; x < bytes; ++x) {
+            int value = 0;
+            for (int k = 0; k < taps; ++k) {
+                value += weights[k] * rows[k][x];
+            }
+            out[x] = clampChannel(value);
+        }
+    }
+}
+
+void transposeRows(const QImage &source, uchar *target, int targetStride, const Band &band)
+{
+    // Blocks of source rows keep the target writes within a few cache lines.
+    for (int y0 = band.begin; y0 < band.end; y0 += TransposeBlock) {
+        const int y1 = qMin(band.end, y0 + TransposeBlock);
+        for (int x0 = 0; x0 < source.width(); x0 += TransposeBlock) {
+            const int x1 = qMin(source.width(), x0 + TransposeBlock);
+            for (int y = y0; y < y1; ++y) {
+                const QRgb *in = reinterpret_cast<const QRgb *>(source.constScanLine(y));
+                for (int x = x0; x < x1; ++x) {
+                    reinterpret_cast<QRgb *>(target + qptrdiff(x) * targetStride)[y] = in[x];
+                }
+            }
+        }
+    }
+}
+
+QImage convolveColumns(const QImage &source, const QVector<qint16> &weights)
+{
+    QImage target(source.size(), source.format());
+    uchar *bits = target.bits();
+    forEachBand(source.height(), [&](const Band &band) {
+        convolveRows(source, bits, weights, band);
+    });
+    return target;
+}
+
+QImage transposed(const QImage &source)
+{
+    QImage target(source.height(), source.width(), source.format());
+    uchar *bits = target.bits();
+    const int stride = target.bytesPerLine();
+    forEachBand(source.height(), [&](const Band &band) {
+        transposeRows(source, bits, stride, band);
+    });
+    return target;
+}
+
+}
+
+QImage convolve(const QImage &source, const Kernel &kernel)
+{
+    if (source.isNull() || kernel.isNull()) {
+        return source;
+    }
+
+    const QImage image = source.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    const QVector<qint16> weights = fixedWeights(kernel);
+
+    // The horizontal pass runs on the transposed image so both passes can
+    // combine whole rows of pixels.
+    QImage result = transposed(convolveColumns(transposed(image), weights));
+    result = convolveColumns(result, weights);
+    result.setDevicePixelRatio(source.devicePixelRatio());
+    return result;
+}
+
+}}}
@@ -0,0 +1,19 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+
+#ifndef SAILFISH_SILICA_BACKGROUND_CONVOLUTION_P_H
+#define SAILFISH_SILICA_BACKGROUND_CONVOLUTION_P_H
+
+#include "kernel.h"
+
+#include <QImage>
+
+namespace Sailfish { namespace Silica { namespace Background {
+
+// Convolves a premultiplied ARGB image with a 1D kernel horizontally and then
+// vertically, clamping samples at the edges. The weights are applied in fixed
+// point, so the result is identical with and without SIMD.
+QImage convolve(const QImage &source, const Kernel &kernel);
+
+}}}
+
+#endif // SAILFISH_SILICA_BACKGROUND_CONVOLUTION_P_H
@@ -2,9 +2,256 @@
 
 #include "convolutionfilter.h"
 #include "convolutionfilter_p.h"
+#include "convolution_p.h"
+
+#include <QDataStream>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLShaderProgram>
+#include <QtMath>
 
 namespace Sailfish { namespace Silica { namespace Background {
 
+static QByteArray convolutionShader(int taps)
+{
+    // GLSL ES 2 only allows loops with constant bounds.
+    return "#define TAPS " + QByteArray::number(taps) + "\n"
+           "uniform lowp sampler2D source;\n"
+           "uniform mediump float weights[TAPS];\n"
+           "uniform highp vec2 texelStep;\n"
+           "varying highp vec2 qt_TexCoord0;\n"
+           "void main() {\n"
+           "    highp vec2 coord = qt_TexCoord0 - float(TAPS / 2) * texelStep;\n"
+           "    mediump vec4 color = vec4(0.0);\n"
+           "    for (int i = 0; i < TAPS; ++i) {\n"
+           "        color += weights[i] * texture2D(source, coord);\n"
+           "        coord += texelStep;\n"
+           "    }\n"
+           "    gl_FragColor = color;\n"
+           "}\n";
+}
+
+// Standard deviation of a normalized, symmetric and non-negative kernel, or -1
+// if the kernel is anything but a blur.
+static qreal kernelDeviation(const Kernel &kernel)
+{
+    const float *weights = kernel.weights();
+    const int count = kernel.weightCount();
+    qreal sum = 0;
+    qreal variance = 0;
+    for (int i = 0; i < count; ++i) {
+        if (weights[i] < 0 || qAbs(weights[i] - weights[count - 1 - i]) > 1e-4f) {
+            return -1;
+        }
+        const int x = i - count / 2;
+        sum += weights[i];
+        variance += weights[i] * x * x;
+    }
+    if (count > 0 && qAbs(sum - 1) > 1e-2) {
+        return -1;
+    }
+    return qSqrt(variance);
+}
+
+// Smallest kernel sample size covering three deviations either side.
+static Kernel::SampleSize sampleSizeForDeviation(qreal deviation)
+{
+    const int taps = 2 * qCeil(3 * deviation) + 1;
+    return Kernel::SampleSize(qBound(int(Kernel::SampleSize5), (taps - 5 + 3) / 4, int(Kernel::SampleSize33)));
+}
+
+ConvolutionTask::ConvolutionTask() = default;
+
+ConvolutionTask::~ConvolutionTask() = default;
+
+void ConvolutionTask::synchronize(const AbstractFilter *filter)
+{
+    setKernel(static_cast<const ConvolutionFilter *>(filter)->kernel());
+}
+
+void ConvolutionTask::setKernel(const Kernel &kernel)
+{
+    m_kernel = kernel;
+    m_deviation = kernelDeviation(kernel);
+}
+
+qreal ConvolutionTask::blurDeviation() const
+{
+    return m_deviation;
+}
+
+QRectF ConvolutionTask::sourceRect(const QSize &) const
+{
+    return QRectF(0, 0, 1, 1);
+}
+
+void ConvolutionTask::render(const TextureInfo &source, const QSize &size)
+{
+    if (m_kernel.weightCount() == 0) {
+        copy(source, sourceRect(source.size));
+        return;
+    }
+
+    const uint target = boundFramebuffer();
+    const TextureInfo intermediate = renderHorizontal(source, size);
+    if (intermediate.id) {
+        bindFramebuffer(target, size);
+        renderVertical(intermediate, size);
+    }
+}
+
+TextureInfo ConvolutionTask::renderToBuffer(const TextureInfo &source, const QSize &size)
+{
+    if (m_kernel.weightCount() == 0) {
+        return FilterTask::renderToBuffer(source, size);
+    }
+
+    // The source is no longer needed after the horizontal pass, so the
+    // vertical pass may end in the buffer that held it.
+    const TextureInfo intermediate = renderHorizontal(source, size);
+    if (!intermediate.id) {
+        return intermediate;
+    }
+    QOpenGLFramebufferObject *buffer = bufferPool()->bind(size, intermediate);
+    renderVertical(intermediate, size);
+    return bufferTexture(buffer);
+}
+
+TextureInfo ConvolutionTask::renderHorizontal(const TextureInfo &source, const QSize &size)
+{
+    const int taps = m_kernel.weightCount();
+    if (!m_program || m_programTaps != taps) {
+        m_program.reset(createProgram(defaultVertexShader(), convolutionShader(taps)));
+        m_programTaps = taps;
+    }
+    if (!m_program) {
+        return TextureInfo();
+    }
+    m_program->bind();
+    m_program->setUniformValueArray("weights", m_kernel.weights(), taps, 1);
+
+    // The horizontal step is one target pixel within the sampled source rect.
+    const QRectF rect = sourceRect(source.size);
+    QOpenGLFramebufferObject *buffer = bufferPool()->bind(size, source);
+    m_program->setUniformValue("texelStep", GLfloat(rect.width() / size.width()), 0.0f);
+    draw(m_program.data(), source, rect);
+    return bufferTexture(buffer);
+}
+
+void ConvolutionTask::renderVertical(const TextureInfo &intermediate, const QSize &size)
+{
+    m_program->bind();
+    m_program->setUniformValue("texelStep", 0.0f, 1.0f / size.height());
+    draw(m_program.data(), intermediate);
+}
+
+PyramidBlurTask::PyramidBlurTask() = default;
+
+PyramidBlurTask::~PyramidBlurTask() = default;
+
+// Variance in source pixels that halving and scaling back up adds at a level.
+// Averaging two pixels contributes 1/4 and bilinear scaling by two 2/3.
+static qreal levelVariance(int level)
+{
+    return (1.0 / 4 + 2.0 / 3) * qreal(1 << (2 * level));
+}
+
+int PyramidBlurTask::levelCount(qreal deviation, const QSize &size)
+{
+    // Stop while the remaining blur is still a few pixels wide at the smallest
+    // level, so the halving never discards detail the blur would have kept.
+    int levels = 0;
+    QSize levelSize = size;
+    while (levels < MaximumLevels
+           && deviation / (2 << levels) >= 2
+           && levelSize.width() / 2 >= MinimumLevelSize
+           && levelSize.height() / 2 >= MinimumLevelSize) {
+        levelSize = QSize((levelSize.width() + 1) / 2, (levelSize.height() + 1) / 2);
+        ++levels;
+    }
+    return levels;
+}
+
+void PyramidBlurTask::setBlur(qreal deviation, int levels)
+{
+    levels = qBound(0, levels, int(MaximumLevels));
+    if (deviation == m_deviation && levels == m_levelCount) {
+        return;
+    }
+    m_deviation = deviation;
+    m_levelCount = levels;
+
+    qreal variance = deviation * deviation;
+    for (int level = 0; level < levels; ++level) {
+        variance -= levelVariance(level);
+    }
+    const qreal levelDeviation = qSqrt(qMax<qreal>(variance, 0)) / (1 << levels);
+    m_blur.setKernel(levelDeviation > 0
+            ? Kernel::gaussian(sampleSizeForDeviation(levelDeviation), levelDeviation)
+            : Kernel());
+}
+
+qreal PyramidBlurTask::blurDeviation() const
+{
+    return m_deviation;
+}
+
+void PyramidBlurTask::render(const TextureInfo &source, const QSize &size)
+{
+    const uint target = boundFramebuffer();
+
+    TextureInfo input = source;
+    QSize levelSize = size;
+    for (int level = 0; level < m_levelCount; ++level) {
+        // Sampling between pixel centers averages each 2x2 block.
+        levelSize = QSize((levelSize.width() + 1) / 2, (levelSize.height() + 1) / 2);
+        bindBuffer(&m_levels[level], levelSize);
+        copy(input);
+        input = bufferTexture(m_levels[level].data());
+    }
+
+    bindBuffer(&m_blurred, levelSize);
+    m_blur.setBufferPool(bufferPool());
+    m_blur.render(input, levelSize);
+    input = bufferTexture(m_blurred.data());
+
+    // The halved levels are no longer needed and are reused on the way up.
+    for (int level = m_levelCount - 2; level >= 0; --level) {
+        bindBuffer(&m_levels[level], m_levels[level]->size());
+        copy(input);
+        input = bufferTexture(m_levels[level].data());
+    }
+
+    bindFramebuffer(target, size);
+    copy(input);
+}
+
+QImage ConvolutionFilterPrivate::applyToImage(const QImage &source) const
+{
+    return convolve(source, kernel);
+}
+
+AbstractFilterPrivate::ImageFunction ConvolutionFilterPrivate::imageFunction() const
+{
+    // Kernels are shared, setting a new one leaves this copy as it is.
+    const Kernel kernel = this->kernel;
+    return [kernel](const QImage &source) { return convolve(source, kernel); };
+}
+
+FilterTask *ConvolutionFilterPrivate::createTask() const
+{
+    return new ConvolutionTask;
+}
+
+bool ConvolutionFilterPrivate::writeKey(QDataStream &stream) const
+{
+    const float *weights = kernel.weights();
+    stream << qint32(kernel.weightCount());
+    for (int i = 0; i < kernel.weightCount(); ++i) {
+        stream << weights[i];
+    }
+    return true;
+}
+
 ConvolutionFilter::ConvolutionFilter(QObject *parent)
     : AbstractFilter(*new ConvolutionFilterPrivate, parent)
 {
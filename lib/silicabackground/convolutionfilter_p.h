@@ -5,11 +5,79 @@
 
 #include "abstractfilter_p.h"
 #include "convolutionfilter.h"
+#include "task_p.h"
 
 namespace Sailfish { namespace Silica { namespace Background {
 
+// Convolves horizontally into an intermediate buffer of the pool and from there
+// vertically into the target. The horizontal pass samples sourceRect of the
+// source at the target size, so subclasses can scale in the same pass.
+class ConvolutionTask : public FilterTask
+{
+public:
+    ConvolutionTask();
+    ~ConvolutionTask() override;
+
+    qreal blurDeviation() const override;
+    void render(const TextureInfo &source, const QSize &size) override;
+    TextureInfo renderToBuffer(const TextureInfo &source, const QSize &size) override;
+
+    void setKernel(const Kernel &kernel);
+
+protected:
+    void synchronize(const AbstractFilter *filter) override;
+    virtual QRectF sourceRect(const QSize &sourceSize) const;
+
+private:
+    // Binds the program and renders the horizontal pass, returns its result.
+    TextureInfo renderHorizontal(const TextureInfo &source, const QSize &size);
+    void renderVertical(const TextureInfo &intermediate, const QSize &size);
+
+    Kernel m_kernel;
+    qreal m_deviation = 0;
+    QScopedPointer<QOpenGLShaderProgram> m_program;
+    int m_programTaps = 0;
+};
+
+// Approximates a wide Gaussian blur by halving the source a number of times,
+// each halving averaging 2x2 pixels, blurring the smallest level with a short
+// kernel and scaling back up with bilinear sampling. The kernel only makes up
+// the part of the deviation the halving and scaling do not already blur by.
+class PyramidBlurTask : public FilterTask
+{
+public:
+    enum {
+        MaximumLevels = 4,
+        MinimumLevelSize = 16
+    };
+
+    PyramidBlurTask();
+    ~PyramidBlurTask() override;
+
+    // Number of levels worth halving a source of the given size to for a blur
+    // of the given deviation, zero if the blur is narrow enough to do directly.
+    static int levelCount(qreal deviation, const QSize &size);
+
+    void setBlur(qreal deviation, int levels);
+
+    qreal blurDeviation() const override;
+    void render(const TextureInfo &source, const QSize &size) override;
+
+private:
+    ConvolutionTask m_blur;
+    QScopedPointer<QOpenGLFramebufferObject> m_levels[MaximumLevels];
+    QScopedPointer<QOpenGLFramebufferObject> m_blurred;
+    qreal m_deviation = 0;
+    int m_levelCount = 0;
+};
+
 class ConvolutionFilterPrivate : public AbstractFilterPrivate {
 public:
+    QImage applyToImage(const QImage &source) const override;
+    ImageFunction imageFunction() const override;
+    FilterTask *createTask() const override;
+    bool writeKey(QDataStream &stream) const override;
+
     Kernel kernel;
 };
 
@@ -0,0 +1,178 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+
+#include "filtercache_p.h"
+#include "abstractfilter_p.h"
+#include "../logging.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <cstring>
+
+namespace Sailfish { namespace Silica { namespace Background {
+
+namespace {
+
+const quint32 CacheMagic = 0x46424953; // "SIBF"
+const quint32 CacheVersion = 1;
+// Least recently used entries are removed once the cache grows beyond this.
+const qint64 MaximumCacheSize = 64 * 1024 * 1024;
+
+// File layout: header followed by height scan lines of bytesPerLine bytes. The
+// header is a multiple of 16 bytes so the mapped scan lines stay aligned.
+struct CacheHeader
+{
+    quint32 magic;
+    quint32 version;
+    quint32 width;
+    quint32 height;
+    quint32 bytesPerLine;
+    quint32 format;
+    quint32 reserved[2];
+};
+
+QString filePath(const QByteArray &key)
+{
+    const QString directory = FilterCache::directory();
+    return directory.isEmpty() || key.isEmpty()
+            ? QString()
+            : directory + QLatin1Char('/') + QString::fromLatin1(key) + QStringLiteral(".raw");
+}
+
+void releaseFile(void *file)
+{
+    delete static_cast<QFile *>(file);
+}
+
+void prune(const QString &directory)
+{
+    QFileInfoList entries = QDir(directory).entryInfoList(
+                QStringList() << QStringLiteral("*.raw"), QDir::Files, QDir::Time);
+
+    qint64 size = 0;
+    for (const QFileInfo &entry : entries) {
+        size += entry.size();
+    }
+    // Entries are sorted newest first, load() refreshes the time of hits.
+    while (size > MaximumCacheSize && !entries.isEmpty()) {
+        const QFileInfo entry = entries.takeLast();
+        if (QFile::remove(entry.filePath())) {
+            size -= entry.size();
+        }
+    }
+}
+
+}
+
+QString FilterCache::directory()
+{
+    const QString location = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation);
+    return location.isEmpty() ? QString() : location + QStringLiteral("/sailfish-silica/backgrounds");
+}
+
+QByteArray FilterCache::key(const QString &sourcePath, const QList<AbstractFilter *> &filters, const QSize &targetSize)
+{
+    const QFileInfo info(sourcePath);
+    if (!info.isFile()) {
+        return QByteArray();
+    }
+
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << CacheVersion
+           << info.canonicalFilePath()
+           << info.lastModified().toMSecsSinceEpoch()
+           << info.size()
+           << targetSize;
+    for (const AbstractFilter *filter : filters) {
+        if (!AbstractFilterPrivate::writeFilterKey(filter, stream)) {
+            return QByteArray();
+        }
+    }
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex();
+}
+
+QImage FilterCache::load(const QByteArray &key)
+{
+    const QString path = filePath(key);
+    if (path.isEmpty()) {
+        return QImage();
+    }
+
+    QFile *file = new QFile(path);
+    const uchar *data = file->open(QIODevice::ReadOnly) ? file->map(0, file->size()) : nullptr;
+    CacheHeader header;
+    if (!data || file->size() < qint64(sizeof(CacheHeader))) {
+        delete file;
+        return QImage();
+    }
+    memcpy(&header, data, sizeof(CacheHeader));
+
+    const qint64 pixelBytes = qint64(header.bytesPerLine) * header.height;
+    if (header.magic != CacheMagic
+            || header.version != CacheVersion
+            || header.format != QImage::Format_ARGB32_Premultiplied
+            || header.width == 0 || header.height == 0
+            || header.bytesPerLine < header.width * 4
+            || file->size() < qint64(sizeof(CacheHeader)) + pixelBytes) {
+        qCWarning(lcSilicaCoreLog) << "Discarding invalid filter cache entry" << path;
+        delete file;
+        QFile::remove(path);
+        return QImage();
+    }
+
+    // Keep recently used entries from being pruned.
+    file->setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+
+    // The image is read only and keeps the file, and so the mapping, until released.
+    return QImage(data + sizeof(CacheHeader), header.width, header.height, header.bytesPerLine,
+                  QImage::Format_ARGB32_Premultiplied, releaseFile, file);
+}
+
+bool FilterCache::store(const QByteArray &key, const QImage &image)
+{
+    const QString path = filePath(key);
+    if (path.isEmpty() || image.isNull() || !QDir().mkpath(directory())) {
+        return false;
+    }
+
+    const QImage pixels = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(CacheHeader));
+    header.magic = CacheMagic;
+    header.version = CacheVersion;
+    header.width = pixels.width();
+    header.height = pixels.height();
+    header.bytesPerLine = pixels.width() * 4;
+    header.format = QImage::Format_ARGB32_Premultiplied;
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)
+            || file.write(reinterpret_cast<const char *>(&header), sizeof(CacheHeader)) != qint64(sizeof(CacheHeader))) {
+        qCDebug(lcSilicaCoreLog) << "Could not store filtered image" << path;
+        return false;
+    }
+    for (int y = 0; y < pixels.height(); ++y) {
+        const char *line = reinterpret_cast<const char *>(pixels.constScanLine(y));
+        if (file.write(line, header.bytesPerLine) != qint64(header.bytesPerLine)) {
+            qCDebug(lcSilicaCoreLog) << "Could not store filtered image" << path;
+            return false;
+        }
+    }
+    if (!file.commit()) {
+        qCDebug(lcSilicaCoreLog) << "Could not store filtered image" << path;
+        return false;
+    }
+
+    prune(directory());
+    return true;
+}
+
+}}}
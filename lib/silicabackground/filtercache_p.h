@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+
+#ifndef SAILFISH_SILICA_BACKGROUND_FILTERCACHE_P_H
+#define SAILFISH_SILICA_BACKGROUND_FILTERCACHE_P_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QList>
+#include <QString>
+
+namespace Sailfish { namespace Silica { namespace Background {
+
+class AbstractFilter;
+
+// Disk cache of filtered images, so a wallpaper is filtered once rather than
+// on every launch.
+//
+// Entries are addressed by a hash of the source file's path, modification time
+// and size, the state of every filter in the chain and the resulting size.
+// Files hold a small header followed by the raw premultiplied pixels, which
+// load() maps into memory and wraps in a QImage without copying.
+class FilterCache
+{
+public:
+    // Returns an empty key if the source is not a local file or a filter in the
+    // chain cannot describe its state, e.g. a shader filter.
+    static QByteArray key(const QString &sourcePath, const QList<AbstractFilter *> &filters,
+                          const QSize &targetSize);
+
+    static QImage load(const QByteArray &key);
+    static bool store(const QByteArray &key, const QImage &image);
+
+    static QString directory();
+};
+
+}}}
+
+#endif // SAILFISH_SILICA_BACKGROUND_FILTERCACHE_P_H
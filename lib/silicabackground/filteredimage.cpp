@@ -1,7 +1,16 @@
 // SPDX-License-Identifier: LGPL-2.1-only
 
 #include "filteredimage.h"
-#include "abstractfilter.h"
+#include "abstractfilter_p.h"
+#include "filtercache_p.h"
+
+#include <QImageReader>
+#include <QQmlContext>
+#include <QQuickWindow>
+#include <QSGSimpleTextureNode>
+#include <QTimerEvent>
+#include <QtConcurrent>
+#include <private/qquickimagebase_p_p.h>
 
 namespace Sailfish {
 namespace Silica {
@@ -10,6 +19,7 @@ namespace Background {
 FilteredImage::FilteredImage(QQuickItem *parent)
     : QQuickImageBase(parent)
 {
+    connect(&m_watcher, &QFutureWatcher<QImage>::finished, this, &FilteredImage::filteringFinished);
 }
 
 FilteredImage::~FilteredImage() = default;
@@ -20,7 +30,7 @@ void FilteredImage::setFiltering(bool filtering)
         return;
     m_filtering = filtering;
     Q_EMIT filteringChanged();
-    update();
+    reload();
 }
 
 QQmlListProperty<AbstractFilter> FilteredImage::filters()
@@ -33,14 +43,172 @@ QQmlListProperty<AbstractFilter> FilteredImage::filters()
         &FilteredImage::filters_clear);
 }
 
+static QQuickImageBasePrivate *imageBasePrivate(QQuickImageBase *image)
+{
+    return static_cast<QQuickImageBasePrivate *>(QQuickItemPrivate::get(image));
+}
+
+QString FilteredImage::sourcePath() const
+{
+    const QQmlContext *context = qmlContext(this);
+    const QUrl url = context ? context->resolvedUrl(source()) : source();
+    return url.isLocalFile() ? url.toLocalFile() : QString();
+}
+
+// Size the source decodes to, read from the file header only.
+QSize FilteredImage::decodedSize(const QString &path) const
+{
+    QSize size = QImageReader(path).size();
+    const QSize requested = sourceSize();
+    if (size.isEmpty() || (requested.width() <= 0 && requested.height() <= 0)) {
+        return size;
+    } else if (requested.width() <= 0) {
+        return QSize(size.width() * requested.height() / size.height(), requested.height());
+    } else if (requested.height() <= 0) {
+        return QSize(requested.width(), size.height() * requested.width() / size.width());
+    } else {
+        return size.scaled(requested, Qt::KeepAspectRatio);
+    }
+}
+
+void FilteredImage::reload()
+{
+    if (isComponentComplete()) {
+        load();
+    }
+}
+
+void FilteredImage::scheduleReload()
+{
+    if (!m_reloadTimer.isActive()) {
+        m_reloadTimer.start(0, this);
+    }
+}
+
+void FilteredImage::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() == m_reloadTimer.timerId()) {
+        m_reloadTimer.stop();
+        reload();
+    } else {
+        QQuickImageBase::timerEvent(event);
+    }
+}
+
+void FilteredImage::load()
+{
+    m_reloadTimer.stop();
+    m_cacheKey.clear();
+
+    const QString path = m_filtering && !m_filters.isEmpty() ? sourcePath() : QString();
+    const QSize size = path.isEmpty() ? QSize() : decodedSize(path);
+    if (!size.isEmpty()) {
+        QSize targetSize = size;
+        for (AbstractFilter *filter : m_filters) {
+            targetSize = filter->targetSize(targetSize);
+        }
+        m_cacheKey = FilterCache::key(path, m_filters, targetSize);
+    }
+
+    const QImage cached = FilterCache::load(m_cacheKey);
+    if (cached.isNull()) {
+        // Filtered once loaded, see pixmapChange().
+        QQuickImageBase::load();
+        return;
+    }
+
+    // A cache hit skips decoding the source altogether.
+    QQuickImageBasePrivate *d = imageBasePrivate(this);
+    d->pix.clear(this);
+    ++m_generation;
+    m_filtered = cached;
+    m_textureChanged = true;
+    setImplicitSize(size.width(), size.height());
+
+    if (d->progress != 1.0) {
+        d->progress = 1.0;
+        Q_EMIT progressChanged(d->progress);
+    }
+    if (d->status != Ready) {
+        d->status = Ready;
+        Q_EMIT statusChanged(d->status);
+    }
+    update();
+}
+
 void FilteredImage::pixmapChange()
 {
     QQuickImageBase::pixmapChange();
-    // Apply filters if needed
-    if (m_filtering && !m_filters.isEmpty()) {
-        // TODO: Apply filtering to the image
+    applyFilters();
+}
+
+void FilteredImage::applyFilters()
+{
+    const QImage image = imageBasePrivate(this)->pix.image();
+    ++m_generation;
+
+    if (!m_filtering || image.isNull()) {
+        m_filtered = QImage();
+        m_textureChanged = true;
         update();
+        return;
+    }
+
+    // The previous filtered image stays until the new one is ready. The run
+    // only uses a snapshot of the filters, as they may change or be destroyed
+    // meanwhile. The convolutions spread over the global thread pool
+    // themselves.
+    QVector<AbstractFilterPrivate::ImageFunction> functions;
+    functions.reserve(m_filters.count());
+    for (AbstractFilter *filter : m_filters) {
+        functions.append(AbstractFilterPrivate::filterImageFunction(filter));
+    }
+    const QByteArray cacheKey = m_cacheKey;
+    m_watchedGeneration = m_generation;
+    m_watcher.setFuture(QtConcurrent::run([image, functions, cacheKey]() {
+        QImage filtered = image;
+        for (const AbstractFilterPrivate::ImageFunction &function : functions) {
+            filtered = function(filtered);
+        }
+        if (!cacheKey.isEmpty()) {
+            FilterCache::store(cacheKey, filtered);
+        }
+        return filtered;
+    }));
+}
+
+void FilteredImage::filteringFinished()
+{
+    // Superseded by a cache hit or a source without filtering meanwhile.
+    if (m_watchedGeneration != m_generation) {
+        return;
+    }
+    m_filtered = m_watcher.result();
+    m_textureChanged = true;
+    update();
+}
+
+QSGNode *FilteredImage::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *)
+{
+    QSGSimpleTextureNode *node = static_cast<QSGSimpleTextureNode *>(oldNode);
+    const QImage image = m_filtered.isNull() ? imageBasePrivate(this)->pix.image() : m_filtered;
+    if (image.isNull() || width() <= 0 || height() <= 0) {
+        delete node;
+        return nullptr;
+    }
+
+    if (!node) {
+        node = new QSGSimpleTextureNode;
+        node->setOwnsTexture(true);
+        m_textureChanged = true;
+    }
+    if (m_textureChanged) {
+        m_textureChanged = false;
+        node->setTexture(window()->createTextureFromImage(image));
     }
+    node->setRect(boundingRect());
+    node->setFiltering(smooth() ? QSGTexture::Linear : QSGTexture::Nearest);
+    return node;
 }
 
 void FilteredImage::filters_append(QQmlListProperty<AbstractFilter> *prop, AbstractFilter *filter)
@@ -48,7 +216,12 @@ void FilteredImage::filters_append(QQmlListProperty<AbstractFilter> *prop, Abstr
     FilteredImage *item = qobject_cast<FilteredImage*>(prop->object);
     if (item) {
         item->m_filters.append(filter);
+        if (filter) {
+            connect(filter, &AbstractFilter::filterChanged, item, &FilteredImage::scheduleReload,
+                    Qt::UniqueConnection);
+        }
         Q_EMIT item->filtersChanged();
+        item->reload();
     }
 }
 
@@ -68,8 +241,14 @@ void FilteredImage::filters_clear(QQmlListProperty<AbstractFilter> *prop)
 {
     FilteredImage *item = qobject_cast<FilteredImage*>(prop->object);
     if (item) {
+        for (AbstractFilter *filter : item->m_filters) {
+            if (filter) {
+                disconnect(filter, &AbstractFilter::filterChanged, item, &FilteredImage::scheduleReload);
+            }
+        }
         item->m_filters.clear();
         Q_EMIT item->filtersChanged();
+        item->reload();
     }
 }
 
@@ -4,6 +4,8 @@
 #define SAILFISH_SILICA_FILTEREDIMAGE_H
 
 #include <private/qquickimagebase_p.h>
+#include <QBasicTimer>
+#include <QFutureWatcher>
 #include <QQmlListProperty>
 
 namespace Sailfish {
@@ -31,16 +33,37 @@ Q_SIGNALS:
     void filtersChanged();
 
 protected:
+    void load() override;
     void pixmapChange() override;
+    QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data) override;
+    void timerEvent(QTimerEvent *event) override;
 
 private:
+    void reload();
+    void applyFilters();
+    void filteringFinished();
+    void scheduleReload();
+    QString sourcePath() const;
+    QSize decodedSize(const QString &path) const;
+
     static void filters_append(QQmlListProperty<AbstractFilter> *prop, AbstractFilter *filter);
     static int filters_count(QQmlListProperty<AbstractFilter> *prop);
     static AbstractFilter *filters_at(QQmlListProperty<AbstractFilter> *prop, int index);
     static void filters_clear(QQmlListProperty<AbstractFilter> *prop);
 
     bool m_filtering = false;
+    bool m_textureChanged = false;
     QList<AbstractFilter*> m_filters;
+    // The filtered pixmap, or a mapped FilterCache entry.
+    QImage m_filtered;
+    QByteArray m_cacheKey;
+    // Filters the pixmap on the global thread pool, only the result of the
+    // latest run is used.
+    QFutureWatcher<QImage> m_watcher;
+    uint m_generation = 0;
+    uint m_watchedGeneration = 0;
+    // Coalesces the changes of filters into one reload.
+    QBasicTimer m_reloadTimer;
 };
 
 } // namespace Background
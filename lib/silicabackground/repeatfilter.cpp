@@ -5,8 +5,60 @@
 
 namespace Sailfish { namespace Silica { namespace Background {
 
+class RepeatTask : public SequenceTask
+{
+protected:
+    void synchronize(const AbstractFilter *filter) override
+    {
+        SequenceTask::synchronize(filter);
+        m_repetitions = qMax(0, static_cast<const RepeatFilter *>(filter)->repetitions());
+    }
+};
+
 class RepeatFilterPrivate : public SequenceFilterPrivate {
 public:
+    QImage applyToImage(const QImage &source) const override
+    {
+        QImage image = source;
+        for (int i = 0; i < repetitions; ++i) {
+            image = SequenceFilterPrivate::applyToImage(image);
+        }
+        return image;
+    }
+
+    ImageFunction imageFunction() const override
+    {
+        const ImageFunction sequence = SequenceFilterPrivate::imageFunction();
+        const int repetitions = this->repetitions;
+        return [sequence, repetitions](const QImage &source) {
+            QImage image = source;
+            for (int i = 0; i < repetitions; ++i) {
+                image = sequence(image);
+            }
+            return image;
+        };
+    }
+
+    QSize targetSize(const QSize &sourceSize) const override
+    {
+        QSize size = sourceSize;
+        for (int i = 0; i < repetitions; ++i) {
+            size = SequenceFilterPrivate::targetSize(size);
+        }
+        return size;
+    }
+
+    FilterTask *createTask() const override
+    {
+        return new RepeatTask;
+    }
+
+    bool writeKey(QDataStream &stream) const override
+    {
+        stream << qint32(repetitions);
+        return SequenceFilterPrivate::writeKey(stream);
+    }
+
     int repetitions = 1;
 };
 
@@ -4,10 +4,116 @@
 #include "convolutionfilter_p.h"
 #include "fill.h"
 
+#include <QDataStream>
+
 namespace Sailfish { namespace Silica { namespace Background {
 
+static QSize resizedSize(const QSize &sourceSize, const QSize &size, Fill::Mode mode)
+{
+    if (!size.isValid() || sourceSize.isEmpty()) {
+        return sourceSize;
+    } else if (mode == Fill::PreserveAspectFit) {
+        return sourceSize.scaled(size, Qt::KeepAspectRatio);
+    } else {
+        return size;
+    }
+}
+
+// Part of the source that remains once cropped to the aspect ratio of the size.
+static QRectF croppedRect(const QSize &sourceSize, const QSize &size, Fill::Mode mode)
+{
+    if (mode != Fill::PreserveAspectByExpanding || !size.isValid() || sourceSize.isEmpty()) {
+        return QRectF(0, 0, 1, 1);
+    }
+    const QSize expanded = sourceSize.scaled(size, Qt::KeepAspectRatioByExpanding);
+    const qreal width = qreal(size.width()) / expanded.width();
+    const qreal height = qreal(size.height()) / expanded.height();
+    return QRectF((1 - width) / 2, (1 - height) / 2, width, height);
+}
+
+static QImage resizeImage(const QImage &source, const QSize &size, Fill::Mode mode)
+{
+    if (!size.isValid() || source.isNull()) {
+        return source;
+    }
+    const QRectF crop = croppedRect(source.size(), size, mode);
+    const QRect rect(qRound(crop.x() * source.width()), qRound(crop.y() * source.height()),
+                     qRound(crop.width() * source.width()), qRound(crop.height() * source.height()));
+    return (rect.size() != source.size() ? source.copy(rect) : source).scaled(
+                resizedSize(source.size(), size, mode), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+}
+
+// Scales in the horizontal pass of the convolution.
+class ResizeTask : public ConvolutionTask
+{
+public:
+    QSize targetSize(const QSize &sourceSize) const override
+    {
+        return resizedSize(sourceSize, m_size, m_mode);
+    }
+
+    qreal blurDeviation() const override
+    {
+        return -1;
+    }
+
+    qreal resampleDeviation(const QSize &sourceSize) const override
+    {
+        return sourceRect(sourceSize) == QRectF(0, 0, 1, 1) ? ConvolutionTask::blurDeviation() : -1;
+    }
+
+protected:
+    void synchronize(const AbstractFilter *filter) override
+    {
+        const ResizeFilter *resize = static_cast<const ResizeFilter *>(filter);
+        m_size = resize->size();
+        m_mode = resize->fillMode();
+        ConvolutionTask::synchronize(filter);
+    }
+
+    QRectF sourceRect(const QSize &sourceSize) const override
+    {
+        return croppedRect(sourceSize, m_size, m_mode);
+    }
+
+private:
+    QSize m_size;
+    Fill::Mode m_mode = Fill::Stretch;
+};
+
 class ResizeFilterPrivate : public ConvolutionFilterPrivate {
 public:
+    QImage applyToImage(const QImage &source) const override
+    {
+        return ConvolutionFilterPrivate::applyToImage(resizeImage(source, size, mode));
+    }
+
+    ImageFunction imageFunction() const override
+    {
+        const ImageFunction convolution = ConvolutionFilterPrivate::imageFunction();
+        const QSize size = this->size;
+        const Fill::Mode mode = this->mode;
+        return [convolution, size, mode](const QImage &source) {
+            return convolution(resizeImage(source, size, mode));
+        };
+    }
+
+    QSize targetSize(const QSize &sourceSize) const override
+    {
+        return resizedSize(sourceSize, size, mode);
+    }
+
+    FilterTask *createTask() const override
+    {
+        return new ResizeTask;
+    }
+
+    bool writeKey(QDataStream &stream) const override
+    {
+        stream << size << qint32(mode) << qint32(maximumScale);
+        return ConvolutionFilterPrivate::writeKey(stream);
+    }
+
     QSize size;
     Fill::Mode mode = Fill::Stretch;
     int maximumScale = 2;
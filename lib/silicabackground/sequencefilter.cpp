@@ -2,13 +2,235 @@
 
 #include "sequencefilter.h"
 #include "sequencefilter_p.h"
+#include "convolutionfilter_p.h"
 
 #include <QQmlListProperty>
+#include <QtMath>
 
 namespace Sailfish { namespace Silica { namespace Background {
 
 using ::Sailfish::Silica::Background::SequenceFilterPrivate;
 
+SequenceTask::SequenceTask() = default;
+
+SequenceTask::~SequenceTask()
+{
+    qDeleteAll(m_tasks);
+    qDeleteAll(m_pyramids);
+}
+
+bool SequenceTask::takeDirty()
+{
+    bool dirty = FilterTask::takeDirty();
+    for (FilterTask *task : m_tasks) {
+        dirty = task->takeDirty() || dirty;
+    }
+    return dirty;
+}
+
+QSize SequenceTask::targetSize(const QSize &sourceSize) const
+{
+    QSize size = sourceSize;
+    for (FilterTask *task : steps()) {
+        size = task->targetSize(size);
+    }
+    return size;
+}
+
+qreal SequenceTask::blurDeviation() const
+{
+    // Successive Gaussian blurs add up to one with the summed variance.
+    qreal variance = 0;
+    for (FilterTask *task : steps()) {
+        const qreal deviation = task->blurDeviation();
+        if (deviation < 0) {
+            return -1;
+        }
+        variance += deviation * deviation;
+    }
+    return qSqrt(variance);
+}
+
+void SequenceTask::synchronize(const AbstractFilter *filter)
+{
+    const QVector<AbstractFilter *> filters = static_cast<const SequenceFilter *>(filter)->filters();
+    if (filters == m_filters) {
+        return;
+    }
+
+    // Keep the tasks, and so their buffers and programs, of retained filters.
+    QVector<FilterTask *> tasks(filters.count(), nullptr);
+    for (int i = 0; i < m_filters.count(); ++i) {
+        const int index = filters.indexOf(m_filters.at(i));
+        if (index >= 0 && !tasks.at(index)) {
+            tasks[index] = m_tasks.at(i);
+        } else {
+            delete m_tasks.at(i);
+        }
+    }
+    m_filters = filters;
+    m_tasks = tasks;
+}
+
+void SequenceTask::update(const AbstractFilter *filter, const QVariantMap &properties)
+{
+    FilterTask::update(filter, properties);
+
+    for (int i = 0; i < m_filters.count(); ++i) {
+        m_tasks[i] = static_cast<FilterTask *>(m_filters.at(i)->updateTask(m_tasks.at(i), properties));
+    }
+}
+
+QVector<FilterTask *> SequenceTask::steps() const
+{
+    QVector<FilterTask *> steps;
+    for (int repetition = 0; repetition < m_repetitions; ++repetition) {
+        for (FilterTask *task : m_tasks) {
+            if (task->isEnabled()) {
+                steps.append(task);
+            }
+        }
+    }
+    return steps;
+}
+
+// If the steps from start scale the source down, blur it and scale it back up
+// to the same size, returns the end of those steps and sets deviation to the
+// blur of the source they amount to, otherwise returns start.
+static int resampledBlurEnd(const QVector<FilterTask *> &steps, int start, const QSize &size, qreal *deviation)
+{
+    const qreal downDeviation = steps.at(start)->resampleDeviation(size);
+    const QSize smallSize = steps.at(start)->targetSize(size);
+    if (downDeviation < 0 || smallSize.isEmpty()
+            || smallSize.width() >= size.width() || smallSize.height() >= size.height()) {
+        return start;
+    }
+
+    // Only a uniform scale keeps the blur round.
+    const qreal scaleX = qreal(size.width()) / smallSize.width();
+    const qreal scaleY = qreal(size.height()) / smallSize.height();
+    if (qAbs(scaleX - scaleY) > 0.1 * qMin(scaleX, scaleY)) {
+        return start;
+    }
+
+    qreal variance = downDeviation * downDeviation;
+    int end = start + 1;
+    for (; end < steps.count(); ++end) {
+        const qreal blur = steps.at(end)->blurDeviation();
+        if (blur < 0) {
+            break;
+        }
+        variance += blur * blur;
+    }
+
+    if (end == steps.count() || steps.at(end)->targetSize(smallSize) != size) {
+        return start;
+    }
+    const qreal upDeviation = steps.at(end)->resampleDeviation(smallSize);
+    if (upDeviation < 0) {
+        return start;
+    }
+
+    // Variances at the small size grow with the square of the scale, and
+    // bilinear scaling up adds a tent of variance scale^2 / 6.
+    const qreal scale = qSqrt(scaleX * scaleY);
+    *deviation = qSqrt(scale * scale * (variance + 1.0 / 6) + upDeviation * upDeviation);
+    return end + 1;
+}
+
+QVector<FilterTask *> SequenceTask::passes(const QVector<FilterTask *> &steps, const QSize &sourceSize)
+{
+    QVector<FilterTask *> passes;
+    QSize size = sourceSize;
+    int pyramidCount = 0;
+    const auto appendPyramid = [&](qreal deviation, int levels) {
+        if (pyramidCount == m_pyramids.count()) {
+            m_pyramids.append(new PyramidBlurTask);
+        }
+        PyramidBlurTask *pyramid = m_pyramids.at(pyramidCount++);
+        pyramid->setBlur(deviation, levels);
+        passes.append(pyramid);
+    };
+
+    for (int i = 0; i < steps.count();) {
+        // Scaling down, blurring and scaling back up is a wide blur of the
+        // source, which the pyramid does in fewer and smaller passes.
+        qreal resampledDeviation = 0;
+        const int resampledEnd = resampledBlurEnd(steps, i, size, &resampledDeviation);
+        if (resampledEnd > i) {
+            const int levels = PyramidBlurTask::levelCount(resampledDeviation, size);
+            if (levels > 0) {
+                appendPyramid(resampledDeviation, levels);
+                i = resampledEnd;
+                continue;
+            }
+        }
+
+        // Find the run of blurs starting at this step.
+        qreal variance = 0;
+        int end = i;
+        for (; end < steps.count(); ++end) {
+            const qreal deviation = steps.at(end)->blurDeviation();
+            if (deviation < 0) {
+                break;
+            }
+            variance += deviation * deviation;
+        }
+
+        if (end == i) {
+            size = steps.at(i)->targetSize(size);
+            passes.append(steps.at(i++));
+            continue;
+        }
+
+        const qreal deviation = qSqrt(variance);
+        const int levels = PyramidBlurTask::levelCount(deviation, size);
+        if (levels > 0) {
+            appendPyramid(deviation, levels);
+        } else {
+            passes += steps.mid(i, end - i);
+        }
+        i = end;
+    }
+    return passes;
+}
+
+void SequenceTask::render(const TextureInfo &source, const QSize &size)
+{
+    const QVector<FilterTask *> steps = passes(this->steps(), source.size);
+    if (steps.isEmpty()) {
+        copy(source);
+        return;
+    }
+
+    const uint target = boundFramebuffer();
+
+    TextureInfo input = source;
+    for (int i = 0; i < steps.count() - 1; ++i) {
+        steps.at(i)->setBufferPool(bufferPool());
+        input = steps.at(i)->renderToBuffer(input, steps.at(i)->targetSize(input.size));
+    }
+
+    bindFramebuffer(target, size);
+    steps.last()->setBufferPool(bufferPool());
+    steps.last()->render(input, size);
+}
+
+TextureInfo SequenceTask::renderToBuffer(const TextureInfo &source, const QSize &size)
+{
+    const QVector<FilterTask *> steps = passes(this->steps(), source.size);
+    if (steps.isEmpty()) {
+        return FilterTask::renderToBuffer(source, size);
+    }
+
+    TextureInfo input = source;
+    for (FilterTask *step : steps) {
+        step->setBufferPool(bufferPool());
+        input = step->renderToBuffer(input, step->targetSize(input.size));
+    }
+    return input;
+}
+
 SequenceFilter::SequenceFilter(QObject *parent)
     : AbstractFilter(*new SequenceFilterPrivate, parent)
 {
@@ -36,6 +258,7 @@ void SequenceFilter::setFilters(const QVector<AbstractFilter *> &filters)
         return;
     d->filters = filters;
     Q_EMIT filtersChanged();
+    Q_EMIT filterChanged();
 }
 
 QQmlListProperty<AbstractFilter> SequenceFilter::filterList()
@@ -5,15 +5,102 @@
 
 #include "abstractfilter_p.h"
 #include "sequencefilter.h"
+#include "task_p.h"
 
+#include <QDataStream>
 #include <QtGlobal>
 #include <QQmlListProperty>
 
 namespace Sailfish { namespace Silica { namespace Background {
 
+// Runs the tasks of the enabled filters in order. The tasks share the buffer
+// pool of the sequence for their intermediate results, so the framebuffers
+// needed don't grow with the number of steps, the last step renders into the
+// target. Consecutive blurs wide enough to benefit are combined into a single
+// pyramid blur, as is a resize down, the blurs after it and the resize back up
+// to the same size.
+class PyramidBlurTask;
+
+class SequenceTask : public FilterTask
+{
+public:
+    SequenceTask();
+    ~SequenceTask() override;
+
+    bool takeDirty() override;
+    QSize targetSize(const QSize &sourceSize) const override;
+    qreal blurDeviation() const override;
+    void update(const AbstractFilter *filter, const QVariantMap &properties) override;
+    void render(const TextureInfo &source, const QSize &size) override;
+    TextureInfo renderToBuffer(const TextureInfo &source, const QSize &size) override;
+
+protected:
+    void synchronize(const AbstractFilter *filter) override;
+
+    int m_repetitions = 1;
+
+private:
+    QVector<FilterTask *> steps() const;
+    QVector<FilterTask *> passes(const QVector<FilterTask *> &steps, const QSize &sourceSize);
+
+    QVector<AbstractFilter *> m_filters;
+    QVector<FilterTask *> m_tasks;
+    QVector<PyramidBlurTask *> m_pyramids;
+};
+
 class SequenceFilterPrivate : public AbstractFilterPrivate {
 public:
     Q_DECLARE_PUBLIC(SequenceFilter)
+    QImage applyToImage(const QImage &source) const override
+    {
+        QImage image = source;
+        for (AbstractFilter *filter : filters) {
+            image = filter->apply(image);
+        }
+        return image;
+    }
+
+    ImageFunction imageFunction() const override
+    {
+        QVector<ImageFunction> functions;
+        functions.reserve(filters.count());
+        for (AbstractFilter *filter : filters) {
+            functions.append(filterImageFunction(filter));
+        }
+        return [functions](const QImage &source) {
+            QImage image = source;
+            for (const ImageFunction &function : functions) {
+                image = function(image);
+            }
+            return image;
+        };
+    }
+
+    QSize targetSize(const QSize &sourceSize) const override
+    {
+        QSize size = sourceSize;
+        for (AbstractFilter *filter : filters) {
+            size = filter->targetSize(size);
+        }
+        return size;
+    }
+
+    FilterTask *createTask() const override
+    {
+        return new SequenceTask;
+    }
+
+    bool writeKey(QDataStream &stream) const override
+    {
+        stream << qint32(filters.count());
+        for (AbstractFilter *filter : filters) {
+            if (!writeFilterKey(filter, stream)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
     SequenceFilter *q_ptr = nullptr;
     QVector<AbstractFilter*> filters;
 
@@ -23,6 +110,7 @@ public:
             auto *self = reinterpret_cast<SequenceFilterPrivate*>(lp->data);
             self->filters.append(f);
             Q_EMIT reinterpret_cast<SequenceFilter*>(lp->object)->filtersChanged();
+            Q_EMIT reinterpret_cast<SequenceFilter*>(lp->object)->filterChanged();
         };
         auto count = [](QQmlListProperty<AbstractFilter>* lp){
             return reinterpret_cast<SequenceFilterPrivate*>(lp->data)->filters.count();
@@ -33,6 +121,7 @@ public:
         auto clear = [](QQmlListProperty<AbstractFilter>* lp){
             reinterpret_cast<SequenceFilterPrivate*>(lp->data)->filters.clear();
             Q_EMIT reinterpret_cast<SequenceFilter*>(lp->object)->filtersChanged();
+            Q_EMIT reinterpret_cast<SequenceFilter*>(lp->object)->filterChanged();
         };
         return QQmlListProperty<AbstractFilter>(q_ptr, this, append, count, at, clear);
     }
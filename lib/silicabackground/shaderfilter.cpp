@@ -2,11 +2,122 @@
 
 #include "shaderfilter.h"
 #include "abstractfilter_p.h"
+#include "task_p.h"
+
+#include <QColor>
+#include <QOpenGLShaderProgram>
+#include <QPointF>
+#include <QSizeF>
+#include <QVector2D>
+#include <QVector3D>
+#include <QVector4D>
 
 namespace Sailfish { namespace Silica { namespace Background {
 
+// Draws the source with the filter's shaders. The values of the properties
+// passed to updateTask() are set as uniforms of the same name.
+class ShaderTask : public FilterTask
+{
+public:
+    void render(const TextureInfo &source, const QSize &size) override
+    {
+        Q_UNUSED(size)
+        if (!m_program && !m_failed) {
+            m_program.reset(createProgram(m_vertexShader, m_fragmentShader));
+            m_failed = !m_program;
+        }
+        if (!m_program) {
+            copy(source);
+            return;
+        }
+
+        m_program->bind();
+        for (auto it = m_uniforms.constBegin(); it != m_uniforms.constEnd(); ++it) {
+            setUniform(it.key().toLatin1(), it.value());
+        }
+        draw(m_program.data(), source);
+    }
+
+protected:
+    void synchronize(const AbstractFilter *filter) override
+    {
+        const ShaderFilter *shader = static_cast<const ShaderFilter *>(filter);
+        const QByteArray vertex = shader->vertexShader().isEmpty()
+                ? defaultVertexShader()
+                : shader->vertexShader().toUtf8();
+        const QByteArray fragment = shader->fragmentShader().isEmpty()
+                ? defaultFragmentShader()
+                : shader->fragmentShader().toUtf8();
+        if (vertex != m_vertexShader || fragment != m_fragmentShader) {
+            m_vertexShader = vertex;
+            m_fragmentShader = fragment;
+            m_program.reset();
+            m_failed = false;
+        }
+    }
+
+    bool synchronizeProperties(const QVariantMap &properties) override
+    {
+        if (properties == m_uniforms) {
+            return false;
+        }
+        m_uniforms = properties;
+        return true;
+    }
+
+private:
+    void setUniform(const QByteArray &name, const QVariant &value)
+    {
+        const int location = m_program->uniformLocation(name);
+        if (location < 0) {
+            return;
+        }
+
+        switch (int(value.type())) {
+        case QMetaType::Bool:
+        case QMetaType::Int:
+            m_program->setUniformValue(location, value.toInt());
+            break;
+        case QMetaType::QColor:
+            m_program->setUniformValue(location, value.value<QColor>());
+            break;
+        case QMetaType::QPointF:
+            m_program->setUniformValue(location, value.toPointF());
+            break;
+        case QMetaType::QSizeF:
+            m_program->setUniformValue(location, value.toSizeF());
+            break;
+        case QMetaType::QVector2D:
+            m_program->setUniformValue(location, value.value<QVector2D>());
+            break;
+        case QMetaType::QVector3D:
+            m_program->setUniformValue(location, value.value<QVector3D>());
+            break;
+        case QMetaType::QVector4D:
+            m_program->setUniformValue(location, value.value<QVector4D>());
+            break;
+        default:
+            if (value.canConvert<float>()) {
+                m_program->setUniformValue(location, value.toFloat());
+            }
+            break;
+        }
+    }
+
+    QByteArray m_vertexShader;
+    QByteArray m_fragmentShader;
+    QVariantMap m_uniforms;
+    QScopedPointer<QOpenGLShaderProgram> m_program;
+    bool m_failed = false;
+};
+
 class ShaderFilterPrivate : public AbstractFilterPrivate {
 public:
+    FilterTask *createTask() const override
+    {
+        return new ShaderTask;
+    }
+
     QString vertex;
     QString fragment;
 };
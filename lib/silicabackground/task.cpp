@@ -0,0 +1,365 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+
+#include "task_p.h"
+#include "abstractfilter_p.h"
+#include "../logging.h"
+
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+
+namespace Sailfish { namespace Silica { namespace Background {
+
+namespace {
+
+const GLfloat quadVertices[] = { -1, -1, 1, -1, -1, 1, 1, 1 };
+const GLfloat quadTexCoords[] = { 0, 0, 1, 0, 0, 1, 1, 1 };
+
+// Filters draw opaque replacements of the target, the scenegraph state they
+// change is restored afterwards, including the program, texture and buffer
+// bindings the renderer expects to be unchanged.
+class StateGuard
+{
+public:
+    StateGuard()
+        : gl(QOpenGLContext::currentContext()->functions())
+    {
+        gl->glGetIntegerv(GL_VIEWPORT, viewport);
+        framebuffer = FilterTask::boundFramebuffer();
+        blend = gl->glIsEnabled(GL_BLEND);
+        depthTest = gl->glIsEnabled(GL_DEPTH_TEST);
+        scissorTest = gl->glIsEnabled(GL_SCISSOR_TEST);
+        stencilTest = gl->glIsEnabled(GL_STENCIL_TEST);
+
+        // Filters draw with their own program, sampling texture unit 0 with
+        // client side vertex arrays 0 and 1.
+        gl->glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+        gl->glGetIntegerv(GL_ACTIVE_TEXTURE, &activeTexture);
+        gl->glActiveTexture(GL_TEXTURE0);
+        gl->glGetIntegerv(GL_TEXTURE_BINDING_2D, &texture);
+        gl->glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &arrayBuffer);
+        for (int i = 0; i < 2; ++i) {
+            gl->glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &attributeArrays[i]);
+        }
+
+        gl->glDisable(GL_BLEND);
+        gl->glDisable(GL_DEPTH_TEST);
+        gl->glDisable(GL_SCISSOR_TEST);
+        gl->glDisable(GL_STENCIL_TEST);
+    }
+
+    ~StateGuard()
+    {
+        gl->glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        gl->glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        restore(GL_BLEND, blend);
+        restore(GL_DEPTH_TEST, depthTest);
+        restore(GL_SCISSOR_TEST, scissorTest);
+        restore(GL_STENCIL_TEST, stencilTest);
+
+        gl->glUseProgram(program);
+        gl->glActiveTexture(GL_TEXTURE0);
+        gl->glBindTexture(GL_TEXTURE_2D, texture);
+        gl->glActiveTexture(activeTexture);
+        gl->glBindBuffer(GL_ARRAY_BUFFER, arrayBuffer);
+        for (int i = 0; i < 2; ++i) {
+            if (attributeArrays[i]) {
+                gl->glEnableVertexAttribArray(i);
+            } else {
+                gl->glDisableVertexAttribArray(i);
+            }
+        }
+    }
+
+private:
+    void restore(GLenum capability, GLboolean enabled)
+    {
+        if (enabled) {
+            gl->glEnable(capability);
+        }
+    }
+
+    QOpenGLFunctions *gl;
+    GLint viewport[4];
+    GLuint framebuffer;
+    GLboolean blend;
+    GLboolean depthTest;
+    GLboolean scissorTest;
+    GLboolean stencilTest;
+    GLint program;
+    GLint activeTexture;
+    GLint texture;
+    GLint arrayBuffer;
+    GLint attributeArrays[2];
+};
+
+// Framebuffer the targets are attached to. Framebuffer objects aren't shared
+// between contexts, so each context gets its own which is freed along with it,
+// rather than by whichever thread happens to delete a task.
+GLuint targetFramebuffer(QOpenGLContext *context)
+{
+    static const char property[] = "_q_silicaBackgroundFramebuffer";
+    GLuint framebuffer = context->property(property).toUInt();
+    if (!framebuffer) {
+        context->functions()->glGenFramebuffers(1, &framebuffer);
+        context->setProperty(property, framebuffer);
+    }
+    return framebuffer;
+}
+
+}
+
+struct BufferPool::Pair
+{
+    QSize size;
+    QScopedPointer<QOpenGLFramebufferObject> buffers[2];
+    bool used = true;
+};
+
+BufferPool::BufferPool() = default;
+
+BufferPool::~BufferPool()
+{
+    qDeleteAll(m_pairs);
+}
+
+QOpenGLFramebufferObject *BufferPool::bind(const QSize &size, const TextureInfo &input)
+{
+    Pair *pair = nullptr;
+    for (Pair *candidate : m_pairs) {
+        if (candidate->size == size) {
+            pair = candidate;
+            break;
+        }
+    }
+    if (!pair) {
+        pair = new Pair;
+        pair->size = size;
+        m_pairs.append(pair);
+    }
+    pair->used = true;
+
+    const QScopedPointer<QOpenGLFramebufferObject> &first = pair->buffers[0];
+    QScopedPointer<QOpenGLFramebufferObject> &buffer
+            = pair->buffers[first && first->texture() == input.id ? 1 : 0];
+    FilterTask::bindBuffer(&buffer, size);
+    return buffer.data();
+}
+
+void BufferPool::releaseUnused()
+{
+    for (int i = m_pairs.count() - 1; i >= 0; --i) {
+        Pair *pair = m_pairs.at(i);
+        if (pair->used) {
+            pair->used = false;
+        } else {
+            delete m_pairs.takeAt(i);
+        }
+    }
+}
+
+Task::~Task() = default;
+
+FilterTask::FilterTask() = default;
+
+FilterTask::~FilterTask() = default;
+
+bool FilterTask::takeDirty()
+{
+    const bool dirty = m_dirty;
+    m_dirty = false;
+    return dirty;
+}
+
+QSize FilterTask::targetSize(const QSize &sourceSize) const
+{
+    return sourceSize;
+}
+
+qreal FilterTask::blurDeviation() const
+{
+    return -1;
+}
+
+qreal FilterTask::resampleDeviation(const QSize &) const
+{
+    return -1;
+}
+
+void FilterTask::execute(const TextureInfo &source, const TextureInfo &target)
+{
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    if (!context || !target.id || target.size.isEmpty()) {
+        return;
+    }
+
+    StateGuard guard;
+    QOpenGLFunctions *gl = context->functions();
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer(context));
+    gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.id, 0);
+    gl->glViewport(0, 0, target.size.width(), target.size.height());
+
+    if (m_enabled) {
+        render(source, target.size);
+    } else {
+        copy(source);
+    }
+
+    gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+    bufferPool()->releaseUnused();
+}
+
+TextureInfo FilterTask::renderToBuffer(const TextureInfo &source, const QSize &size)
+{
+    QOpenGLFramebufferObject *buffer = bufferPool()->bind(size, source);
+    render(source, size);
+    return bufferTexture(buffer);
+}
+
+BufferPool *FilterTask::bufferPool()
+{
+    if (m_bufferPool) {
+        return m_bufferPool;
+    }
+    if (!m_ownBufferPool) {
+        m_ownBufferPool.reset(new BufferPool);
+    }
+    return m_ownBufferPool.data();
+}
+
+void FilterTask::update(const AbstractFilter *filter, const QVariantMap &properties)
+{
+    const uint revision = AbstractFilterPrivate::get(filter)->revision;
+    if (!m_synchronized || m_revision != revision) {
+        m_synchronized = true;
+        m_revision = revision;
+        m_enabled = filter->isValid();
+        synchronize(filter);
+        synchronizeProperties(properties);
+        m_dirty = true;
+    } else if (synchronizeProperties(properties)) {
+        m_dirty = true;
+    }
+}
+
+void FilterTask::synchronize(const AbstractFilter *)
+{
+}
+
+bool FilterTask::synchronizeProperties(const QVariantMap &)
+{
+    return false;
+}
+
+QByteArray FilterTask::defaultVertexShader()
+{
+    return "attribute highp vec4 qt_Vertex;\n"
+           "attribute highp vec2 qt_MultiTexCoord0;\n"
+           "uniform highp vec4 sourceRect;\n"
+           "varying highp vec2 qt_TexCoord0;\n"
+           "void main() {\n"
+           "    qt_TexCoord0 = sourceRect.xy + qt_MultiTexCoord0 * sourceRect.zw;\n"
+           "    gl_Position = qt_Vertex;\n"
+           "}\n";
+}
+
+QByteArray FilterTask::defaultFragmentShader()
+{
+    return "uniform lowp sampler2D source;\n"
+           "varying highp vec2 qt_TexCoord0;\n"
+           "void main() {\n"
+           "    gl_FragColor = texture2D(source, qt_TexCoord0);\n"
+           "}\n";
+}
+
+QOpenGLShaderProgram *FilterTask::createProgram(const QByteArray &vertexShader, const QByteArray &fragmentShader)
+{
+    QScopedPointer<QOpenGLShaderProgram> program(new QOpenGLShaderProgram);
+    program->addShaderFromSourceCode(QOpenGLShader::Vertex, vertexShader);
+    program->addShaderFromSourceCode(QOpenGLShader::Fragment, fragmentShader);
+    program->bindAttributeLocation("qt_Vertex", 0);
+    program->bindAttributeLocation("qt_MultiTexCoord0", 1);
+    if (!program->link()) {
+        qCWarning(lcSilicaCoreLog) << "Failed to link background filter shader:" << program->log();
+        return nullptr;
+    }
+    return program.take();
+}
+
+void FilterTask::draw(QOpenGLShaderProgram *program, const TextureInfo &source, const QRectF &sourceRect)
+{
+    if (!program) {
+        return;
+    }
+
+    QOpenGLFunctions *gl = QOpenGLContext::currentContext()->functions();
+
+    program->bind();
+    gl->glActiveTexture(GL_TEXTURE0);
+    gl->glBindTexture(GL_TEXTURE_2D, source.id);
+    gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    program->setUniformValue("source", 0);
+    program->setUniformValue("sourceRect", GLfloat(sourceRect.x()), GLfloat(sourceRect.y()),
+                             GLfloat(sourceRect.width()), GLfloat(sourceRect.height()));
+
+    // Client side arrays, no buffer may be bound.
+    gl->glBindBuffer(GL_ARRAY_BUFFER, 0);
+    program->enableAttributeArray(0);
+    program->enableAttributeArray(1);
+    program->setAttributeArray(0, GL_FLOAT, quadVertices, 2);
+    program->setAttributeArray(1, GL_FLOAT, quadTexCoords, 2);
+
+    gl->glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    program->disableAttributeArray(0);
+    program->disableAttributeArray(1);
+    program->release();
+}
+
+void FilterTask::bindBuffer(QScopedPointer<QOpenGLFramebufferObject> *buffer, const QSize &size)
+{
+    if (!*buffer || (*buffer)->size() != size) {
+        buffer->reset(new QOpenGLFramebufferObject(size, QOpenGLFramebufferObject::NoAttachment,
+                                                   GL_TEXTURE_2D, GL_RGBA));
+    }
+    (*buffer)->bind();
+    QOpenGLContext::currentContext()->functions()->glViewport(0, 0, size.width(), size.height());
+}
+
+TextureInfo FilterTask::bufferTexture(const QOpenGLFramebufferObject *buffer)
+{
+    return TextureInfo(buffer->texture(), GL_RGBA, buffer->size());
+}
+
+uint FilterTask::boundFramebuffer()
+{
+    GLint framebuffer = 0;
+    QOpenGLContext::currentContext()->functions()->glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+    return uint(framebuffer);
+}
+
+void FilterTask::bindFramebuffer(uint framebuffer, const QSize &size)
+{
+    QOpenGLFunctions *gl = QOpenGLContext::currentContext()->functions();
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    gl->glViewport(0, 0, size.width(), size.height());
+}
+
+void FilterTask::copy(const TextureInfo &source, const QRectF &sourceRect)
+{
+    if (!m_copyProgram) {
+        m_copyProgram.reset(createProgram(defaultVertexShader(), defaultFragmentShader()));
+    }
+    draw(m_copyProgram.data(), source, sourceRect);
+}
+
+void CopyTask::render(const TextureInfo &source, const QSize &)
+{
+    copy(source);
+}
+
+}}}
@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+
+#ifndef SAILFISH_SILICA_BACKGROUND_TASK_P_H
+#define SAILFISH_SILICA_BACKGROUND_TASK_P_H
+
+#include "abstractfilter.h"
+#include "task.h"
+
+#include <QRectF>
+#include <QScopedPointer>
+#include <QVariantMap>
+#include <QVector>
+
+QT_BEGIN_NAMESPACE
+class QOpenGLFramebufferObject;
+class QOpenGLShaderProgram;
+QT_END_NAMESPACE
+
+namespace Sailfish { namespace Silica { namespace Background {
+
+// Framebuffers for the intermediate results of a chain of tasks, shared by all
+// the tasks of the chain. Buffers come in pairs of the same size and a task
+// writes to the one of the pair not holding its input, so two buffers per size
+// serve any chain length. Pairs a run didn't use are released after it.
+class BufferPool
+{
+public:
+    BufferPool();
+    ~BufferPool();
+
+    // Binds a buffer of the given size which doesn't hold the input.
+    QOpenGLFramebufferObject *bind(const QSize &size, const TextureInfo &input);
+    void releaseUnused();
+
+private:
+    struct Pair;
+    QVector<Pair *> m_pairs;
+};
+
+// Render thread counterpart of a filter.
+//
+// AbstractFilter::updateTask() copies the filter state into the task while the
+// GUI thread is blocked, and marks it dirty only if the filter or the property
+// values changed since the last update. render() draws the filtered source
+// into the currently bound framebuffer.
+class FilterTask : public Task
+{
+public:
+    FilterTask();
+    ~FilterTask() override;
+
+    bool takeDirty() override;
+    QSize targetSize(const QSize &sourceSize) const override;
+    void execute(const TextureInfo &source, const TextureInfo &target) override;
+
+    virtual void update(const AbstractFilter *filter, const QVariantMap &properties);
+    virtual void render(const TextureInfo &source, const QSize &size) = 0;
+    // Renders into a buffer of the pool and returns it, for all but the last
+    // task of a chain. The default renders into the buffer not holding the
+    // source, tasks with intermediate passes of their own may end in either.
+    virtual TextureInfo renderToBuffer(const TextureInfo &source, const QSize &size);
+
+    // The pool of the chain the task runs in, or its own if it runs alone.
+    BufferPool *bufferPool();
+    void setBufferPool(BufferPool *pool) { m_bufferPool = pool; }
+
+    bool isEnabled() const { return m_enabled; }
+
+    // Standard deviation in pixels of the Gaussian blur the task amounts to, or
+    // a negative value if it does anything other than blur at the same size.
+    virtual qreal blurDeviation() const;
+
+    // Standard deviation in target pixels of the Gaussian blur the task adds
+    // while scaling a source of the given size, or a negative value if it does
+    // anything other than scale the whole source and blur.
+    virtual qreal resampleDeviation(const QSize &sourceSize) const;
+
+    // Vertex attributes are qt_Vertex in normalized device coordinates and
+    // qt_MultiTexCoord0, the vertex shader passes the texture coordinate
+    // within sourceRect on as qt_TexCoord0 and the source is bound to source.
+    static QByteArray defaultVertexShader();
+    static QByteArray defaultFragmentShader();
+    static QOpenGLShaderProgram *createProgram(const QByteArray &vertexShader, const QByteArray &fragmentShader);
+
+    // Draws a quad covering the viewport, sampling sourceRect of the source.
+    static void draw(QOpenGLShaderProgram *program, const TextureInfo &source,
+                     const QRectF &sourceRect = QRectF(0, 0, 1, 1));
+
+    // Binds a framebuffer of the given size, recreating it if the size changed.
+    static void bindBuffer(QScopedPointer<QOpenGLFramebufferObject> *buffer, const QSize &size);
+    static TextureInfo bufferTexture(const QOpenGLFramebufferObject *buffer);
+    static uint boundFramebuffer();
+    static void bindFramebuffer(uint framebuffer, const QSize &size);
+
+protected:
+    // Copies the filter state, called when the filter changed. Disabled filters
+    // copy the source instead of rendering.
+    virtual void synchronize(const AbstractFilter *filter);
+    // Copies property values, returns true if they changed.
+    virtual bool synchronizeProperties(const QVariantMap &properties);
+
+    void markDirty() { m_dirty = true; }
+    void copy(const TextureInfo &source, const QRectF &sourceRect = QRectF(0, 0, 1, 1));
+
+private:
+    QScopedPointer<QOpenGLShaderProgram> m_copyProgram;
+    QScopedPointer<BufferPool> m_ownBufferPool;
+    BufferPool *m_bufferPool = nullptr;
+    uint m_revision = 0;
+    bool m_synchronized = false;
+    bool m_enabled = true;
+    bool m_dirty = true;
+};
+
+// Copies the source, for filters that change nothing.
+class CopyTask : public FilterTask
+{
+public:
+    void render(const TextureInfo &source, const QSize &size) override;
+};
+
+}}}
+
+#endif // SAILFISH_SILICA_BACKGROUND_TASK_P_H
@@ -4,14 +4,23 @@
 #include "silicaimageprovider_p.h"
 #include "silicatheme.h"
 #include "silicathemeiconresolver.h"
+#include "themetexturefactory.h"
 
+#include <QGuiApplication>
 #include <QImageReader>
 #include <QQuickTextureFactory>
+#include <QRunnable>
+#include <QThread>
 #include <QUrlQuery>
 
+#include <climits>
+
 using namespace Silica;
 
 namespace {
+const int DefaultCacheLimit = 8 * 1024 * 1024;
+const int DefaultMaxDecodeThreads = 4;
+
 static bool parseMonochromeId(const QString &id)
 {
     // Heuristic: monochrome icons in Silica often use prefix "icon-m-"
@@ -19,127 +28,331 @@ static bool parseMonochromeId(const QString &id)
         || id.contains(QLatin1String("/icons-monochrome/"));
 }
 
-static QImage colorizeMonochrome(QImage img, const QColor &color)
+static ImageCacheKey parseImageId(const QString &id, const QSize &requestedSize, QColor *color)
 {
-    if (img.format() != QImage::Format_ARGB32_Premultiplied) {
-        img = img.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    // Parse parameters like "id?color=#RRGGBB"
+    QString iconId = id;
+    QColor overrideColor;
+    int queryPos = id.indexOf('?');
+    if (queryPos > 0) {
+        const QString base = id.left(queryPos);
+        const QUrl url(QString::fromLatin1("image://theme/") + id);
+        QUrlQuery q(url);
+        const QString colorStr = q.queryItemValue(QStringLiteral("color"));
+        if (!colorStr.isEmpty()) {
+            overrideColor = QColor(colorStr);
+        }
+        iconId = base;
     }
 
-    const uchar hr = color.red();
-    const uchar hg = color.green();
-    const uchar hb = color.blue();
-    const uchar ha = color.alpha();
+    *color = overrideColor.isValid() ? overrideColor : Theme::instance()->primaryColor();
+
+    ImageCacheKey key;
+    key.id = iconId;
+    key.size = requestedSize;
+    return key;
+}
 
-    // Create lookup table
-    // The algorithm uses the source pixel's alpha as an index into this table
-    QRgb lookupTable[256];
-    for (int i = 0; i < 256; ++i) {
-        // Calculate colorized value based on alpha index
-        const uchar r = (uchar)((hr * i) / 255);
-        const uchar g = (uchar)((hg * i) / 255);
-        const uchar b = (uchar)((hb * i) / 255);
-        const uchar a = (uchar)((ha * i) / 255);
-        lookupTable[i] = qRgba(r, g, b, a);
+// Keeps the job alive while it runs, even if every response is gone.
+class ImageDecodeRunnable : public QRunnable
+{
+public:
+    explicit ImageDecodeRunnable(const QSharedPointer<ImageDecodeJob> &job)
+        : m_job(job)
+    {
     }
 
-    for (int y = 0; y < img.height(); ++y) {
-        QRgb *scan = reinterpret_cast<QRgb *>(img.scanLine(y));
-        for (int x = 0; x < img.width(); ++x) {
-            const QRgb pixel = scan[x];
-            const uchar sa = qAlpha(pixel);
+    void run() override
+    {
+        m_job->run();
+    }
 
-            // If source alpha is 0, result should be transparent
-            if (sa == 0) {
-                scan[x] = qRgba(0, 0, 0, 0);
-                continue;
-            }
+private:
+    QSharedPointer<ImageDecodeJob> m_job;
+};
+}
+
+#ifdef UNIT_TEST
+QImage Silica::ImageProvider::colorize(QImage &image, QColor color)
+{
+    return ThemeTextureFactory::colorize(image, color);
+}
+#endif
 
-            // Use the source alpha as an index into the lookup table
-            scan[x] = lookupTable[sa];
+QQuickTextureFactory *ThemeImage::textureFactory(const QColor &color) const
+{
+    if (mask) {
+        return new ThemeTextureFactory(mask, color);
+    }
+    return QQuickTextureFactory::textureFactoryForImage(image);
+}
+
+ImageDecodeJob::ImageDecodeJob(ImageProviderPrivate *provider, const ImageCacheKey &key, Theme::ColorScheme colorScheme)
+    : key(key)
+    , m_provider(provider)
+    , m_colorScheme(colorScheme)
+{
+}
+
+void ImageDecodeJob::run()
+{
+    // Requests only join the job while it is pending, under the same lock, so
+    // once it is removed the waiters can only drop. Later requests start a new
+    // job.
+    {
+        QMutexLocker locker(&m_provider->pendingMutex);
+        m_provider->pending.remove(key);
+        if (waiters.load() == 0) {
+            return;
         }
     }
-    return img;
+
+    result = m_provider->decode(key, m_colorScheme);
+    if (!result.isNull()) {
+        m_provider->insertCached(key, result);
+    }
+
+    emit finished();
 }
+
+ThemeImageResponse::ThemeImageResponse(const ThemeImage &image, const QColor &color)
+    : m_image(image)
+    , m_color(color)
+{
+    // The reader connects to finished() only after the response is returned.
+    QMetaObject::invokeMethod(this, "finished", Qt::QueuedConnection);
 }
 
-#ifdef UNIT_TEST
-QImage Silica::ImageProvider::colorize(QImage &image, QColor color)
+ThemeImageResponse::ThemeImageResponse(const QSharedPointer<ImageDecodeJob> &job, const QColor &color)
+    : m_job(job)
+    , m_color(color)
 {
-    return colorizeMonochrome(image, color);
+    m_job->waiters.ref();
+    connect(m_job.data(), &ImageDecodeJob::finished, this, &ThemeImageResponse::handleFinished);
 }
-#endif
 
-ImageProvider::ImageProvider(InitFlags initFlags)
-    : QQuickImageProvider(QQuickImageProvider::Texture)
-    , d_ptr(new Silica::ImageProviderPrivate)
+ThemeImageResponse::~ThemeImageResponse()
 {
-    Q_UNUSED(initFlags)
+    release();
 }
 
-ImageProvider::~ImageProvider() = default;
+QQuickTextureFactory *ThemeImageResponse::textureFactory() const
+{
+    return !m_image.isNull() ? m_image.textureFactory(m_color) : nullptr;
+}
 
-void ImageProvider::addIconRoot(const QString &path)
+QString ThemeImageResponse::errorString() const
 {
-    d_ptr->iconResolver.addIconRoot(path);
+    return m_image.isNull() ? QStringLiteral("Failed to load theme image") : QString();
 }
 
-QQuickTextureFactory *ImageProvider::requestTexture(const QString &id, QSize *size, const QSize &requestedSize)
+void ThemeImageResponse::cancel()
 {
-    // Parse parameters like "id?color=#RRGGBB"
-    QString iconId = id;
-    QColor overrideColor;
-    int queryPos = id.indexOf('?');
-    if (queryPos > 0) {
-        const QString base = id.left(queryPos);
-        const QUrl url(QString::fromLatin1("image://theme/") + id);
-        QUrlQuery q(url);
-        const QString colorStr = q.queryItemValue(QStringLiteral("color"));
-        if (!colorStr.isEmpty()) {
-            overrideColor = QColor(colorStr);
-        }
-        iconId = base;
+    release();
+}
+
+void ThemeImageResponse::handleFinished()
+{
+    m_image = m_job->result;
+    release();
+    emit finished();
+}
+
+void ThemeImageResponse::release()
+{
+    if (m_job) {
+        disconnect(m_job.data(), nullptr, this, nullptr);
+        m_job->waiters.deref();
+        m_job.reset();
     }
+}
 
-    const QString cacheKey = iconId + QLatin1Char('|')
-                           + QString::number(requestedSize.width())
-                           + QLatin1Char('x')
-                           + QString::number(requestedSize.height())
-                           + QLatin1Char('|')
-                           + (overrideColor.isValid() ? overrideColor.name() : QString());
+ImageProviderPrivate::ImageProviderPrivate()
+    : cacheLimit(DefaultCacheLimit)
+{
+    setShardLimits(DefaultCacheLimit);
+    decodePool.setMaxThreadCount(qBound(1, QThread::idealThreadCount(), DefaultMaxDecodeThreads));
+}
+
+int ImageProviderPrivate::imageCost(const QImage &image)
+{
+    return int(qMin<qint64>(image.sizeInBytes(), INT_MAX));
+}
+
+ImageProviderPrivate::CacheShard &ImageProviderPrivate::shard(const ImageCacheKey &key)
+{
+    return shards[qHash(key) % CacheShardCount];
+}
 
-    if (d_ptr->cache.contains(cacheKey)) {
-        const QImage &img = d_ptr->cache[cacheKey];
-        if (size) *size = img.size();
-        return QQuickTextureFactory::textureFactoryForImage(img);
+bool ImageProviderPrivate::findCached(const ImageCacheKey &key, ThemeImage *image)
+{
+    CacheShard &cacheShard = shard(key);
+    QMutexLocker locker(&cacheShard.mutex);
+    if (const ThemeImage *cached = cacheShard.cache.object(key)) {
+        *image = *cached;
+        return true;
     }
+    return false;
+}
 
-    const IconInfo info = d_ptr->iconResolver.resolveIcon(iconId, Theme::instance()->colorScheme());
+void ImageProviderPrivate::insertCached(const ImageCacheKey &key, const ThemeImage &image)
+{
+    CacheShard &cacheShard = shard(key);
+    QMutexLocker locker(&cacheShard.mutex);
+    cacheShard.cache.insert(key, new ThemeImage(image), imageCost(image.image));
+}
 
+void ImageProviderPrivate::setShardLimits(int bytes)
+{
+    const int shardLimit = (bytes + CacheShardCount - 1) / CacheShardCount;
+    for (CacheShard &cacheShard : shards) {
+        QMutexLocker locker(&cacheShard.mutex);
+        cacheShard.cache.setMaxCost(shardLimit);
+    }
+}
+
+ThemeImage ImageProviderPrivate::decode(const ImageCacheKey &key, Theme::ColorScheme colorScheme)
+{
+    const IconInfo info = iconResolver.resolveIcon(key.id, colorScheme);
+
+    ThemeImage result;
     if (info.filePath().isEmpty()) {
-        // Return nullptr for unknown icons
-        if (size) *size = QSize();
-        return nullptr;
+        // Unknown icon
+        return result;
     }
 
+    // Scale while decoding so that the mask is extracted from the final pixels.
     QImageReader reader(info.filePath());
-    QImage img = reader.read();
-    if (img.isNull()) {
-        // Return nullptr for unreadable images
-        if (size) *size = QSize();
-        return nullptr;
+    if (key.size.isValid()) {
+        reader.setScaledSize(key.size);
+    }
+    result.image = reader.read();
+    if (result.image.isNull()) {
+        // Unreadable image
+        return result;
     }
 
-    const bool monochrome = (info.iconType() == IconInfo::MonochromeIcon) || parseMonochromeId(iconId);
+    const bool monochrome = (info.iconType() == IconInfo::MonochromeIcon) || parseMonochromeId(key.id);
     if (monochrome) {
-        QColor color = overrideColor.isValid() ? overrideColor : Theme::instance()->primaryColor();
-        img = colorizeMonochrome(img, color);
+        result.image = result.image.convertToFormat(QImage::Format_Alpha8);
+        result.mask.reset(new ThemeMaskTextureFactory(result.image));
     }
 
-    if (requestedSize.isValid()) {
-        img = img.scaled(requestedSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    return result;
+}
+
+ImageProvider::ImageProvider(InitFlags initFlags)
+    : QQuickAsyncImageProvider()
+    , d_ptr(new Silica::ImageProviderPrivate)
+{
+    Q_UNUSED(initFlags)
+
+    if (QGuiApplication *application = qobject_cast<QGuiApplication *>(QCoreApplication::instance())) {
+        d_ptr->applicationStateConnection = QObject::connect(
+                    application, &QGuiApplication::applicationStateChanged,
+                    [this](Qt::ApplicationState state) {
+            if (state != Qt::ApplicationActive) {
+                trimCache(cacheLimit() / 4);
+            }
+        });
     }
+}
+
+ImageProvider::~ImageProvider()
+{
+    QObject::disconnect(d_ptr->applicationStateConnection);
+    d_ptr->decodePool.waitForDone();
+    delete d_ptr;
+}
 
-    d_ptr->cache.insert(cacheKey, img);
-    if (size) *size = img.size();
-    return QQuickTextureFactory::textureFactoryForImage(img);
+void ImageProvider::addIconRoot(const QString &path)
+{
+    d_ptr->iconResolver.addIconRoot(path);
+}
+
+void ImageProvider::setCacheLimit(int bytes)
+{
+    d_ptr->cacheLimit.store(qMax(0, bytes));
+    d_ptr->setShardLimits(qMax(0, bytes));
+}
+
+int ImageProvider::cacheLimit() const
+{
+    return d_ptr->cacheLimit.load();
+}
+
+int ImageProvider::cacheSize() const
+{
+    int size = 0;
+    for (ImageProviderPrivate::CacheShard &cacheShard : d_ptr->shards) {
+        QMutexLocker locker(&cacheShard.mutex);
+        size += cacheShard.cache.totalCost();
+    }
+    return size;
+}
+
+void ImageProvider::trimCache(int bytes)
+{
+    // QCache evicts the least recently used entries whenever the limit shrinks.
+    d_ptr->setShardLimits(qMax(0, bytes));
+    d_ptr->setShardLimits(d_ptr->cacheLimit.load());
+}
+
+void ImageProvider::setMaxDecodeThreads(int count)
+{
+    d_ptr->decodePool.setMaxThreadCount(qMax(1, count));
+}
+
+int ImageProvider::maxDecodeThreads() const
+{
+    return d_ptr->decodePool.maxThreadCount();
+}
+
+QQuickTextureFactory *ImageProvider::requestTexture(const QString &id, QSize *size, const QSize &requestedSize)
+{
+    QColor color;
+    const ImageCacheKey cacheKey = parseImageId(id, requestedSize, &color);
+
+    ThemeImage image;
+    if (!d_ptr->findCached(cacheKey, &image)) {
+        image = d_ptr->decode(cacheKey, Theme::instance()->colorScheme());
+        if (image.isNull()) {
+            // Return nullptr for unknown or unreadable images
+            if (size) *size = QSize();
+            return nullptr;
+        }
+        d_ptr->insertCached(cacheKey, image);
+    }
+
+    if (size) *size = image.image.size();
+    return image.textureFactory(color);
+}
+
+QQuickImageResponse *ImageProvider::requestImageResponse(const QString &id, const QSize &requestedSize)
+{
+    QColor color;
+    const ImageCacheKey cacheKey = parseImageId(id, requestedSize, &color);
+
+    ThemeImage image;
+    if (d_ptr->findCached(cacheKey, &image)) {
+        return new ThemeImageResponse(image, color);
+    }
+
+    QMutexLocker locker(&d_ptr->pendingMutex);
+    QSharedPointer<ImageDecodeJob> job = d_ptr->pending.value(cacheKey);
+    if (!job && d_ptr->findCached(cacheKey, &image)) {
+        // Finished in between
+        return new ThemeImageResponse(image, color);
+    } else if (!job) {
+        // Deleted from the requesting thread, the last reference may be dropped
+        // by a decode thread.
+        job = QSharedPointer<ImageDecodeJob>(
+                    new ImageDecodeJob(d_ptr, cacheKey, Theme::instance()->colorScheme()),
+                    &QObject::deleteLater);
+        d_ptr->pending.insert(cacheKey, job);
+        ThemeImageResponse *response = new ThemeImageResponse(job, color);
+        d_ptr->decodePool.start(new ImageDecodeRunnable(job));
+        return response;
+    }
+    return new ThemeImageResponse(job, color);
 }
@@ -59,7 +59,7 @@ namespace Silica {
 
 class ImageProviderPrivate;
 
-class SAILFISH_SILICA_EXPORT ImageProvider : public QQuickImageProvider
+class SAILFISH_SILICA_EXPORT ImageProvider : public QQuickAsyncImageProvider
 {
 public:
     enum InitFlags {
@@ -77,7 +77,25 @@ public:
     // can contain 'icons' and 'icons-monochrome' directories for the icon content.
     void addIconRoot(const QString &path);
 
+    // Limit in bytes for the decoded images kept for reuse. The least recently
+    // requested images are dropped first when the limit is exceeded.
+    void setCacheLimit(int bytes);
+    int cacheLimit() const;
+    int cacheSize() const;
+
+    // Drop cached images until no more than the given number of bytes remain, for
+    // example when the application receives a low memory notification. The cache
+    // is trimmed to a quarter of its limit when the application leaves the
+    // active state.
+    void trimCache(int bytes = 0);
+
+    // Maximum number of threads decoding icons for image responses. Requests for
+    // an image that is already being decoded wait for that decode instead.
+    void setMaxDecodeThreads(int count);
+    int maxDecodeThreads() const;
+
     QQuickTextureFactory *requestTexture(const QString &id, QSize *size, const QSize &requestedSize) override;
+    QQuickImageResponse *requestImageResponse(const QString &id, const QSize &requestedSize) override;
 
 #ifdef UNIT_TEST
     static QImage colorize(QImage &image, QColor color);
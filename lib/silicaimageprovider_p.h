@@ -2,16 +2,134 @@
 #define SILICA_IMAGEPROVIDER_P_H
 
 #include "silicaimageprovider.h"
+#include "themetexturefactory.h"
+#include <QAtomicInt>
+#include <QCache>
+#include <QColor>
 #include <QHash>
+#include <QImage>
+#include <QMetaObject>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QSize>
+#include <QThreadPool>
 
 namespace Silica {
 
+// Monochrome icons are cached as alpha masks and colorized only when a texture
+// is requested, so the key doesn't include the color.
+struct ImageCacheKey {
+    QString id;
+    QSize size;
+};
+
+inline bool operator ==(const ImageCacheKey &lhs, const ImageCacheKey &rhs)
+{
+    return lhs.id == rhs.id && lhs.size == rhs.size;
+}
+
+inline uint qHash(const ImageCacheKey &key, uint seed = 0)
+{
+    uint hash = qHash(key.id, seed);
+    hash = 31 * hash + uint(key.size.width());
+    hash = 31 * hash + uint(key.size.height());
+    return hash;
+}
+
+// A decoded image, or the mask of a monochrome icon.
+struct ThemeImage {
+    QImage image;
+    QSharedPointer<ThemeMaskTextureFactory> mask;
+
+    bool isNull() const { return image.isNull(); }
+    QQuickTextureFactory *textureFactory(const QColor &color) const;
+};
+
+class ImageProviderPrivate;
+
+// Decodes one image on the provider's thread pool. All responses requesting the
+// same key while it runs share the job and receive its result.
+class ImageDecodeJob : public QObject
+{
+    Q_OBJECT
+public:
+    ImageDecodeJob(ImageProviderPrivate *provider, const ImageCacheKey &key, Theme::ColorScheme colorScheme);
+
+    void run();
+
+    const ImageCacheKey key;
+    // Responses still waiting for the result, the decode is skipped if all of
+    // them were cancelled before it started.
+    QAtomicInt waiters;
+    // Written before finished() is emitted.
+    ThemeImage result;
+
+signals:
+    void finished();
+
+private:
+    ImageProviderPrivate *m_provider;
+    Theme::ColorScheme m_colorScheme;
+};
+
+class ThemeImageResponse : public QQuickImageResponse
+{
+    Q_OBJECT
+public:
+    ThemeImageResponse(const ThemeImage &image, const QColor &color);
+    ThemeImageResponse(const QSharedPointer<ImageDecodeJob> &job, const QColor &color);
+    ~ThemeImageResponse() override;
+
+    QQuickTextureFactory *textureFactory() const override;
+    QString errorString() const override;
+    void cancel() override;
+
+private slots:
+    void handleFinished();
+
+private:
+    void release();
+
+    QSharedPointer<ImageDecodeJob> m_job;
+    ThemeImage m_image;
+    QColor m_color;
+};
+
 class ImageProviderPrivate {
 public:
+    enum { CacheShardCount = 8 };
+
+    // The cache is split by key hash so that decode threads inserting images
+    // rarely contend for the same lock. Every shard gets an equal part of the
+    // limit and evicts its own least recently requested images.
+    struct CacheShard {
+        QCache<ImageCacheKey, ThemeImage> cache;
+        QMutex mutex;
+    };
+
+    ImageProviderPrivate();
+
+    static int imageCost(const QImage &image);
+
+    CacheShard &shard(const ImageCacheKey &key);
+    bool findCached(const ImageCacheKey &key, ThemeImage *image);
+    void insertCached(const ImageCacheKey &key, const ThemeImage &image);
+    void setShardLimits(int bytes);
+
+    ThemeImage decode(const ImageCacheKey &key, Theme::ColorScheme colorScheme);
+
     ThemeIconResolver iconResolver;
-    QHash<QString, QImage> cache;
+
+    CacheShard shards[CacheShardCount];
+    QAtomicInt cacheLimit;
+    QMetaObject::Connection applicationStateConnection;
+
+    // Decodes in progress, keyed like the cache.
+    QHash<ImageCacheKey, QSharedPointer<ImageDecodeJob>> pending;
+    QMutex pendingMutex;
+    QThreadPool decodePool;
 };
 
 } // namespace Silica
 
-#endif
\ No newline at end of file
+#endif
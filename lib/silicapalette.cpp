@@ -2,57 +2,196 @@
 #include "silicapalette_p.h"
 #include "silicatheme_p.h"
 
+#include <QMetaMethod>
+
 namespace Silica {
 
 PalettePrivate::PalettePrivate()
-    : m_colorScheme(Theme::LightOnDark)
+    : q_ptr(nullptr)
+    , m_explicitColors{}
     , m_explicitColorScheme(false)
-    , q_ptr(nullptr)
+    , m_colorScheme(Theme::LightOnDark)
+    , m_resolvedGeneration(0)
+    , m_generation(ThemeColors::nextGeneration())
     , m_parent(nullptr)
     , m_themeColors(ThemePrivate::instance()->themeColors())
-    , m_explicitColors{}
 {
 }
 
-QColor& PalettePrivate::colorFromIndex(ColorIndex index)
+PalettePrivate::~PalettePrivate()
 {
-    switch (index) {
-    case ColorIndex::Primary: return m_primaryColor;
-    case ColorIndex::Secondary: return m_secondaryColor;
-    case ColorIndex::Highlight: return m_highlightColor;
-    case ColorIndex::SecondaryHighlight: return m_secondaryHighlightColor;
-    case ColorIndex::HighlightBackground: return m_highlightBackgroundColor;
-    case ColorIndex::HighlightDimmer: return m_highlightDimmerColor;
-    case ColorIndex::OverlayBackground: return m_overlayBackgroundColor;
-    case ColorIndex::BackgroundGlow: return m_backgroundGlowColor;
-    case ColorIndex::Error: return m_errorColor;
-    case ColorIndex::WallpaperOverlay: return m_wallpaperOverlayColor;
-    case ColorIndex::CoverOverlay: return m_coverOverlayColor;
-    default:
-        Q_ASSERT_X(false, "PalettePrivate::colorFromIndex", "Invalid color index");
-        return m_primaryColor;
+    if (m_parent)
+        m_parent->m_children.remove(this);
+    for (PalettePrivate *child : m_children)
+        child->m_parent = nullptr;
+    if (m_themeColors)
+        m_themeColors->removePalette(this);
+}
+
+quint64 PalettePrivate::generation() const
+{
+    // Generations are taken from one counter, so the newest of the chain
+    // changes whenever anything the colors derive from does.
+    const quint64 inherited = m_parent ? m_parent->generation() : m_themeColors->generation();
+    return qMax(m_generation, inherited);
+}
+
+void PalettePrivate::resolve() const
+{
+    const quint64 current = generation();
+    if (m_resolvedGeneration == current) {
+        return;
+    }
+    m_resolvedGeneration = current;
+
+    if (!m_explicitColorScheme) {
+        m_colorScheme = m_parent ? m_parent->colorScheme()
+            : ThemePrivate::instance()->m_colorScheme;
     }
+
+    for (int i = 0; i < ColorCount; ++i) {
+        if (!m_explicitColors[i]) {
+            m_colors[i] = derivativeColor(static_cast<ColorIndex>(i));
+        }
+    }
+}
+
+Theme::ColorScheme PalettePrivate::colorScheme() const
+{
+    resolve();
+    return m_colorScheme;
+}
+
+QColor PalettePrivate::color(ColorIndex index) const
+{
+    resolve();
+    return m_colors[static_cast<int>(index)];
+}
+
+QColor PalettePrivate::derivativeColor(ColorIndex index) const
+{
+    if (m_parent) {
+        return m_parent->color(index);
+    }
+
+    // We map directly to the same ColorIndex enum
+    return m_themeColors->color(index);
 }
 
 void PalettePrivate::setColorScheme(Theme::ColorScheme scheme, bool isExplicit)
 {
-    m_explicitColorScheme = isExplicit;
+    if (m_explicitColorScheme == isExplicit && (!isExplicit || m_colorScheme == scheme)) {
+        return;
+    }
 
-    if (m_colorScheme != scheme) {
+    m_explicitColorScheme = isExplicit;
+    if (isExplicit) {
         m_colorScheme = scheme;
+    }
+    invalidate();
+    notifyChanged(true);
+}
+
+void PalettePrivate::setColor(ColorIndex index, const QColor &color)
+{
+    const int i = static_cast<int>(index);
+    const bool isExplicit = color.isValid();
+    if (m_explicitColors[i] == isExplicit && (!isExplicit || m_colors[i] == color)) {
+        return;
+    }
 
-        if (q_ptr) {
+    m_explicitColors[i] = isExplicit;
+    if (isExplicit) {
+        m_colors[i] = color;
+    }
+    invalidate();
+    notifyChanged(true);
+}
+
+void PalettePrivate::updateParent(PalettePrivate* parent)
+{
+    if (m_parent == parent)
+        return;
+
+    if (m_parent)
+        m_parent->m_children.remove(this);
+
+    m_parent = parent;
+
+    if (m_parent)
+        m_parent->m_children.insert(this);
+
+    invalidate();
+    notifyChanged(true);
+}
+
+void PalettePrivate::invalidate()
+{
+    m_generation = ThemeColors::nextGeneration();
+}
+
+void PalettePrivate::notifyChanged(bool recursive)
+{
+    if (m_notified) {
+        resolve();
+
+        // Handlers may read the palette, so record what they see first.
+        if (m_notified->colorScheme != m_colorScheme) {
+            m_notified->colorScheme = m_colorScheme;
             emit q_ptr->colorSchemeChanged();
         }
+        for (int i = 0; i < ColorCount; ++i) {
+            if (m_notified && m_notified->colors[i] != m_colors[i]) {
+                m_notified->colors[i] = m_colors[i];
+                emitColorChanged(static_cast<ColorIndex>(i));
+            }
+        }
+    }
 
-        // Propagate to child palettes that don't have explicit color scheme
+    // Theme changes reach every watched palette directly, changes to this
+    // palette only through its children.
+    if (recursive) {
         for (PalettePrivate *child : m_children) {
-            if (!child->m_explicitColorScheme) {
-                child->setColorScheme(scheme, false);
-            }
+            child->notifyChanged(true);
         }
+    }
+}
+
+void PalettePrivate::updateWatched()
+{
+    static const QMetaMethod changeSignals[] = {
+        QMetaMethod::fromSignal(&Palette::colorSchemeChanged),
+        QMetaMethod::fromSignal(&Palette::primaryColorChanged),
+        QMetaMethod::fromSignal(&Palette::secondaryColorChanged),
+        QMetaMethod::fromSignal(&Palette::highlightColorChanged),
+        QMetaMethod::fromSignal(&Palette::secondaryHighlightColorChanged),
+        QMetaMethod::fromSignal(&Palette::highlightBackgroundColorChanged),
+        QMetaMethod::fromSignal(&Palette::highlightDimmerColorChanged),
+        QMetaMethod::fromSignal(&Palette::overlayBackgroundColorChanged),
+        QMetaMethod::fromSignal(&Palette::backgroundGlowColorChanged),
+        QMetaMethod::fromSignal(&Palette::errorColorChanged),
+        QMetaMethod::fromSignal(&Palette::wallpaperOverlayColorChanged),
+        QMetaMethod::fromSignal(&Palette::coverOverlayColorChanged)
+    };
+
+    bool watched = false;
+    for (const QMetaMethod &signal : changeSignals) {
+        if (q_ptr->isSignalConnected(signal)) {
+            watched = true;
+            break;
+        }
+    }
 
-        updateColors();
+    if (bool(m_notified) != watched) {
+        if (watched) {
+            // Observers start from the current colors.
+            resolve();
+            m_notified.reset(new Notified { m_colors, m_colorScheme });
+            m_themeColors->addPalette(this);
+        } else {
+            m_notified.reset();
+            m_themeColors->removePalette(this);
+        }
     }
 }
 
@@ -101,137 +240,32 @@ void PalettePrivate::emitColorChanged(ColorIndex index)
     }
 }
 
-void PalettePrivate::setColor(ColorIndex index, const QColor &color, bool isExplicit)
-{
-    m_explicitColors[static_cast<size_t>(index)] = isExplicit;
-    QColor &currentColor = colorFromIndex(index);
-
-    if (currentColor != color) {
-        currentColor = color;
-        emitColorChanged(index);
-
-        // Handle derivative colors when highlight color changes
-        if (index == ColorIndex::Highlight && !color.isValid()) {
-            resetDerivativeColors();
-        }
-
-        // Propagate to child palettes that don't have explicit colors
-        for (PalettePrivate *child : m_children) {
-            if (!child->m_explicitColors[static_cast<size_t>(index)]) {
-                child->resetColor(index);
-            }
-        }
-    }
-}
-
-void PalettePrivate::resetDerivativeColors()
-{
-    static const ColorIndex derivatives[] = {
-        ColorIndex::SecondaryHighlight,
-        ColorIndex::HighlightBackground,
-        ColorIndex::HighlightDimmer,
-        ColorIndex::BackgroundGlow,
-        ColorIndex::CoverOverlay
-    };
-
-    for (ColorIndex index : derivatives) {
-        if (!m_explicitColors[static_cast<size_t>(index)]) {
-            resetColor(index);
-        }
-    }
-}
-
-void PalettePrivate::resetColor(ColorIndex index)
-{
-    setColor(index, derivativeColor(index), false);
-}
-
-QColor PalettePrivate::derivativeColor(ColorIndex index) const
-{
-    if (m_parent) {
-        return m_parent->derivativeColor(index);
-    }
-
-    // We map directly to the same ColorIndex enum
-    return m_themeColors->color(index);
-}
-
-void PalettePrivate::updateParent(PalettePrivate* parent)
-{
-    if (m_parent == parent)
-        return;
-
-    if (m_parent)
-        m_parent->m_children.remove(this);
-
-    m_parent = parent;
-
-    if (m_parent)
-        m_parent->m_children.insert(this);
-    else if (m_themeColors)
-        m_themeColors->addPalette(this);
-
-    updateColors();
-}
-
-PalettePrivate::~PalettePrivate()
+Palette::Palette(QObject *parent)
+    : QObject(parent)
+    , d_ptr(new PalettePrivate)
 {
+    d_ptr->q_ptr = this;  // Set back-pointer to public class
 }
 
-void PalettePrivate::updateColors()
+Palette::~Palette()
 {
-    if (!m_explicitColorScheme) {
-        Theme::ColorScheme themeScheme = m_parent ? m_parent->m_colorScheme
-            : ThemePrivate::instance()->m_colorScheme;
-        if (m_colorScheme != themeScheme) {
-            setColorScheme(themeScheme, false);
-            return; // setColorScheme will call updateColors() again, so we're done
-        }
-    }
-
-    // For each color index, if not explicitly set, derive value
-    const ColorIndex allIndices[] = {
-        ColorIndex::Primary,
-        ColorIndex::Secondary,
-        ColorIndex::Highlight,
-        ColorIndex::SecondaryHighlight,
-        ColorIndex::HighlightBackground,
-        ColorIndex::HighlightDimmer,
-        ColorIndex::OverlayBackground,
-        ColorIndex::BackgroundGlow,
-        ColorIndex::Error,
-        ColorIndex::WallpaperOverlay,
-        ColorIndex::CoverOverlay
-    };
-
-    for (ColorIndex idx : allIndices) {
-        if (!m_explicitColors[static_cast<size_t>(idx)]) {
-            QColor value = derivativeColor(idx);
-            QColor &ref = colorFromIndex(idx);
-            if (ref != value) {
-                ref = value;
-                emitColorChanged(idx);
-            }
-        }
-    }
 }
 
-Palette::Palette(QObject *parent)
-    : QObject(parent)
-    , d_ptr(new PalettePrivate)
+void Palette::connectNotify(const QMetaMethod &signal)
 {
-    d_ptr->q_ptr = this;  // Set back-pointer to public class
-    d_ptr->m_themeColors->addPalette(d_ptr.get());
-    d_ptr->updateColors();
+    Q_UNUSED(signal)
+    d_ptr->updateWatched();
 }
 
-Palette::~Palette()
+void Palette::disconnectNotify(const QMetaMethod &signal)
 {
+    Q_UNUSED(signal)
+    d_ptr->updateWatched();
 }
 
 Theme::ColorScheme Palette::colorScheme() const
 {
-    return d_ptr->m_colorScheme;
+    return d_ptr->colorScheme();
 }
 
 void Palette::setColorScheme(Theme::ColorScheme scheme)
@@ -241,17 +275,17 @@ void Palette::setColorScheme(Theme::ColorScheme scheme)
 
 void Palette::resetColorScheme()
 {
-    setColorScheme(Theme::LightOnDark);
+    d_ptr->setColorScheme(Theme::LightOnDark, false);
 }
 
 QColor Palette::primaryColor() const
 {
-    return d_ptr->m_primaryColor;
+    return d_ptr->color(ColorIndex::Primary);
 }
 
 void Palette::setPrimaryColor(const QColor &color)
 {
-    d_ptr->setColor(ColorIndex::Primary, color, true);
+    d_ptr->setColor(ColorIndex::Primary, color);
 }
 
 void Palette::resetPrimaryColor()
@@ -261,12 +295,12 @@ void Palette::resetPrimaryColor()
 
 QColor Palette::secondaryColor() const
 {
-    return d_ptr->m_secondaryColor;
+    return d_ptr->color(ColorIndex::Secondary);
 }
 
 void Palette::setSecondaryColor(const QColor &color)
 {
-    d_ptr->setColor(ColorIndex::Secondary, color, true);
+    d_ptr->setColor(ColorIndex::Secondary, color);
 }
 
 void Palette::resetSecondaryColor() const
@@ -276,12 +310,12 @@ void Palette::resetSecondaryColor() const
 
 QColor Palette::highlightColor() const
 {
-    return d_ptr->m_highlightColor;
+    return d_ptr->color(ColorIndex::Highlight);
 }
 
 void Palette::setHighlightColor(const QColor &color)
 {
-    d_ptr->setColor(ColorIndex::Highlight, color, true);
+    d_ptr->setColor(ColorIndex::Highlight, color);
 }
 
 void Palette::resetHighlightColor()
@@ -291,12 +325,12 @@ void Palette::resetHighlightColor()
 
 QColor Palette::secondaryHighlightColor() const
 {
-    return d_ptr->m_secondaryHighlightColor;
+    return d_ptr->color(ColorIndex::SecondaryHighlight);
 }
 
 void Palette::setSecondaryHighlightColor(const QColor &color)
 {
-    d_ptr->setColor(ColorIndex::SecondaryHighlight, color, true);
+    d_ptr->setColor(ColorIndex::SecondaryHighlight, color);
 }
 
 void Palette::resetSecondaryHighlightColor()
@@ -306,12 +340,12 @@ void Palette::resetSecondaryHighlightColor()
 
 QColor Palette::highlightBackgroundColor()
 {
-    return d_ptr->m_highlightBackgroundColor;
+    return d_ptr->color(ColorIndex::HighlightBackground);
 }
 
 void Palette::setHighlightBackgroundColor(const QColor &color)
 {
-    d_ptr->setColor(ColorIndex::HighlightBackground, color, true);
+    d_ptr->setColor(ColorIndex::HighlightBackground, color);
 }
 
 void Palette::resetHighlightBackgroundColor()
@@ -321,12 +355,12 @@ void Palette::resetHighlightBackgroundColor()
 
 QColor Palette::highlightDimmerColor()
 {
-    return d_ptr->m_highlightDimmerColor;
+    return d_ptr->color(ColorIndex::HighlightDimmer);
 }
 
 void Palette::setHighlightDimmerColor(const QColor &color)
 {
-    d_ptr->setColor(ColorIndex::HighlightDimmer, color, true);
+    d_ptr->setColor(ColorIndex::HighlightDimmer, color);
 }
 
 void Palette::resetHighlightDimmerColor()
@@ -336,12 +370,12 @@ void Palette::resetHighlightDimmerColor()
 
 QColor Palette::overlayBackgroundColor() const
 {
-    return d_ptr->m_overlayBackgroundColor;
+    return d_ptr->color(ColorIndex::OverlayBackground);
 }
 
 void Palette::setOverlayBackgroundColor(const QColor &color)
 {
-    d_ptr->setColor(ColorIndex::OverlayBackground, color, true);
+    d_ptr->setColor(ColorIndex::OverlayBackground, color);
 }
 
 void Palette::resetOverlayBackgroundColor()
@@ -351,12 +385,12 @@ void Palette::resetOverlayBackgroundColor()
 
 QColor Palette::backgroundGlowColor() const
 {
-    return d_ptr->m_backgroundGlowColor;
+    return d_ptr->color(ColorIndex::BackgroundGlow);
 }
 
 void Palette::setBackgroundGlowColor(const QColor &color)
 {
-    d_ptr->setColor(ColorIndex::BackgroundGlow, color, true);
+    d_ptr->setColor(ColorIndex::BackgroundGlow, color);
 }
 
 void Palette::resetBackgroundGlowColor()
@@ -366,12 +400,12 @@ void Palette::resetBackgroundGlowColor()
 
 QColor Palette::errorColor() const
 {
-    return d_ptr->m_errorColor;
+    return d_ptr->color(ColorIndex::Error);
 }
 
 void Palette::setErrorColor(const QColor &color)
 {
-    d_ptr->setColor(ColorIndex::Error, color, true);
+    d_ptr->setColor(ColorIndex::Error, color);
 }
 
 void Palette::resetErrorColor()
@@ -381,12 +415,12 @@ void Palette::resetErrorColor()
 
 QColor Palette::wallpaperOverlayColor() const
 {
-    return d_ptr->m_wallpaperOverlayColor;
+    return d_ptr->color(ColorIndex::WallpaperOverlay);
 }
 
 QColor Palette::coverOverlayColor() const
 {
-    return d_ptr->m_coverOverlayColor;
+    return d_ptr->color(ColorIndex::CoverOverlay);
 }
 
 } // namespace Silica
@@ -112,6 +112,10 @@ signals:
     void wallpaperOverlayColorChanged();
     void coverOverlayColorChanged();
 
+protected:
+    void connectNotify(const QMetaMethod &signal) override;
+    void disconnectNotify(const QMetaMethod &signal) override;
+
 private:
     QColor wallpaperOverlayColor() const;
     QColor coverOverlayColor() const;
@@ -4,11 +4,21 @@
 #include <silicapalette.h>
 #include <silicatheme.h>
 #include "themecolors.h"
+#include <QColor>
 #include <QSet>
 #include <array>
+#include <memory>
 
 namespace Silica {
 
+// Palette colors are resolved lazily. Every change to the theme colors or to
+// a palette takes a new generation number, and a palette only derives its
+// colors again when one is read and its own generation or that of a palette
+// it inherits from is newer than the colors it has.
+//
+// Change signals are only emitted by palettes with connected signals, which
+// ThemeColors tracks, so a theme change costs in proportion to the number of
+// palettes with bound colors rather than all palettes.
 class PalettePrivate
 {
 public:
@@ -21,36 +31,48 @@ public:
     PalettePrivate();
     ~PalettePrivate();
 
+    Theme::ColorScheme colorScheme() const;
+    QColor color(ColorIndex index) const;
+
     void setColorScheme(Theme::ColorScheme scheme, bool isExplicit);
-    void updateColors();
-    QColor derivativeColor(ColorIndex index) const;
-    void setColor(ColorIndex index, const QColor &color, bool isExplicit);
-    void resetColor(ColorIndex index);
+    void setColor(ColorIndex index, const QColor &color);
     void updateParent(PalettePrivate* parent);
 
-    Theme::ColorScheme m_colorScheme;
-    QColor m_primaryColor;
-    QColor m_secondaryColor;
-    QColor m_highlightColor;
-    QColor m_secondaryHighlightColor;
-    QColor m_highlightBackgroundColor;
-    QColor m_highlightDimmerColor;
-    QColor m_overlayBackgroundColor;
-    QColor m_backgroundGlowColor;
-    QColor m_errorColor;
-    QColor m_wallpaperOverlayColor;
-    QColor m_coverOverlayColor;
-    bool m_explicitColorScheme;
+    // Emits the change signals for colors which differ from those last
+    // notified, if anything is connected to them.
+    void notifyChanged(bool recursive);
+    void updateWatched();
+
     QSet<PalettePrivate*> m_children;
     Palette *q_ptr;
 
 private:
-    using ColorChangedSignal = void (Palette::*)();
-    void resetDerivativeColors();
+    static const int ColorCount = static_cast<int>(ColorIndex::ColorCount);
+
+    quint64 generation() const;
+    void resolve() const;
+    QColor derivativeColor(ColorIndex index) const;
+    void invalidate();
     void emitColorChanged(ColorIndex index);
-    QColor& colorFromIndex(ColorIndex index);
 
-    std::array<bool, static_cast<std::size_t>(ColorIndex::ColorCount)> m_explicitColors;
+    std::array<bool, ColorCount> m_explicitColors;
+    bool m_explicitColorScheme;
+
+    // Explicit colors and the scheme are set directly, the others are derived
+    // when resolved.
+    mutable std::array<QColor, ColorCount> m_colors;
+    mutable Theme::ColorScheme m_colorScheme;
+    mutable quint64 m_resolvedGeneration;
+    quint64 m_generation;
+
+    // The colors and scheme observers last saw, only while watched. Kept apart
+    // from the resolved colors, which reading a child may update before this
+    // palette is notified.
+    struct Notified {
+        std::array<QColor, ColorCount> colors;
+        Theme::ColorScheme colorScheme;
+    };
+    std::unique_ptr<Notified> m_notified;
 
     PalettePrivate* m_parent;
     ThemeColors* m_themeColors;
@@ -4,10 +4,12 @@
 #include "silicathemeiconresolver.h"
 #include "themecolors.h"
 
+#include <QCache>
 #include <QDir>
 #include <QFont>
 #include <QPair>
 #include <QRegularExpression>
+#include <QStringMatcher>
 #include <QtMath>
 
 Q_GLOBAL_STATIC(Silica::Theme, themeInstance)
@@ -248,77 +250,215 @@ void ThemePrivate::loadThemeParameters()
     m_maximumFlickVelocity = themeParamValue(m_maximumFlickVelocity, "maximum_flickVelocity").toReal();
 }
 
-void ThemePrivate::processTextChunk(QString &result, QString &remainingText,
-                                  int matchStart, int matchLength,
-                                  const QString &format) const
+namespace {
+
+// A highlight pattern compiled once, reused while the same pattern is
+// highlighted in many texts, e.g. the rows of a search result list.
+class HighlightMatcher
 {
-    // Add text before match
-    if (matchStart > 0) {
-        result.append(remainingText.left(matchStart).toHtmlEscaped());
+public:
+    explicit HighlightMatcher(const QVariant &pattern)
+    {
+        if (pattern.type() == QVariant::RegExp) {
+            m_type = RegExp;
+            m_regExp = pattern.toRegExp();
+        } else if (pattern.type() == QVariant::RegularExpression) {
+            m_type = RegularExpression;
+            m_expression = pattern.toRegularExpression();
+            m_expression.optimize();
+        } else {
+            m_type = String;
+            m_string = QStringMatcher(pattern.toString(), Qt::CaseInsensitive);
+        }
+    }
+
+    static QString key(const QVariant &pattern)
+    {
+        if (pattern.type() == QVariant::RegExp) {
+            const QRegExp rx = pattern.toRegExp();
+            return QStringLiteral("x%1:%2:%3:").arg(int(rx.caseSensitivity())).arg(int(rx.patternSyntax()))
+                    .arg(int(rx.isMinimal())) + rx.pattern();
+        } else if (pattern.type() == QVariant::RegularExpression) {
+            const QRegularExpression re = pattern.toRegularExpression();
+            return QStringLiteral("r%1:").arg(int(re.patternOptions())) + re.pattern();
+        }
+        return QLatin1Char('s') + pattern.toString();
+    }
+
+    bool isEmpty() const
+    {
+        return m_type == String && m_string.pattern().isEmpty();
+    }
+
+    // Returns the start of the first match at or after from, or -1.
+    int indexIn(const QString &text, int from, int *length) const
+    {
+        int start = -1;
+        switch (m_type) {
+        case RegExp:
+            start = m_regExp.indexIn(text, from);
+            *length = m_regExp.matchedLength();
+            break;
+        case RegularExpression: {
+            const QRegularExpressionMatch match = m_expression.match(text, from);
+            if (match.hasMatch()) {
+                start = match.capturedStart();
+                *length = match.capturedLength();
+            }
+            break;
+        }
+        case String:
+            start = m_string.indexIn(text, from);
+            *length = m_string.pattern().length();
+            break;
+        }
+        return start;
     }
 
-    // Add highlighted match
-    QString match = remainingText.mid(matchStart, matchLength);
-    result.append(format.arg(match.toHtmlEscaped()));
+private:
+    enum Type { String, RegExp, RegularExpression };
 
-    // Update remaining text
-    remainingText = remainingText.mid(matchStart + matchLength);
+    Type m_type;
+    QStringMatcher m_string;
+    QRegExp m_regExp;
+    QRegularExpression m_expression;
+};
+
+typedef QCache<QString, HighlightMatcher> HighlightMatcherCache;
+Q_GLOBAL_STATIC_WITH_ARGS(HighlightMatcherCache, highlightMatchers, (16))
+
+const HighlightMatcher *highlightMatcher(const QVariant &pattern)
+{
+    const QString key = HighlightMatcher::key(pattern);
+    HighlightMatcher *matcher = highlightMatchers->object(key);
+    if (!matcher) {
+        matcher = new HighlightMatcher(pattern);
+        highlightMatchers->insert(key, matcher);
+    }
+    return matcher;
 }
 
-QString ThemePrivate::highlightText(const QString &text, const QVariant &pattern, const QColor &color) const
+void appendHtmlEscaped(QString *result, const QChar *begin, const QChar *end)
 {
-    if (text.isEmpty() || !pattern.isValid()) {
-        return text.toHtmlEscaped();
+    const QChar *run = begin;
+    for (const QChar *c = begin; c != end; ++c) {
+        const char *replacement = nullptr;
+        switch (c->unicode()) {
+        case '<': replacement = "&lt;"; break;
+        case '>': replacement = "&gt;"; break;
+        case '&': replacement = "&amp;"; break;
+        case '"': replacement = "&quot;"; break;
+        default: continue;
+        }
+        result->append(run, c - run);
+        result->append(QLatin1String(replacement));
+        run = c + 1;
     }
+    result->append(run, end - run);
+}
 
+QString highlighted(const QString &text, const HighlightMatcher *matcher,
+                    const QString &openTag, const QString &closeTag)
+{
+    const QChar *data = text.constData();
     QString result;
-    QString remainingText = text;
-    QString format = "<font color=\"%1\">%2</font>";
-    format = format.arg(color.name());
+    result.reserve(text.size() + openTag.size() + closeTag.size() + 16);
+
+    int written = 0;
+    int from = 0;
+    while (from <= text.size()) {
+        int length = 0;
+        const int start = matcher->indexIn(text, from, &length);
+        if (start < 0) {
+            break;
+        } else if (length <= 0) {
+            // Nothing to highlight in an empty match, look past it.
+            from = start + 1;
+            continue;
+        }
 
-    while (!remainingText.isEmpty()) {
-        int matchStart = -1;
-        int matchLength = 0;
+        appendHtmlEscaped(&result, data + written, data + start);
+        result += openTag;
+        appendHtmlEscaped(&result, data + start, data + start + length);
+        result += closeTag;
+        written = from = start + length;
+    }
+    appendHtmlEscaped(&result, data + written, data + text.size());
 
-        if (pattern.type() == QVariant::RegExp) {
-            QRegExp rx = pattern.toRegExp();
-            matchStart = rx.indexIn(remainingText);
-            if (matchStart >= 0) {
-                matchLength = rx.matchedLength();
-            }
-        }
-        else if (pattern.type() == QVariant::RegularExpression) {
-            QRegularExpression re = pattern.toRegularExpression();
-            QRegularExpressionMatch match = re.match(remainingText);
-            if (match.hasMatch()) {
-                matchStart = match.capturedStart();
-                matchLength = match.capturedLength();
-            }
-        }
-        else {
-            QString pat = pattern.toString();
-            if (!pat.isEmpty()) {
-                matchStart = remainingText.indexOf(pat, 0, Qt::CaseInsensitive);
-                if (matchStart >= 0) {
-                    matchLength = pat.length();
-                }
-            }
+    return result;
+}
+
+}
+
+QString ThemePrivate::highlightText(const QString &text, const QVariant &pattern, const QColor &color) const
+{
+    return highlightTextBatch(QStringList() << text, pattern, color).first();
+}
+
+QStringList ThemePrivate::highlightTextBatch(const QStringList &texts, const QVariant &pattern, const QColor &color) const
+{
+    const HighlightMatcher *matcher = pattern.isValid() ? highlightMatcher(pattern) : nullptr;
+    const QString openTag = QStringLiteral("<font color=\"%1\">").arg(color.name());
+    const QString closeTag = QStringLiteral("</font>");
+
+    QStringList result;
+    result.reserve(texts.count());
+    for (const QString &text : texts) {
+        if (text.isEmpty() || !matcher || matcher->isEmpty()) {
+            result.append(text.toHtmlEscaped());
+        } else {
+            result.append(highlighted(text, matcher, openTag, closeTag));
         }
+    }
+    return result;
+}
 
-        if (matchStart < 0) {
-            // No more matches - add remaining text and break
-            result.append(remainingText.toHtmlEscaped());
-            break;
+void ThemePrivate::beginTransaction()
+{
+    ++m_transactionDepth;
+}
+
+void ThemePrivate::commitTransaction()
+{
+    Q_ASSERT(m_transactionDepth > 0);
+    if (m_transactionDepth > 0 && --m_transactionDepth == 0) {
+        notify(Changes());
+    }
+}
+
+void ThemePrivate::notify(Changes changes)
+{
+    if (m_transactionDepth > 0) {
+        if (!m_pendingChanges && changes) {
+            m_pendingChanges = changes;
+            emit aboutToChange();
+        } else {
+            m_pendingChanges |= changes;
         }
+        return;
+    }
 
-        processTextChunk(result, remainingText, matchStart, matchLength, format);
+    changes |= m_pendingChanges;
+    m_pendingChanges = Changes();
+    if (!changes) {
+        return;
     }
 
-    return result;
+    // Palettes are settled before anything is notified, so handlers of the
+    // theme's signals see the final palette colors.
+    if (changes & PaletteChange) {
+        m_themeColors->refreshPalettes();
+    }
+    emit changed(changes);
 }
 
 void ThemePrivate::updateFontSizes()
 {
+    const int previousSizes[] = {
+        m_fontSizeTiny, m_fontSizeExtraSmall, m_fontSizeSmall, m_fontSizeMedium,
+        m_fontSizeLarge, m_fontSizeExtraLarge, m_fontSizeHuge
+    };
+
     // Get config values with empty/invalid checks
     QString category = m_gcFontSizeCategory.value().toString();
     double fontSizeMultiplier = 1.0;
@@ -381,14 +521,18 @@ void ThemePrivate::updateFontSizes()
         m_fontSizeHuge = qMin(fontSizeThreshold, m_fontSizeHuge);
     }
 
-    // Emit change signals
-    emit fontSizeTinyChanged();
-    emit fontSizeExtraSmallChanged();
-    emit fontSizeSmallChanged();
-    emit fontSizeMediumChanged();
-    emit fontSizeLargeChanged();
-    emit fontSizeExtraLargeChanged();
-    emit fontSizeHugeChanged();
+    // Notify the sizes which changed
+    const int sizes[] = {
+        m_fontSizeTiny, m_fontSizeExtraSmall, m_fontSizeSmall, m_fontSizeMedium,
+        m_fontSizeLarge, m_fontSizeExtraLarge, m_fontSizeHuge
+    };
+    Changes changes;
+    for (int i = 0; i < 7; ++i) {
+        if (sizes[i] != previousSizes[i]) {
+            changes |= Change(FontSizeTinyChange << i);
+        }
+    }
+    notify(changes);
 }
 
 QStringList ThemePrivate::launcherIconDirectories()
@@ -452,28 +596,44 @@ Theme *Theme::instance()
 
 Theme::Theme(QObject *parent)
     : QObject(parent)
-    , m_private(new ThemePrivate)
-{
-    // Connect font size change signals
-    connect(m_private, &ThemePrivate::fontSizeTinyChanged,
-            this, &Theme::fontSizeTinyChanged);
-    connect(m_private, &ThemePrivate::fontSizeExtraSmallChanged,
-            this, &Theme::fontSizeExtraSmallChanged);
-    connect(m_private, &ThemePrivate::fontSizeSmallChanged,
-            this, &Theme::fontSizeSmallChanged);
-    connect(m_private, &ThemePrivate::fontSizeMediumChanged,
-            this, &Theme::fontSizeMediumChanged);
-    connect(m_private, &ThemePrivate::fontSizeLargeChanged,
-            this, &Theme::fontSizeLargeChanged);
-    connect(m_private, &ThemePrivate::fontSizeExtraLargeChanged,
-            this, &Theme::fontSizeExtraLargeChanged);
-    connect(m_private, &ThemePrivate::fontSizeHugeChanged,
-            this, &Theme::fontSizeHugeChanged);
+    , m_private(ThemePrivate::instance())
+{
+    // Forward changes, once per signal however often they were made during a
+    // transaction.
+    connect(m_private, &ThemePrivate::changed, this, [this](ThemePrivate::Changes changes) {
+        if (changes & ThemePrivate::ColorSchemeChange)
+            emit colorSchemeChanged();
+        if (changes & ThemePrivate::PrimaryColorChange)
+            emit primaryColorChanged();
+        if (changes & ThemePrivate::SecondaryColorChange)
+            emit secondaryColorChanged();
+        if (changes & ThemePrivate::HighlightColorChange)
+            emit highlightColorChanged();
+        if (changes & ThemePrivate::SecondaryHighlightColorChange)
+            emit secondaryHighlightColorChanged();
+        if (changes & ThemePrivate::HighlightBackgroundColorChange)
+            emit highlightBackgroundColorChanged();
+        if (changes & ThemePrivate::HighlightDimmerColorChange)
+            emit highlightDimmerColorChanged();
+        if (changes & ThemePrivate::FontSizeTinyChange)
+            emit fontSizeTinyChanged();
+        if (changes & ThemePrivate::FontSizeExtraSmallChange)
+            emit fontSizeExtraSmallChanged();
+        if (changes & ThemePrivate::FontSizeSmallChange)
+            emit fontSizeSmallChanged();
+        if (changes & ThemePrivate::FontSizeMediumChange)
+            emit fontSizeMediumChanged();
+        if (changes & ThemePrivate::FontSizeLargeChange)
+            emit fontSizeLargeChanged();
+        if (changes & ThemePrivate::FontSizeExtraLargeChange)
+            emit fontSizeExtraLargeChanged();
+        if (changes & ThemePrivate::FontSizeHugeChange)
+            emit fontSizeHugeChanged();
+    });
 }
 
 Theme::~Theme()
 {
-    delete m_private;
 }
 
 qreal Theme::pixelRatio() const
@@ -506,12 +666,14 @@ void Theme::setColorScheme(ColorScheme colorScheme)
         m_private->m_highlightBackgroundColor = highlightBackgroundFromColor(m_private->m_highlightColor, colorScheme);
         m_private->m_highlightDimmerColor = highlightDimmerFromColor(m_private->m_highlightColor, colorScheme);
 
-        emit colorSchemeChanged();
-        emit primaryColorChanged();
-        emit secondaryColorChanged();
-        emit secondaryHighlightColorChanged();
-        emit highlightBackgroundColorChanged();
-        emit highlightDimmerColorChanged();
+        // Palettes derive their default colors from the scheme.
+        m_private->notify(ThemePrivate::ColorSchemeChange
+                          | ThemePrivate::PrimaryColorChange
+                          | ThemePrivate::SecondaryColorChange
+                          | ThemePrivate::SecondaryHighlightColorChange
+                          | ThemePrivate::HighlightBackgroundColorChange
+                          | ThemePrivate::HighlightDimmerColorChange
+                          | ThemePrivate::PaletteChange);
     }
 }
 
@@ -720,10 +882,10 @@ void Theme::_setHighlightColor(QColor color)
         m_private->m_highlightBackgroundColor = highlightBackgroundFromColor(color, m_private->m_colorScheme);
         m_private->m_highlightDimmerColor = highlightDimmerFromColor(color, m_private->m_colorScheme);
 
-        emit highlightColorChanged();
-        emit secondaryHighlightColorChanged();
-        emit highlightBackgroundColorChanged();
-        emit highlightDimmerColorChanged();
+        m_private->notify(ThemePrivate::HighlightColorChange
+                          | ThemePrivate::SecondaryHighlightColorChange
+                          | ThemePrivate::HighlightBackgroundColorChange
+                          | ThemePrivate::HighlightDimmerColorChange);
     }
 }
 
@@ -732,6 +894,11 @@ QString Theme::highlightText(const QString &text, const QVariant &pattern, const
     return m_private->highlightText(text, pattern, color);
 }
 
+QStringList Theme::highlightTextBatch(const QStringList &texts, const QVariant &pattern, const QColor &color)
+{
+    return m_private->highlightTextBatch(texts, pattern, color);
+}
+
 QColor Theme::rgba(QColor color, qreal opacity) const
 {
     QColor result(color);
@@ -241,6 +241,8 @@ public:
     qreal opacityOverlay() const;
 
     Q_INVOKABLE QString highlightText(const QString &text, const QVariant &pattern, const QColor &color);
+    // Highlights the pattern in each text, e.g. a page of search results.
+    Q_INVOKABLE QStringList highlightTextBatch(const QStringList &texts, const QVariant &pattern, const QColor &color);
     Q_INVOKABLE QColor rgba(QColor color, qreal opacity) const;
     Q_INVOKABLE QColor presenceColor(PresenceMode presenceMode) const;
     Q_INVOKABLE QString iconForMimeType(QString mimeType) const;
@@ -37,10 +37,36 @@ class ThemePrivate : public QObject
     Q_OBJECT
 
 public:
+    enum Change {
+        ColorSchemeChange = 0x0001,
+        PrimaryColorChange = 0x0002,
+        SecondaryColorChange = 0x0004,
+        HighlightColorChange = 0x0008,
+        SecondaryHighlightColorChange = 0x0010,
+        HighlightBackgroundColorChange = 0x0020,
+        HighlightDimmerColorChange = 0x0040,
+        FontSizeTinyChange = 0x0080,
+        FontSizeExtraSmallChange = 0x0100,
+        FontSizeSmallChange = 0x0200,
+        FontSizeMediumChange = 0x0400,
+        FontSizeLargeChange = 0x0800,
+        FontSizeExtraLargeChange = 0x1000,
+        FontSizeHugeChange = 0x2000,
+        PaletteChange = 0x4000
+    };
+    Q_DECLARE_FLAGS(Changes, Change)
+
     ThemePrivate();
     static ThemePrivate *instance();
     ThemeColors *themeColors() { return m_themeColors.data(); }
 
+    // Changes notified while a transaction is open are accumulated and
+    // propagated in a single pass when the outermost transaction commits.
+    void beginTransaction();
+    void commitTransaction();
+    bool inTransaction() const { return m_transactionDepth > 0; }
+    void notify(Changes changes);
+
     Theme::ColorScheme m_colorScheme;
     qreal m_pixelRatio;
     QString m_fontFamilyHeading;
@@ -138,15 +164,12 @@ public:
 
     QStringList launcherIconDirectories();
     QString highlightText(const QString &text, const QVariant &pattern, const QColor &color) const;
+    QStringList highlightTextBatch(const QStringList &texts, const QVariant &pattern, const QColor &color) const;
 
 signals:
-    void fontSizeTinyChanged();
-    void fontSizeExtraSmallChanged(); 
-    void fontSizeSmallChanged();
-    void fontSizeMediumChanged();
-    void fontSizeLargeChanged();
-    void fontSizeExtraLargeChanged();
-    void fontSizeHugeChanged();
+    // Emitted when the first change is held back by an open transaction.
+    void aboutToChange();
+    void changed(Silica::ThemePrivate::Changes changes);
 
 private:
     bool m_autoScaleThemeConfValue;
@@ -159,12 +182,11 @@ private:
     QMetaObject m_lightOnDarkDistanceField;
     QMetaObject m_darkOnLightDistanceField;
     QStringList m_launcherIconDirectories;
+    int m_transactionDepth = 0;
+    Changes m_pendingChanges;
 
     void updateFontSizes();
     void commitAmbienceUpdate();
-    void processTextChunk(QString &result, QString &remainingText, 
-        int matchStart, int matchLength,
-        const QString &format) const;
 
     // Theme parameter handling
     void loadThemeParameters();
@@ -172,6 +194,8 @@ private:
     QSize scaleSize(const QSize &size) const;
 };
 
+Q_DECLARE_OPERATORS_FOR_FLAGS(ThemePrivate::Changes)
+
 } // namespace Silica
 
 #endif // SILICATHEME_P_H
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "silicathemeiconresolver.h"
 #include "silicathemeiconresolver_p.h"
+#include "themeiconindex.h"
 
 #include <cmath>
 #include <MGConfItem>
@@ -82,28 +83,41 @@ void ThemeIconResolverPrivate::addIconRoot(const QString &path) {
     }
 
     QString scaleDir = themeIconSubDir(m_pixelRatio);
+    QList<ImageDirNode> nodes;
 
     if (!scaleDir.isEmpty() && scaleDir != detectedScaleDir) {
         QString p1 = root + scaleDir + "/icons-monochrome/";
         QString p2 = root + scaleDir + "/icons/";
-        imageDirNodes.append(ImageDirNode(p1, QStringList() << ".png" << ".jpg", IconInfo::MonochromeIcon));
-        imageDirNodes.append(ImageDirNode(p2, QStringList() << ".png" << ".jpg", IconInfo::ColorIcon));
+        nodes.append(ImageDirNode(p1, QStringList() << ".png" << ".jpg", IconInfo::MonochromeIcon));
+        nodes.append(ImageDirNode(p2, QStringList() << ".png" << ".jpg", IconInfo::ColorIcon));
 
     }
 
     if (!detectedScaleDir.isEmpty()) {
         QString p1 = root + detectedScaleDir + "/icons-monochrome/";
         QString p2 = root + detectedScaleDir + "/icons/";
-        imageDirNodes.append(ImageDirNode(p1, QStringList() << ".png" << ".jpg", IconInfo::MonochromeIcon));
-        imageDirNodes.append(ImageDirNode(p2, QStringList() << ".png" << ".jpg", IconInfo::ColorIcon));
+        nodes.append(ImageDirNode(p1, QStringList() << ".png" << ".jpg", IconInfo::MonochromeIcon));
+        nodes.append(ImageDirNode(p2, QStringList() << ".png" << ".jpg", IconInfo::ColorIcon));
 
     }
 
-    imageDirNodes.append(ImageDirNode(root + "/icons-monochrome/",
-                                   QStringList() << ".png" << ".jpg", IconInfo::MonochromeIcon));
-    imageDirNodes.append(ImageDirNode(root + "/icons/",
-                                   QStringList() << ".png" << ".jpg", IconInfo::ColorIcon));
+    nodes.append(ImageDirNode(root + "/icons-monochrome/",
+                              QStringList() << ".png" << ".jpg", IconInfo::MonochromeIcon));
+    nodes.append(ImageDirNode(root + "/icons/",
+                              QStringList() << ".png" << ".jpg", IconInfo::ColorIcon));
 
+    addImageDirGroup(nodes);
+}
+
+void ThemeIconResolverPrivate::addImageDirGroup(const QList<ImageDirNode> &nodes)
+{
+    QWriteLocker locker(&lock);
+    imageDirNodes.append(nodes);
+    imageDirGroups.append(ImageDirGroup(nodes));
+
+    // Earlier misses may resolve from the new directories.
+    cache.clear();
+    ++generation;
 }
 
 void ThemeIconResolverPrivate::loadDefaultThemeRoots()
@@ -132,7 +146,54 @@ void ThemeIconResolverPrivate::loadDefaultThemeRoots()
     }
 
     // Add a safe hicolor fallback used upstream
-    imageDirNodes.append(ImageDirNode(QStringLiteral("/usr/share/icons/hicolor/86x86/apps/"), QStringList() << ".png", IconInfo::ColorIcon));
+    addImageDirGroup(QList<ImageDirNode>()
+            << ImageDirNode(QStringLiteral("/usr/share/icons/hicolor/86x86/apps/"), QStringList() << ".png", IconInfo::ColorIcon));
+}
+
+IconInfo ThemeIconResolverPrivate::lookupIcon(const QString &id, Theme::ColorScheme colorScheme) const
+{
+    // The index only covers the top level of each image directory.
+    if (id.contains(QLatin1Char('/'))) {
+        return probeIcon(id, colorScheme);
+    }
+
+    IconInfo info;
+    for (const ImageDirGroup &group : imageDirGroups) {
+        QSharedPointer<ThemeIconIndex> index;
+        {
+            QMutexLocker locker(&indexMutex);
+            if (!group.index) {
+                group.index.reset(new ThemeIconIndex(group.nodes));
+            }
+            index = group.index;
+        }
+        if (index->lookup(id, colorScheme, &info)) {
+            return info;
+        }
+    }
+    return IconInfo();
+}
+
+IconInfo ThemeIconResolverPrivate::probeIcon(const QString &id, Theme::ColorScheme colorScheme) const
+{
+    const QString colorStr = (colorScheme == Theme::DarkOnLight) ? QStringLiteral("light") : QStringLiteral("dark");
+
+    for (const ImageDirNode &node : imageDirNodes) {
+        // Try each suffix for this node
+        for (const QString &suffix : node.suffixList) {
+            QString candidate = node.path + id + suffix;
+            if (QFileInfo::exists(candidate)) {
+                return IconInfo(candidate, node.iconType);
+            }
+
+            // Try color-suffixed variant (icon-light.png / icon-dark.png)
+            QString colorCandidate = node.path + id + QStringLiteral("-") + colorStr + suffix;
+            if (QFileInfo::exists(colorCandidate)) {
+                return IconInfo(colorCandidate, node.iconType);
+            }
+        }
+    }
+    return IconInfo();
 }
 
 ThemeIconResolver::ThemeIconResolver()
@@ -178,47 +239,29 @@ IconInfo ThemeIconResolver::resolveIcon(const QString &id, Theme::ColorScheme co
 
     Q_D(const ThemeIconResolver);
 
-    QString resolvedPath;
-    IconInfo::IconType resolvedType = IconInfo::MonochromeIcon;
-
     const QString colorStr = (colorScheme == Theme::DarkOnLight) ? QStringLiteral("light") : QStringLiteral("dark");
 
     // Use a cache keyed by id|color
     const QString cacheKey = id + QChar('\x1f') + colorStr; // unit separator as simple delimiter
-    if (d->cache.contains(cacheKey)) {
-        return d->cache.value(cacheKey);
-    }
-
-    // Check icon nodes
-    const QList<ImageDirNode> nodes = d->getImageDirNodes();
-    for (const ImageDirNode &node : nodes) {
-        // Try each suffix for this node
-        for (const QString &suffix : node.suffixList) {
-            QString candidate = node.path + id + suffix;
-            if (QFileInfo::exists(candidate)) {
-                resolvedPath = candidate;
-                resolvedType = node.iconType;
-                break;
-            }
-
-            // Try color-suffixed variant (icon-light.png / icon-dark.png)
-            QString colorCandidate = node.path + id + QStringLiteral("-") + colorStr + suffix;
-            if (QFileInfo::exists(colorCandidate)) {
-                resolvedPath = colorCandidate;
-                resolvedType = node.iconType;
-                break;
-            }
+    IconInfo info;
+    int generation;
+    {
+        QReadLocker locker(&d->lock);
+        auto it = d->cache.constFind(cacheKey);
+        if (it != d->cache.constEnd()) {
+            return it.value();
         }
-        if (!resolvedPath.isEmpty()) break;
+        generation = d->generation;
+        info = d->lookupIcon(id, colorScheme);
     }
 
-    if (!resolvedPath.isEmpty()) {
-        IconInfo info(resolvedPath, resolvedType);
+    // Misses are cached too, the index has already ruled the icon out. A root
+    // added while looking up may resolve it though.
+    QWriteLocker locker(&d->lock);
+    if (d->generation == generation) {
         d->cache.insert(cacheKey, info);
-        return info;
     }
-
-    return IconInfo(resolvedPath, resolvedType);
+    return info;
 }
 
 QString ThemeIconResolver::resolvePath(const QString &id) const {
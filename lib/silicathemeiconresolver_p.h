@@ -6,6 +6,9 @@
 #include <QString>
 #include <QStringList>
 #include <QMap>
+#include <QMutex>
+#include <QReadWriteLock>
+#include <QSharedPointer>
 
 namespace Silica {
 
@@ -18,6 +21,18 @@ struct ImageDirNode {
         : path(path), suffixList(suffixes), iconType(type) {}
 };
 
+class ThemeIconIndex;
+
+// The image directories added by one addIconRoot() call, looked up through a
+// shared index that is loaded on first use.
+struct ImageDirGroup {
+    QList<ImageDirNode> nodes;
+    mutable QSharedPointer<ThemeIconIndex> index;
+
+    explicit ImageDirGroup(const QList<ImageDirNode> &nodes)
+        : nodes(nodes) {}
+};
+
 class IconInfoPrivate {
 public:
     QString filePath;
@@ -33,16 +48,27 @@ public:
 class ThemeIconResolverPrivate {
 public:
     qreal m_pixelRatio;
+    // Icons are resolved from the image provider's decode threads as well, the
+    // lock guards the cache and the directory lists. Indexes are loaded under
+    // indexMutex so concurrent misses on a new root only map it once.
+    mutable QReadWriteLock lock;
+    mutable QMutex indexMutex;
     mutable QHash<QString, IconInfo> cache;
+    int generation = 0;
     bool loadDefaultTheme;
 
     void addIconRoot(const QString &path);
     void loadDefaultThemeRoots();
+    IconInfo lookupIcon(const QString &id, Theme::ColorScheme colorScheme) const;
     const QList<ImageDirNode> &getImageDirNodes() const { return imageDirNodes; }
 
 private:
     static QString themeIconSubDir(qreal pixelRatio);
+    void addImageDirGroup(const QList<ImageDirNode> &nodes);
+    IconInfo probeIcon(const QString &id, Theme::ColorScheme colorScheme) const;
+
     QList<ImageDirNode> imageDirNodes;
+    QList<ImageDirGroup> imageDirGroups;
 };
 
 } // namespace Silica
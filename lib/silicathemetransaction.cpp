@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: LGPL-2.1-only
 
 #include "silicathemetransaction.h"
+#include "silicatheme_p.h"
 
 namespace Silica
 {
@@ -8,6 +9,18 @@ namespace Silica
 ThemeTransaction::ThemeTransaction(QObject *parent)
     : QObject(parent)
 {
+    connect(ThemePrivate::instance(), &ThemePrivate::aboutToChange, this, [this]() {
+        if (m_active) {
+            emit ambienceAboutToChange();
+        }
+    });
+}
+
+ThemeTransaction::~ThemeTransaction()
+{
+    if (m_active) {
+        ThemePrivate::instance()->commitTransaction();
+    }
 }
 
 bool ThemeTransaction::deferAmbience() const
@@ -20,6 +33,39 @@ void ThemeTransaction::setDeferAmbience(bool defer)
     if (m_deferAmbience != defer) {
         m_deferAmbience = defer;
         emit deferAmbienceChanged();
+
+        updateActive();
+    }
+}
+
+bool ThemeTransaction::isActive() const
+{
+    return m_active;
+}
+
+void ThemeTransaction::begin()
+{
+    m_begun = true;
+    updateActive();
+}
+
+void ThemeTransaction::commit()
+{
+    m_begun = false;
+    updateActive();
+}
+
+void ThemeTransaction::updateActive()
+{
+    const bool active = m_begun || m_deferAmbience;
+    if (m_active != active) {
+        m_active = active;
+        if (active) {
+            ThemePrivate::instance()->beginTransaction();
+        } else {
+            ThemePrivate::instance()->commitTransaction();
+        }
+        emit activeChanged();
     }
 }
 
@@ -8,23 +8,42 @@
 namespace Silica
 {
 
+// Holds back theme and palette change notifications while active. Everything
+// changed in the meantime is propagated in one pass when the transaction
+// commits, with each palette and theme property notified at most once.
+//
+// A transaction is active between begin() and commit(), and while
+// deferAmbience is set. Transactions nest, changes are propagated when the
+// last active one commits.
 class ThemeTransaction : public QObject
 {
     Q_OBJECT
     Q_PROPERTY(bool deferAmbience READ deferAmbience WRITE setDeferAmbience NOTIFY deferAmbienceChanged)
+    Q_PROPERTY(bool active READ isActive NOTIFY activeChanged)
 
 public:
     explicit ThemeTransaction(QObject *parent = nullptr);
+    ~ThemeTransaction();
 
     bool deferAmbience() const;
     void setDeferAmbience(bool defer);
 
+    bool isActive() const;
+
+    Q_INVOKABLE void begin();
+    Q_INVOKABLE void commit();
+
 signals:
     void ambienceAboutToChange();
     void deferAmbienceChanged();
+    void activeChanged();
 
 private:
+    void updateActive();
+
     bool m_deferAmbience = false;
+    bool m_begun = false;
+    bool m_active = false;
 };
 
 } // namespace Silica
@@ -8,6 +8,7 @@ namespace Silica {
 ThemeColors::ThemeColors(ThemePrivate *theme)
     : MDConfGroup("/desktop/jolla/theme/color")
     , m_theme(theme)
+    , m_generation(nextGeneration())
 {
 }
 
@@ -31,8 +32,8 @@ void ThemeColors::setColor(ColorIndex index, const QColor &color)
         m_runtimeColors.remove(index);
     }
 
-    // Notify palettes of color change
-    refreshPalettes();
+    // Notify palettes of color change, deferred while a transaction is open
+    m_theme->notify(ThemePrivate::PaletteChange);
 }
 
 QColor ThemeColors::computeDefaultColor(ColorIndex index) const
@@ -104,20 +105,30 @@ QColor ThemeColors::getColorForScheme(ColorIndex index, Theme::ColorScheme schem
     }
 }
 
+quint64 ThemeColors::nextGeneration()
+{
+    static quint64 generation = 0;
+    return ++generation;
+}
+
 void ThemeColors::refreshPalettes()
 {
-    for (PalettePrivate *palette : m_palettes) {
-        if (palette) {
-            palette->updateColors();
+    // Unwatched palettes derive their colors again when next read.
+    m_generation = nextGeneration();
+
+    // Handlers may create or destroy palettes.
+    const QSet<PalettePrivate*> palettes = m_palettes;
+    for (PalettePrivate *palette : palettes) {
+        if (m_palettes.contains(palette)) {
+            palette->notifyChanged(false);
         }
     }
 }
 
 void ThemeColors::addPalette(PalettePrivate* palette)
 {
-    if (palette && !m_palettes.contains(palette)) {
+    if (palette) {
         m_palettes.insert(palette);
-        palette->updateColors();
     }
 }
 
@@ -34,8 +34,14 @@ public:
     QColor computeDefaultColor(ColorIndex index) const;
     static QColor getColorForScheme(ColorIndex index, Theme::ColorScheme scheme, const QColor &highlight);
 
-private:
+    // Starts a new generation of colors and notifies the watched palettes.
     void refreshPalettes();
+
+    // Generations of palette and theme colors are taken from one counter.
+    static quint64 nextGeneration();
+    quint64 generation() const { return m_generation; }
+
+private:
     QColor getBaseHighlightColor() const;
 
 public:
@@ -49,6 +55,7 @@ public:
     void setBackgroundGlow(const QString &value) { setColor(ColorIndex::BackgroundGlow, QColor(value)); }
     void setError(const QString &value) { setColor(ColorIndex::Error, QColor(value)); }
 
+    // Palettes with connected change signals.
     void addPalette(PalettePrivate* palette);
     void removePalette(PalettePrivate* palette);
     const QSet<PalettePrivate*>& palettes() const { return m_palettes; }
@@ -57,6 +64,7 @@ private:
     ThemePrivate *m_theme;
     QSet<PalettePrivate*> m_palettes;
     QMap<ColorIndex, QColor> m_runtimeColors; // Runtime color overrides
+    quint64 m_generation;
 };
 
 } // namespace Silica
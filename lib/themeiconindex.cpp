@@ -0,0 +1,424 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+
+#include "themeiconindex.h"
+#include "logging.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+
+#include <cstring>
+
+namespace Silica {
+
+namespace {
+
+const quint32 IndexMagic = 0x58494953; // "SIIX"
+const quint32 IndexVersion = 1;
+
+// File layout: header, nodes, hash buckets, entries and a UTF-16 string table.
+// Every record is 4 byte aligned so the file can be used in place once mapped.
+struct IndexHeader
+{
+    quint32 magic;
+    quint32 version;
+    quint32 nodeCount;
+    quint32 bucketCount;
+    quint32 entryCount;
+    quint32 stringCount;
+    quint32 reserved[2];
+};
+
+struct IndexNode
+{
+    qint64 mtime;
+    quint32 path;
+    quint32 pathLength;
+};
+
+struct IndexEntry
+{
+    quint32 hash;
+    quint32 id;
+    quint32 idLength;
+    // Resolved file for each Theme::ColorScheme, node is -1 if the id has no icon
+    // for that scheme.
+    qint32 node[2];
+    quint32 file[2];
+    quint32 fileLength[2];
+};
+
+struct IndexView
+{
+    explicit IndexView(const uchar *data)
+        : header(reinterpret_cast<const IndexHeader *>(data))
+        , nodes(reinterpret_cast<const IndexNode *>(header + 1))
+        , buckets(reinterpret_cast<const quint32 *>(nodes + header->nodeCount))
+        , entries(reinterpret_cast<const IndexEntry *>(buckets + header->bucketCount))
+        , strings(reinterpret_cast<const QChar *>(entries + header->entryCount))
+    {
+    }
+
+    bool containsString(quint32 offset, quint32 length) const
+    {
+        return offset <= header->stringCount && length <= header->stringCount - offset;
+    }
+
+    const IndexHeader *header;
+    const IndexNode *nodes;
+    const quint32 *buckets;
+    const IndexEntry *entries;
+    const QChar *strings;
+};
+
+// FNV-1a, unlike qHash() this is stable between processes.
+quint32 hashId(const QChar *data, int length)
+{
+    quint32 hash = 2166136261u;
+    for (int i = 0; i < length; ++i) {
+        hash ^= data[i].unicode();
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+const QString &variantSuffix(int scheme)
+{
+    static const QString suffixes[] = { QStringLiteral("-dark"), QStringLiteral("-light") };
+    return suffixes[scheme];
+}
+
+}
+
+ThemeIconIndex::ThemeIconIndex(const QList<ImageDirNode> &nodes)
+    : m_nodes(nodes)
+{
+    const QVector<qint64> times = directoryTimes();
+    const QString filePath = cacheFilePath();
+
+    if (!filePath.isEmpty() && map(filePath) && isCurrent(times)) {
+        return;
+    }
+    detach();
+
+    m_buffer = build(times);
+
+    if (!filePath.isEmpty() && QDir().mkpath(cacheDirectory())) {
+        QSaveFile file(filePath);
+        if (file.open(QIODevice::WriteOnly)
+                && file.write(m_buffer) == m_buffer.size()
+                && file.commit()
+                && map(filePath)) {
+            // Share the pages of the mapped file instead of keeping a private copy.
+            m_buffer.clear();
+            return;
+        }
+    }
+
+    qCDebug(lcSilicaCoreLog) << "Could not store icon index" << filePath;
+    attach(reinterpret_cast<const uchar *>(m_buffer.constData()), m_buffer.size());
+}
+
+ThemeIconIndex::~ThemeIconIndex()
+{
+    detach();
+}
+
+QString ThemeIconIndex::cacheDirectory()
+{
+    const QString location = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation);
+    return location.isEmpty() ? QString() : location + QStringLiteral("/sailfish-silica/icons");
+}
+
+bool ThemeIconIndex::lookup(const QString &id, Theme::ColorScheme colorScheme, IconInfo *info) const
+{
+    if (!m_data) {
+        return false;
+    }
+
+    const IndexView index(m_data);
+    const quint32 hash = hashId(id.constData(), id.length());
+    const quint32 mask = index.header->bucketCount - 1;
+
+    // There are always more buckets than entries so the probe ends on an empty bucket.
+    for (quint32 slot = hash & mask;; slot = (slot + 1) & mask) {
+        const quint32 bucket = index.buckets[slot];
+        if (!bucket) {
+            return false;
+        }
+
+        const IndexEntry &entry = index.entries[bucket - 1];
+        if (entry.hash != hash
+                || entry.idLength != quint32(id.length())
+                || memcmp(index.strings + entry.id, id.constData(), id.length() * sizeof(QChar)) != 0) {
+            continue;
+        }
+
+        const int scheme = colorScheme == Theme::DarkOnLight ? 1 : 0;
+        if (entry.node[scheme] < 0) {
+            return false;
+        }
+
+        const ImageDirNode &node = m_nodes.at(entry.node[scheme]);
+        *info = IconInfo(node.path + QString(index.strings + entry.file[scheme], entry.fileLength[scheme]),
+                         node.iconType);
+        return true;
+    }
+}
+
+QVector<qint64> ThemeIconIndex::directoryTimes() const
+{
+    QVector<qint64> times;
+    times.reserve(m_nodes.count());
+    for (const ImageDirNode &node : m_nodes) {
+        const QFileInfo info(node.path);
+        times.append(info.isDir() ? info.lastModified().toMSecsSinceEpoch() : -1);
+    }
+    return times;
+}
+
+QString ThemeIconIndex::cacheFilePath() const
+{
+    const QString directory = cacheDirectory();
+    if (directory.isEmpty()) {
+        return QString();
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    for (const ImageDirNode &node : m_nodes) {
+        hash.addData(node.path.toUtf8());
+        hash.addData(node.suffixList.join(QLatin1Char(':')).toUtf8());
+        hash.addData(QByteArray::number(node.iconType));
+        hash.addData("\n", 1);
+    }
+    return directory + QLatin1Char('/') + QString::fromLatin1(hash.result().toHex()) + QStringLiteral(".index");
+}
+
+bool ThemeIconIndex::map(const QString &filePath)
+{
+    detach();
+
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const qint64 size = m_file.size();
+    m_mapping = size > 0 ? m_file.map(0, size) : nullptr;
+    if (m_mapping && attach(m_mapping, size)) {
+        return true;
+    }
+
+    detach();
+    return false;
+}
+
+bool ThemeIconIndex::attach(const uchar *data, qint64 size)
+{
+    if (size < qint64(sizeof(IndexHeader))) {
+        return false;
+    }
+
+    const IndexHeader *header = reinterpret_cast<const IndexHeader *>(data);
+    if (header->magic != IndexMagic
+            || header->version != IndexVersion
+            || header->nodeCount != quint32(m_nodes.count())
+            || header->bucketCount == 0
+            || (header->bucketCount & (header->bucketCount - 1)) != 0
+            || header->entryCount >= header->bucketCount) {
+        return false;
+    }
+
+    const qint64 expectedSize = qint64(sizeof(IndexHeader))
+            + qint64(header->nodeCount) * qint64(sizeof(IndexNode))
+            + qint64(header->bucketCount) * qint64(sizeof(quint32))
+            + qint64(header->entryCount) * qint64(sizeof(IndexEntry))
+            + qint64(header->stringCount) * qint64(sizeof(QChar));
+    if (size != expectedSize) {
+        return false;
+    }
+
+    // Check the offsets once here so lookups can trust them.
+    const IndexView index(data);
+    for (quint32 i = 0; i < header->nodeCount; ++i) {
+        if (!index.containsString(index.nodes[i].path, index.nodes[i].pathLength)) {
+            return false;
+        }
+    }
+    for (quint32 i = 0; i < header->bucketCount; ++i) {
+        if (index.buckets[i] > header->entryCount) {
+            return false;
+        }
+    }
+    for (quint32 i = 0; i < header->entryCount; ++i) {
+        const IndexEntry &entry = index.entries[i];
+        if (!index.containsString(entry.id, entry.idLength)) {
+            return false;
+        }
+        for (int scheme = 0; scheme < 2; ++scheme) {
+            if (entry.node[scheme] >= qint32(header->nodeCount)
+                    || (entry.node[scheme] >= 0
+                        && !index.containsString(entry.file[scheme], entry.fileLength[scheme]))) {
+                return false;
+            }
+        }
+    }
+
+    m_data = data;
+    return true;
+}
+
+bool ThemeIconIndex::isCurrent(const QVector<qint64> &times) const
+{
+    if (!m_data) {
+        return false;
+    }
+
+    const IndexView index(m_data);
+    for (int i = 0; i < m_nodes.count(); ++i) {
+        const IndexNode &node = index.nodes[i];
+        const QString &path = m_nodes.at(i).path;
+        if (node.mtime != times.at(i)
+                || node.pathLength != quint32(path.length())
+                || memcmp(index.strings + node.path, path.constData(), path.length() * sizeof(QChar)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ThemeIconIndex::detach()
+{
+    if (m_mapping) {
+        m_file.unmap(m_mapping);
+        m_mapping = nullptr;
+    }
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+    m_data = nullptr;
+}
+
+QByteArray ThemeIconIndex::build(const QVector<qint64> &times) const
+{
+    // A single listing per directory replaces the existence checks of every lookup.
+    // Each file contributes its own stem and, for -dark/-light variants, the plain id.
+    QVector<QSet<QString>> files;
+    QSet<QString> ids;
+    for (const ImageDirNode &node : m_nodes) {
+        QSet<QString> names;
+        const QStringList entries = QDir(node.path).entryList(QDir::Files, QDir::Unsorted);
+        for (const QString &entry : entries) {
+            for (const QString &suffix : node.suffixList) {
+                if (entry.length() <= suffix.length() || !entry.endsWith(suffix)) {
+                    continue;
+                }
+                const QString stem = entry.left(entry.length() - suffix.length());
+                names.insert(entry);
+                ids.insert(stem);
+                for (int scheme = 0; scheme < 2; ++scheme) {
+                    const QString &variant = variantSuffix(scheme);
+                    if (stem.length() > variant.length() && stem.endsWith(variant)) {
+                        ids.insert(stem.left(stem.length() - variant.length()));
+                    }
+                }
+                break;
+            }
+        }
+        files.append(names);
+    }
+
+    QVector<ushort> strings;
+    auto addString = [&strings](const QString &string) {
+        const quint32 offset = strings.size();
+        strings.resize(offset + string.length());
+        memcpy(strings.data() + offset, string.utf16(), string.length() * sizeof(ushort));
+        return offset;
+    };
+
+    QVector<IndexNode> nodes;
+    nodes.reserve(m_nodes.count());
+    for (int i = 0; i < m_nodes.count(); ++i) {
+        IndexNode node;
+        node.mtime = times.at(i);
+        node.path = addString(m_nodes.at(i).path);
+        node.pathLength = m_nodes.at(i).path.length();
+        nodes.append(node);
+    }
+
+    // Resolve every id the same way ThemeIconResolver probes the directories:
+    // nodes in order, suffixes in order, plain name before the scheme variant.
+    QVector<IndexEntry> entries;
+    entries.reserve(ids.count());
+    for (const QString &id : ids) {
+        IndexEntry entry;
+        entry.hash = hashId(id.constData(), id.length());
+        entry.id = addString(id);
+        entry.idLength = id.length();
+
+        for (int scheme = 0; scheme < 2; ++scheme) {
+            entry.node[scheme] = -1;
+            entry.file[scheme] = 0;
+            entry.fileLength[scheme] = 0;
+
+            const QString variant = id + variantSuffix(scheme);
+            for (int i = 0; i < m_nodes.count() && entry.node[scheme] < 0; ++i) {
+                for (const QString &suffix : m_nodes.at(i).suffixList) {
+                    QString file = id + suffix;
+                    if (!files.at(i).contains(file)) {
+                        file = variant + suffix;
+                        if (!files.at(i).contains(file)) {
+                            continue;
+                        }
+                    }
+                    entry.node[scheme] = i;
+                    entry.file[scheme] = addString(file);
+                    entry.fileLength[scheme] = file.length();
+                    break;
+                }
+            }
+        }
+        entries.append(entry);
+    }
+
+    quint32 bucketCount = 16;
+    while (bucketCount < quint32(entries.count()) * 2) {
+        bucketCount <<= 1;
+    }
+    QVector<quint32> buckets(bucketCount, 0);
+    for (int i = 0; i < entries.count(); ++i) {
+        quint32 slot = entries.at(i).hash & (bucketCount - 1);
+        while (buckets.at(slot)) {
+            slot = (slot + 1) & (bucketCount - 1);
+        }
+        buckets[slot] = i + 1;
+    }
+
+    IndexHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = IndexMagic;
+    header.version = IndexVersion;
+    header.nodeCount = nodes.count();
+    header.bucketCount = bucketCount;
+    header.entryCount = entries.count();
+    header.stringCount = strings.count();
+
+    QByteArray data;
+    data.reserve(sizeof(IndexHeader)
+                 + nodes.count() * sizeof(IndexNode)
+                 + buckets.count() * sizeof(quint32)
+                 + entries.count() * sizeof(IndexEntry)
+                 + strings.count() * sizeof(ushort));
+    data.append(reinterpret_cast<const char *>(&header), sizeof(IndexHeader));
+    data.append(reinterpret_cast<const char *>(nodes.constData()), nodes.count() * sizeof(IndexNode));
+    data.append(reinterpret_cast<const char *>(buckets.constData()), buckets.count() * sizeof(quint32));
+    data.append(reinterpret_cast<const char *>(entries.constData()), entries.count() * sizeof(IndexEntry));
+    data.append(reinterpret_cast<const char *>(strings.constData()), strings.count() * sizeof(ushort));
+    return data;
+}
+
+} // namespace Silica
@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+
+#ifndef SILICA_THEMEICONINDEX_H
+#define SILICA_THEMEICONINDEX_H
+
+#include "silicathemeiconresolver_p.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QVector>
+
+namespace Silica {
+
+// Lookup table of every icon found in the image directories of one icon root.
+//
+// The table is written to the generic cache directory and memory mapped by later
+// processes. It is keyed by the directory list (which includes the scale subdir)
+// and validated against the directory mtimes when loaded, so a lookup never has
+// to touch the file system. Ids missing from the table can't be resolved by any
+// of its directories.
+class ThemeIconIndex
+{
+public:
+    explicit ThemeIconIndex(const QList<ImageDirNode> &nodes);
+    ~ThemeIconIndex();
+
+    bool lookup(const QString &id, Theme::ColorScheme colorScheme, IconInfo *info) const;
+
+    static QString cacheDirectory();
+
+private:
+    QVector<qint64> directoryTimes() const;
+    QString cacheFilePath() const;
+    bool map(const QString &filePath);
+    bool attach(const uchar *data, qint64 size);
+    bool isCurrent(const QVector<qint64> &times) const;
+    void detach();
+    QByteArray build(const QVector<qint64> &times) const;
+
+    QList<ImageDirNode> m_nodes;
+    QFile m_file;
+    uchar *m_mapping = nullptr;
+    QByteArray m_buffer;
+    const uchar *m_data = nullptr;
+};
+
+} // namespace Silica
+
+#endif // SILICA_THEMEICONINDEX_H
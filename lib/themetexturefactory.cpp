@@ -0,0 +1,207 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+
+#include "themetexturefactory.h"
+
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QQuickWindow>
+#include <QSGTexture>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// Exact x / 255 for x <= 255 * 255
+static inline uint div255(uint x)
+{
+    return (x + 1 + (x >> 8)) >> 8;
+}
+
+// Writes the color scaled by the alpha of each mask pixel.
+static void colorizeScanLine(const uchar *src, QRgb *dst, int width, QRgb color)
+{
+    int x = 0;
+
+#if defined(__SSE2__)
+    const __m128i colorChannels = _mm_unpacklo_epi8(_mm_set1_epi32(int(color)), _mm_setzero_si128());
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi16(1);
+    for (; x + 8 <= width; x += 8) {
+        const __m128i alpha = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + x)), zero);
+        // Each alpha repeated in the four 16 bit channels of its pixel
+        const __m128i alphaPairs[2] = {
+            _mm_unpacklo_epi16(alpha, alpha),
+            _mm_unpackhi_epi16(alpha, alpha)
+        };
+        for (int i = 0; i < 2; ++i) {
+            __m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi32(alphaPairs[i], alphaPairs[i]), colorChannels);
+            __m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi32(alphaPairs[i], alphaPairs[i]), colorChannels);
+            lo = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(lo, one), _mm_srli_epi16(lo, 8)), 8);
+            hi = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(hi, one), _mm_srli_epi16(hi, 8)), 8);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x + 4 * i), _mm_packus_epi16(lo, hi));
+        }
+    }
+#elif defined(__ARM_NEON) && Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    const uint8x8_t channels[4] = {
+        vdup_n_u8(qBlue(color)),
+        vdup_n_u8(qGreen(color)),
+        vdup_n_u8(qRed(color)),
+        vdup_n_u8(qAlpha(color))
+    };
+    const uint16x8_t one = vdupq_n_u16(1);
+    for (; x + 8 <= width; x += 8) {
+        const uint8x8_t alpha = vld1_u8(src + x);
+        uint8x8x4_t out;
+        for (int i = 0; i < 4; ++i) {
+            const uint16x8_t product = vmull_u8(alpha, channels[i]);
+            out.val[i] = vshrn_n_u16(vaddq_u16(vaddq_u16(product, one), vshrq_n_u16(product, 8)), 8);
+        }
+        vst4_u8(reinterpret_cast<uint8_t *>(dst + x), out);
+    }
+#endif
+
+    const uint r = qRed(color);
+    const uint g = qGreen(color);
+    const uint b = qBlue(color);
+    const uint a = qAlpha(color);
+    for (; x < width; ++x) {
+        const uint sa = src[x];
+        dst[x] = qRgba(div255(r * sa), div255(g * sa), div255(b * sa), div255(a * sa));
+    }
+}
+
+// Uploads the mask into a single channel texture, a quarter of the memory of
+// the colorized image.
+class ThemeMaskTexture : public QSGTexture
+{
+public:
+    explicit ThemeMaskTexture(const QImage &mask)
+        : m_mask(mask)
+        , m_size(mask.size())
+    {
+    }
+
+    ~ThemeMaskTexture() override
+    {
+        if (m_textureId && QOpenGLContext::currentContext()) {
+            QOpenGLContext::currentContext()->functions()->glDeleteTextures(1, &m_textureId);
+        }
+    }
+
+    int textureId() const override { return int(m_textureId); }
+    QSize textureSize() const override { return m_size; }
+    bool hasAlphaChannel() const override { return true; }
+    bool hasMipmaps() const override { return false; }
+
+    void bind() override
+    {
+        QOpenGLFunctions *gl = QOpenGLContext::currentContext()->functions();
+        const bool upload = !m_textureId;
+        if (upload) {
+            gl->glGenTextures(1, &m_textureId);
+        }
+        gl->glBindTexture(GL_TEXTURE_2D, m_textureId);
+        if (upload) {
+            // Alpha8 scan lines are padded to four bytes.
+            gl->glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            gl->glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, m_size.width(), m_size.height(), 0,
+                             GL_ALPHA, GL_UNSIGNED_BYTE, m_mask.constBits());
+            m_mask = QImage();
+        }
+        updateBindOptions(upload);
+    }
+
+private:
+    QImage m_mask;
+    QSize m_size;
+    GLuint m_textureId = 0;
+};
+
+}
+
+ThemeMaskTextureFactory::ThemeMaskTextureFactory(const QImage &mask)
+    : m_mask(mask)
+{
+}
+
+QSGTexture *ThemeMaskTextureFactory::createTexture(QQuickWindow *window) const
+{
+    Q_UNUSED(window)
+    return new ThemeMaskTexture(m_mask);
+}
+
+QSize ThemeMaskTextureFactory::textureSize() const
+{
+    return m_mask.size();
+}
+
+int ThemeMaskTextureFactory::textureByteCount() const
+{
+    return int(m_mask.sizeInBytes());
+}
+
+QImage ThemeMaskTextureFactory::image() const
+{
+    return m_mask;
+}
+
+ThemeTextureFactory::ThemeTextureFactory(const QSharedPointer<ThemeMaskTextureFactory> &mask, const QColor &color)
+    : m_mask(mask)
+    , m_color(color)
+{
+}
+
+QSGTexture *ThemeTextureFactory::createTexture(QQuickWindow *window) const
+{
+    return window->createTextureWithImage(image());
+}
+
+QSize ThemeTextureFactory::textureSize() const
+{
+    return m_mask->textureSize();
+}
+
+int ThemeTextureFactory::textureByteCount() const
+{
+    const QSize size = textureSize();
+    return size.width() * size.height() * 4;
+}
+
+QImage ThemeTextureFactory::image() const
+{
+    return colorize(m_mask->image(), m_color);
+}
+
+QColor ThemeTextureFactory::color() const
+{
+    return m_color;
+}
+
+ThemeMaskTextureFactory *ThemeTextureFactory::maskFactory() const
+{
+    return m_mask.data();
+}
+
+QImage ThemeTextureFactory::colorize(const QImage &mask, const QColor &color)
+{
+    const QImage source = mask.format() == QImage::Format_Alpha8
+            ? mask
+            : mask.convertToFormat(QImage::Format_Alpha8);
+
+    QImage result(source.size(), QImage::Format_ARGB32_Premultiplied);
+    if (result.isNull()) {
+        return result;
+    }
+    result.setDevicePixelRatio(source.devicePixelRatio());
+
+    const QRgb rgba = color.rgba();
+    for (int y = 0; y < source.height(); ++y) {
+        colorizeScanLine(source.constScanLine(y), reinterpret_cast<QRgb *>(result.scanLine(y)),
+                         source.width(), rgba);
+    }
+    return result;
+}
@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+
+#ifndef SILICA_THEMETEXTUREFACTORY_H
+#define SILICA_THEMETEXTUREFACTORY_H
+
+#include <QColor>
+#include <QImage>
+#include <QQuickTextureFactory>
+#include <QSharedPointer>
+
+// Single channel alpha mask of a monochrome icon, uploaded as an alpha only
+// texture. One mask is shared by every color the icon is requested in.
+class ThemeMaskTextureFactory : public QQuickTextureFactory
+{
+    Q_OBJECT
+public:
+    explicit ThemeMaskTextureFactory(const QImage &mask);
+
+    QSGTexture *createTexture(QQuickWindow *window) const override;
+    QSize textureSize() const override;
+    int textureByteCount() const override;
+    QImage image() const override;
+
+private:
+    QImage m_mask;
+};
+
+// Monochrome icon in a given color. Items that can tint on the GPU render the
+// shared mask directly, others get a texture colorized from it.
+class ThemeTextureFactory : public QQuickTextureFactory
+{
+    Q_OBJECT
+public:
+    ThemeTextureFactory(const QSharedPointer<ThemeMaskTextureFactory> &mask, const QColor &color);
+
+    QSGTexture *createTexture(QQuickWindow *window) const override;
+    QSize textureSize() const override;
+    int textureByteCount() const override;
+    QImage image() const override;
+
+    QColor color() const;
+    ThemeMaskTextureFactory *maskFactory() const;
+
+    // Premultiplied image of the color scaled by the alpha of each mask pixel.
+    static QImage colorize(const QImage &mask, const QColor &color);
+
+private:
+    QSharedPointer<ThemeMaskTextureFactory> m_mask;
+    QColor m_color;
+};
+
+#endif // SILICA_THEMETEXTUREFACTORY_H
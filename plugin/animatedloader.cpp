@@ -4,74 +4,54 @@
 #include <QQmlEngine>
 #include <QQmlComponent>
 #include <QQmlContext>
-#include <QQmlExpression>
 #include <QQmlInfo>
+#include <QQmlProperty>
 #include <QJSValueIterator>
 #include <QTimer>
 #include <QQuickWindow>
 #include <private/qquickitem_p.h>
 
 namespace {
-class PropertyAssigner : public QObject
+// Assigns the initial properties of a loaded item while it is incubated, so
+// bindings see the values from the start. Names are resolved through QML's
+// property cache, shared by all instances of a type, and plain values are
+// written directly. Values which need to stay JavaScript values, such as
+// arrays and objects for var properties, and properties which aren't plain
+// values go through the engine's wrapper of the object instead.
+void assignProperties(QQmlEngine *engine, QObject *object, const QJSValue &properties)
 {
-    Q_OBJECT
-    Q_PROPERTY(QObject *object READ object CONSTANT)
-    Q_PROPERTY(QJSValue properties READ properties CONSTANT)
-public:
-    static void assignProperties(QQmlEngine *engine, QObject *object, const QJSValue &properties)
-    {
-        static QHash<QQmlEngine *, PropertyAssigner *> instances;
-        PropertyAssigner *&assigner = instances[engine];
-        if (!assigner) {
-            assigner = new PropertyAssigner(engine);
-            QObject::connect(engine, &QObject::destroyed, assigner, [engine, assigner]() {
-                instances.remove(engine);
-                delete assigner;
-            });
+    QQmlContext *context = qmlContext(object);
+    QJSValue wrapper;
+
+    QJSValueIterator it(properties);
+    while (it.hasNext()) {
+        it.next();
+        const QString name = it.name();
+        const QJSValue value = it.value();
+
+        QQmlProperty property(object, name, context);
+        if (!property.isValid()) {
+            qmlInfo(object) << "Cannot assign to non-existent property \"" << name << "\"";
+            continue;
+        } else if (!property.isWritable()) {
+            qmlInfo(object) << "Cannot assign to read-only property \"" << name << "\"";
+            continue;
         }
-        assigner->assignProperties(object, properties);
-    }
 
-private:
-    explicit PropertyAssigner(QQmlEngine *engine, QObject *parent = nullptr)
-        : QObject(parent)
-        , m_expression(engine->rootContext(), this, QLatin1String(
-              "var target = object\n"
-              "var source = properties\n"
-              "var errors = []\n"
-              "for (var property in source) {\n"
-              "    try {\n"
-              "        target[property] = source[property]\n"
-              "    } catch (error) {\n"
-              "        errors.push(error.message)\n"
-              "    }\n"
-              "}\n"
-              "if (errors.length > 0) {"
-              "    throw errors.join('\n')\n"
-              "}\n"))
-    {
-    }
+        const bool plainValue = !value.isObject() || value.isQObject() || value.isDate();
+        if (plainValue
+                && property.propertyTypeCategory() != QQmlProperty::List
+                && property.propertyType() != qMetaTypeId<QJSValue>()
+                && property.write(value.toVariant())) {
+            continue;
+        }
 
-    QObject *object() const { return m_object; }
-    QJSValue properties() const { return m_properties; }
-
-    void assignProperties(QObject *object, const QJSValue &properties)
-    {
-        m_object = object;
-        m_properties = properties;
-        m_expression.evaluate();
-        if (m_expression.hasError()) {
-            qmlInfo(object) << m_expression.error();
-            m_expression.clearError();
+        if (wrapper.isUndefined()) {
+            wrapper = engine->newQObject(object);
         }
-        m_object = nullptr;
-        m_properties = QJSValue();
+        wrapper.setProperty(name, value);
     }
-
-    QQmlExpression m_expression;
-    QObject *m_object = nullptr;
-    QJSValue m_properties;
-};
+}
 }
 
 AnimatedLoader::AnimatedLoader(QQuickItem *parent)
@@ -147,7 +127,7 @@ void AnimatedLoader::applyInitialProperties(QQuickItem *it, const QJSValue &prop
 {
     if (!properties.isObject()) return;
     if (QQmlEngine *eng = qmlEngine(this)) {
-        PropertyAssigner::assignProperties(eng, it, properties);
+        assignProperties(eng, it, properties);
     }
 }
 
@@ -426,5 +406,3 @@ void AnimatedLoaderAttached::setAsynchronous(bool asynchronous)
     m_asynchronous = asynchronous;
     emit asynchronousChanged();
 }
-
-#include "animatedloader.moc"
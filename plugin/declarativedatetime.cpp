@@ -1,8 +1,176 @@
 // SPDX-License-Identifier: LGPL-2.1-only
 
 #include "declarativedatetime.h"
+#include "declarativeformatter.h"
+#include <QTimeZone>
+#include <QTimerEvent>
+
+Q_GLOBAL_STATIC(WallClock, wallClockInstance)
+
+WallClock::WallClock(QObject *parent)
+    : QObject(parent)
+    , m_timeZone(QTimeZone::systemTimeZoneId())
+{
+}
+
+WallClock *WallClock::instance()
+{
+    return wallClockInstance();
+}
+
+QDateTime WallClock::currentDateTime() const
+{
+    return m_timer.isActive() ? m_now : QDateTime::currentDateTime();
+}
+
+void WallClock::subscribe(Precision precision)
+{
+    if (precision == Seconds) {
+        ++m_secondSubscribers;
+    } else {
+        ++m_minuteSubscribers;
+    }
+
+    if (!m_timer.isActive()) {
+        m_now = QDateTime::currentDateTime();
+        schedule(m_now);
+    } else if (precision == Seconds && m_secondSubscribers == 1) {
+        schedule(QDateTime::currentDateTime());
+    }
+}
+
+void WallClock::unsubscribe(Precision precision)
+{
+    if (precision == Seconds) {
+        Q_ASSERT(m_secondSubscribers > 0);
+        --m_secondSubscribers;
+    } else {
+        Q_ASSERT(m_minuteSubscribers > 0);
+        --m_minuteSubscribers;
+    }
+
+    if (m_minuteSubscribers + m_secondSubscribers == 0) {
+        m_timer.stop();
+    }
+    // With the last second subscriber gone the timer still wakes on the next
+    // second, and from there on minute boundaries.
+}
+
+void WallClock::schedule(const QDateTime &now)
+{
+    const QTime time = now.time();
+    int interval = 1000 - time.msec();
+    if (m_secondSubscribers == 0) {
+        interval += (59 - time.second()) * 1000;
+    }
+
+    // Coarse timers may fire a little early, a wake up before the boundary
+    // just schedules again.
+    m_timer.start(interval, m_secondSubscribers > 0 ? Qt::PreciseTimer : Qt::CoarseTimer, this);
+}
+
+void WallClock::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() != m_timer.timerId()) {
+        QObject::timerEvent(event);
+        return;
+    }
+
+    const QDateTime previous = m_now;
+    m_now = QDateTime::currentDateTime();
+    schedule(m_now);
+
+    const qint64 previousSecond = previous.toMSecsSinceEpoch() / 1000;
+    const qint64 second = m_now.toMSecsSinceEpoch() / 1000;
+    if (second == previousSecond) {
+        return;
+    }
+
+    if (second / 60 != previousSecond / 60) {
+        const QByteArray timeZone = QTimeZone::systemTimeZoneId();
+        if (m_timeZone != timeZone) {
+            m_timeZone = timeZone;
+            emit timeZoneChanged();
+        }
+        emit minuteChanged();
+    }
+    if (m_secondSubscribers > 0) {
+        emit secondChanged();
+    }
+}
 
 DeclarativeDateTime::DeclarativeDateTime(QObject *parent)
     : QObject(parent)
 {
 }
+
+DeclarativeDateTimeAttached *DeclarativeDateTime::qmlAttachedProperties(QObject *object)
+{
+    return new DeclarativeDateTimeAttached(object);
+}
+
+DeclarativeDateTimeAttached::DeclarativeDateTimeAttached(QObject *parent)
+    : QObject(parent)
+{
+    WallClock *clock = WallClock::instance();
+    clock->subscribe(m_precision);
+    connect(clock, &WallClock::minuteChanged, this, &DeclarativeDateTimeAttached::tick);
+}
+
+DeclarativeDateTimeAttached::~DeclarativeDateTimeAttached()
+{
+    if (WallClock *clock = WallClock::instance()) {
+        clock->unsubscribe(m_precision);
+    }
+}
+
+void DeclarativeDateTimeAttached::setDateTime(const QDateTime &dateTime)
+{
+    if (m_dateTime != dateTime) {
+        m_dateTime = dateTime;
+        emit dateTimeChanged();
+        updateRelativeText();
+    }
+}
+
+void DeclarativeDateTimeAttached::setSecondsPrecision(bool seconds)
+{
+    const WallClock::Precision precision = seconds ? WallClock::Seconds : WallClock::Minutes;
+    if (m_precision != precision) {
+        WallClock *clock = WallClock::instance();
+        clock->subscribe(precision);
+        clock->unsubscribe(m_precision);
+        m_precision = precision;
+
+        if (seconds) {
+            disconnect(clock, &WallClock::minuteChanged, this, &DeclarativeDateTimeAttached::tick);
+            connect(clock, &WallClock::secondChanged, this, &DeclarativeDateTimeAttached::tick);
+        } else {
+            disconnect(clock, &WallClock::secondChanged, this, &DeclarativeDateTimeAttached::tick);
+            connect(clock, &WallClock::minuteChanged, this, &DeclarativeDateTimeAttached::tick);
+        }
+        emit secondsPrecisionChanged();
+    }
+}
+
+QDateTime DeclarativeDateTimeAttached::currentDateTime() const
+{
+    return WallClock::instance()->currentDateTime();
+}
+
+void DeclarativeDateTimeAttached::tick()
+{
+    emit currentDateTimeChanged();
+    updateRelativeText();
+}
+
+void DeclarativeDateTimeAttached::updateRelativeText()
+{
+    const QString text = m_dateTime.isValid()
+            ? DeclarativeFormatter::formatRelativeTime(m_dateTime, currentDateTime())
+            : QString();
+    if (m_relativeText != text) {
+        m_relativeText = text;
+        emit relativeTextChanged();
+    }
+}
@@ -4,6 +4,49 @@
 #define SAILFISH_SILICA_PLUGIN_DECLARATIVEDATETIME_H
 
 #include <QObject>
+#include <QBasicTimer>
+#include <QDateTime>
+#include <qqml.h>
+
+// The process wide clock. While anyone subscribes it wakes on each minute
+// boundary, or on each second boundary while a subscriber needs seconds,
+// and otherwise doesn't run at all.
+class WallClock : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Precision { Minutes, Seconds };
+
+    explicit WallClock(QObject *parent = nullptr);
+
+    static WallClock *instance();
+
+    // The time of the last tick while subscribed, otherwise the current time.
+    QDateTime currentDateTime() const;
+
+    void subscribe(Precision precision);
+    void unsubscribe(Precision precision);
+
+Q_SIGNALS:
+    void minuteChanged();
+    void secondChanged();
+    void timeZoneChanged();
+
+protected:
+    void timerEvent(QTimerEvent *event) override;
+
+private:
+    void schedule(const QDateTime &now);
+
+    QBasicTimer m_timer;
+    QDateTime m_now;
+    QByteArray m_timeZone;
+    int m_minuteSubscribers = 0;
+    int m_secondSubscribers = 0;
+};
+
+class DeclarativeDateTimeAttached;
 
 class DeclarativeDateTime : public QObject
 {
@@ -13,6 +56,48 @@ public:
 
     enum HourMode { DefaultHours, TwentyFourHours, TwelveHours };
     Q_ENUM(HourMode)
+
+    static DeclarativeDateTimeAttached *qmlAttachedProperties(QObject *object);
 };
 
+// Relative time of an item's dateTime, driven by the shared WallClock
+// instead of a Timer per delegate, e.g.
+//   Label { DateTime.dateTime: model.timestamp; text: DateTime.relativeText }
+// relativeText only notifies when the text changes, not on every tick.
+class DeclarativeDateTimeAttached : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QDateTime dateTime READ dateTime WRITE setDateTime NOTIFY dateTimeChanged)
+    Q_PROPERTY(bool secondsPrecision READ secondsPrecision WRITE setSecondsPrecision NOTIFY secondsPrecisionChanged)
+    Q_PROPERTY(QDateTime currentDateTime READ currentDateTime NOTIFY currentDateTimeChanged)
+    Q_PROPERTY(QString relativeText READ relativeText NOTIFY relativeTextChanged)
+
+public:
+    explicit DeclarativeDateTimeAttached(QObject *parent = nullptr);
+    ~DeclarativeDateTimeAttached();
+
+    QDateTime dateTime() const { return m_dateTime; }
+    void setDateTime(const QDateTime &dateTime);
+    bool secondsPrecision() const { return m_precision == WallClock::Seconds; }
+    void setSecondsPrecision(bool seconds);
+    QDateTime currentDateTime() const;
+    QString relativeText() const { return m_relativeText; }
+
+Q_SIGNALS:
+    void dateTimeChanged();
+    void secondsPrecisionChanged();
+    void currentDateTimeChanged();
+    void relativeTextChanged();
+
+private:
+    void tick();
+    void updateRelativeText();
+
+    QDateTime m_dateTime;
+    QString m_relativeText;
+    WallClock::Precision m_precision = WallClock::Minutes;
+};
+
+QML_DECLARE_TYPEINFO(DeclarativeDateTime, QML_HAS_ATTACHED_PROPERTIES)
+
 #endif // SAILFISH_SILICA_PLUGIN_DECLARATIVEDATETIME_H
@@ -118,7 +118,11 @@ Qt::LayoutDirection DeclarativeFormatter::textDirection(const QString &text)
 
 QString DeclarativeFormatter::formatRelativeTime(const QDateTime &dateTime)
 {
-    QDateTime now = QDateTime::currentDateTime();
+    return formatRelativeTime(dateTime, QDateTime::currentDateTime());
+}
+
+QString DeclarativeFormatter::formatRelativeTime(const QDateTime &dateTime, const QDateTime &now)
+{
     qint64 secondsDiff = dateTime.secsTo(now);
 
     if (secondsDiff < 60) {
@@ -55,6 +55,8 @@ public:
     Q_INVOKABLE QString trId(const QString &id, const QString &catalog, int n = -1, const QString &localeName = "");
     Q_INVOKABLE Qt::LayoutDirection textDirection(const QString &text);
 
+    static QString formatRelativeTime(const QDateTime &dateTime, const QDateTime &now);
+
 private:
     QString formatRelativeTime(const QDateTime &dateTime);
     QString formatDurationInternal(int seconds, DurationType formatType);
@@ -1,20 +1,99 @@
 // SPDX-License-Identifier: LGPL-2.1-only
 
 #include "declarativeframerate.h"
-#include <QElapsedTimer>
-#include <QStandardPaths>
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QQuickWindow>
+#include <QScreen>
 #include <QSettings>
+#include <QSGGeometryNode>
+#include <QSGVertexColorMaterial>
+#include <QTimerEvent>
 
-DeclarativeFrameRate::DeclarativeFrameRate(QObject *parent)
-    : QObject(parent)
-    , m_timer(new QTimer(this))
+#include <algorithm>
+
+namespace {
+
+const int StatisticsInterval = 500; // ms
+const qreal JankFactor = 1.5;
+
+// Thread ids of the trace events.
+const int GuiThreadTrack = 1;
+const int RenderThreadTrack = 2;
+
+inline qreal milliseconds(qint64 nsecs)
+{
+    return nsecs / 1000000.0;
+}
+
+void appendTraceEvent(QJsonArray *events, const QString &name, int track, qint64 start, qint64 end)
+{
+    if (start <= 0 || end < start) {
+        return;
+    }
+
+    QJsonObject event;
+    event.insert(QStringLiteral("name"), name);
+    event.insert(QStringLiteral("ph"), QStringLiteral("X"));
+    event.insert(QStringLiteral("pid"), QCoreApplication::applicationPid());
+    event.insert(QStringLiteral("tid"), track);
+    event.insert(QStringLiteral("ts"), start / 1000.0);
+    event.insert(QStringLiteral("dur"), (end - start) / 1000.0);
+    events->append(event);
+}
+
+void appendThreadName(QJsonArray *events, int track, const QString &name)
 {
+    QJsonObject arguments;
+    arguments.insert(QStringLiteral("name"), name);
+
+    QJsonObject event;
+    event.insert(QStringLiteral("name"), QStringLiteral("thread_name"));
+    event.insert(QStringLiteral("ph"), QStringLiteral("M"));
+    event.insert(QStringLiteral("pid"), QCoreApplication::applicationPid());
+    event.insert(QStringLiteral("tid"), track);
+    event.insert(QStringLiteral("args"), arguments);
+    events->append(event);
+}
+
+void setBar(QSGGeometry::ColoredPoint2D *vertices, float x, float y, float width, float height,
+            const QColor &color)
+{
+    const uchar r = color.red();
+    const uchar g = color.green();
+    const uchar b = color.blue();
+    const uchar a = color.alpha();
+
+    vertices[0].set(x, y, r, g, b, a);
+    vertices[1].set(x + width, y, r, g, b, a);
+    vertices[2].set(x, y + height, r, g, b, a);
+    vertices[3].set(x + width, y, r, g, b, a);
+    vertices[4].set(x + width, y + height, r, g, b, a);
+    vertices[5].set(x, y + height, r, g, b, a);
+}
+
+}
+
+DeclarativeFrameRate::DeclarativeFrameRate(QQuickItem *parent)
+    : QQuickItem(parent)
+    , m_animated(0)
+    , m_generation(0)
+    , m_written(0)
+{
+    setFlag(ItemHasContents);
+
     // Check if framerate display is enabled via configuration
     QSettings settings;
-    m_enabled = settings.value("debug/framerate", false).toBool();
+    m_running = settings.value("debug/framerate", false).toBool();
+
+    for (int i = 0; i < HistogramBuckets; ++i) {
+        m_histogram.append(0);
+    }
 
-    connect(m_timer, &QTimer::timeout, this, &DeclarativeFrameRate::updateFrameTime);
-    m_timer->start(1000); // Update every second
+    m_clock.start();
 }
 
 DeclarativeFrameRate::~DeclarativeFrameRate()
@@ -24,6 +103,23 @@ DeclarativeFrameRate::~DeclarativeFrameRate()
     }
 }
 
+void DeclarativeFrameRate::setRunning(bool running)
+{
+    if (m_running != running) {
+        m_running = running;
+        connectWindow();
+        emit runningChanged();
+    }
+}
+
+void DeclarativeFrameRate::itemChange(ItemChange change, const ItemChangeData &data)
+{
+    if (change == ItemSceneChange) {
+        setWindow(data.window);
+    }
+    QQuickItem::itemChange(change, data);
+}
+
 void DeclarativeFrameRate::setWindow(QQuickWindow *window)
 {
     if (m_window == window) {
@@ -35,116 +131,283 @@ void DeclarativeFrameRate::setWindow(QQuickWindow *window)
     }
 
     m_window = window;
-
-    if (m_window && m_enabled) {
-        connect(m_window, &QQuickWindow::beforeRendering, this, &DeclarativeFrameRate::onBeforeRendering);
-        connect(m_window, &QQuickWindow::afterRendering, this, &DeclarativeFrameRate::onAfterRendering);
-        connect(m_window, &QQuickWindow::beforeSynchronizing, this, &DeclarativeFrameRate::onBeforeSynchronizing);
-        connect(m_window, &QQuickWindow::sceneGraphInvalidated, this, &DeclarativeFrameRate::onSceneGraphInvalidated);
-    }
+    connectWindow();
 }
 
-void DeclarativeFrameRate::setEnabled(bool enabled)
+void DeclarativeFrameRate::connectWindow()
 {
-    if (m_enabled != enabled) {
-        m_enabled = enabled;
+    if (m_window) {
+        disconnect(m_window, nullptr, this, nullptr);
+    }
 
-        if (m_window) {
-            if (enabled) {
-                connect(m_window, &QQuickWindow::beforeRendering, this, &DeclarativeFrameRate::onBeforeRendering);
-                connect(m_window, &QQuickWindow::afterRendering, this, &DeclarativeFrameRate::onAfterRendering);
-                connect(m_window, &QQuickWindow::beforeSynchronizing, this, &DeclarativeFrameRate::onBeforeSynchronizing);
-                connect(m_window, &QQuickWindow::sceneGraphInvalidated, this, &DeclarativeFrameRate::onSceneGraphInvalidated);
-            } else {
-                disconnect(m_window, nullptr, this, nullptr);
-            }
-        }
+    // Frames still in the buffer belong to the previous window or run. The
+    // render thread may be in the middle of a frame, it drops that frame and
+    // resets its own state when it sees the new generation.
+    m_generation.fetchAndAddRelease(1);
+    m_read = m_written.loadAcquire();
+    m_frames.clear();
 
-        // Save setting
-        QSettings settings;
-        settings.setValue("debug/framerate", enabled);
+    if (!m_window || !m_running) {
+        m_statisticsTimer.stop();
+        return;
     }
+
+    // All but afterAnimating() are emitted on the render thread with the
+    // threaded render loop, where the GUI thread is only blocked during sync.
+    connect(m_window, &QQuickWindow::afterAnimating,
+            this, &DeclarativeFrameRate::onAfterAnimating, Qt::DirectConnection);
+    connect(m_window, &QQuickWindow::beforeSynchronizing,
+            this, &DeclarativeFrameRate::onBeforeSynchronizing, Qt::DirectConnection);
+    connect(m_window, &QQuickWindow::afterSynchronizing,
+            this, &DeclarativeFrameRate::onAfterSynchronizing, Qt::DirectConnection);
+    connect(m_window, &QQuickWindow::beforeRendering,
+            this, &DeclarativeFrameRate::onBeforeRendering, Qt::DirectConnection);
+    connect(m_window, &QQuickWindow::afterRendering,
+            this, &DeclarativeFrameRate::onAfterRendering, Qt::DirectConnection);
+    connect(m_window, &QQuickWindow::frameSwapped,
+            this, &DeclarativeFrameRate::onFrameSwapped, Qt::DirectConnection);
+    connect(m_window, &QQuickWindow::sceneGraphInvalidated,
+            this, &DeclarativeFrameRate::onSceneGraphInvalidated, Qt::DirectConnection);
+
+    m_statisticsTimer.start(StatisticsInterval, this);
 }
 
-void DeclarativeFrameRate::onBeforeRendering()
+void DeclarativeFrameRate::onAfterAnimating()
 {
-    if (!m_enabled) {
-        return;
-    }
+    m_animated.storeRelease(m_clock.nsecsElapsed());
+}
 
-    static QElapsedTimer timer;
-    if (!timer.isValid()) {
-        timer.start();
+void DeclarativeFrameRate::onBeforeSynchronizing()
+{
+    const quint32 generation = m_generation.loadAcquire();
+    if (m_currentGeneration != generation) {
+        m_currentGeneration = generation;
+        m_lastSwap = 0;
     }
 
-    m_lastFrameTime = timer.nsecsElapsed();
+    m_current = FrameRecord();
+    m_current.syncStart = m_clock.nsecsElapsed();
+    // Frames without animations do not advance the animation clock.
+    m_current.animated = m_animated.fetchAndStoreAcquire(0);
+}
+
+void DeclarativeFrameRate::onAfterSynchronizing()
+{
+    m_current.syncEnd = m_clock.nsecsElapsed();
+}
+
+void DeclarativeFrameRate::onBeforeRendering()
+{
+    m_current.renderStart = m_clock.nsecsElapsed();
 }
 
 void DeclarativeFrameRate::onAfterRendering()
 {
-    if (!m_enabled) {
+    m_current.renderEnd = m_clock.nsecsElapsed();
+}
+
+void DeclarativeFrameRate::onFrameSwapped()
+{
+    // A frame started before the window or running state changed.
+    if (m_current.syncStart == 0 || m_currentGeneration != m_generation.loadAcquire()) {
+        m_current = FrameRecord();
         return;
     }
 
-    updateFrameTime();
-    renderHUD();
+    m_current.swapped = m_clock.nsecsElapsed();
+    m_current.interval = m_lastSwap > 0 ? m_current.swapped - m_lastSwap : 0;
+    m_lastSwap = m_current.swapped;
+
+    const quint32 written = m_written.load();
+    m_ring[written % FrameBufferSize] = m_current;
+    m_written.storeRelease(written + 1);
+
+    m_current = FrameRecord();
 }
 
-void DeclarativeFrameRate::onBeforeSynchronizing()
+void DeclarativeFrameRate::onSceneGraphInvalidated()
 {
-    // Could be used for additional timing if needed
+    m_current = FrameRecord();
+    m_lastSwap = 0;
 }
 
-void DeclarativeFrameRate::onSceneGraphInvalidated()
+void DeclarativeFrameRate::readFrames()
+{
+    const quint32 written = m_written.loadAcquire();
+    quint32 first = m_read;
+    if (written - first > quint32(FrameBufferSize)) {
+        first = written - FrameBufferSize;
+    }
+
+    QVector<FrameRecord> records;
+    records.reserve(written - first);
+    for (quint32 i = first; i != written; ++i) {
+        records.append(m_ring[i % FrameBufferSize]);
+    }
+
+    // Records the render thread started overwriting while they were copied
+    // may be torn and are dropped.
+    const quint32 overwritten = m_written.loadAcquire() + 1 - FrameBufferSize;
+    if (qint32(overwritten - first) > 0) {
+        records.remove(0, qMin<int>(overwritten - first, records.count()));
+    }
+
+    m_read = written;
+    m_frames += records;
+    if (m_frames.count() > FrameBufferSize) {
+        m_frames.remove(0, m_frames.count() - FrameBufferSize);
+    }
+}
+
+qreal DeclarativeFrameRate::frameBudget() const
 {
-    // Clean up GL resources if needed
-    m_frameTimes.clear();
+    const qreal refreshRate = m_window && m_window->screen() ? m_window->screen()->refreshRate() : 0;
+    return refreshRate > 0 ? 1000 / refreshRate : 1000.0 / 60;
 }
 
-void DeclarativeFrameRate::updateFrameTime()
+void DeclarativeFrameRate::updateStatistics()
 {
-    if (!m_enabled || !m_window) {
-        return;
+    const qint64 now = m_clock.nsecsElapsed();
+    const qreal jankTime = JankFactor * frameBudget();
+
+    QVector<qreal> frameTimes;
+    frameTimes.reserve(m_frames.count());
+    qint64 animate = 0;
+    qint64 sync = 0;
+    qint64 render = 0;
+    qint64 swap = 0;
+    int recentFrames = 0;
+
+    for (int i = 0; i < HistogramBuckets; ++i) {
+        m_histogram[i] = 0;
     }
+    m_jankCount = 0;
+
+    for (const FrameRecord &frame : m_frames) {
+        if (frame.animated > 0 && frame.animated <= frame.syncStart) {
+            animate += frame.syncStart - frame.animated;
+        }
+        sync += frame.syncEnd - frame.syncStart;
+        render += frame.renderEnd - frame.renderStart;
+        swap += frame.swapped - frame.renderEnd;
 
-    static QElapsedTimer timer;
-    if (!timer.isValid()) {
-        timer.start();
+        if (frame.swapped > now - 1000000000) {
+            ++recentFrames;
+        }
+
+        if (frame.interval > 0) {
+            const qreal frameTime = milliseconds(frame.interval);
+            frameTimes.append(frameTime);
+            ++m_histogram[qMin<int>(frameTime / HistogramBucketWidth, HistogramBuckets - 1)];
+            if (frameTime > jankTime) {
+                ++m_jankCount;
+            }
+        }
+    }
+
+    const int count = qMax(1, m_frames.count());
+    m_animateTime = milliseconds(animate / count);
+    m_syncTime = milliseconds(sync / count);
+    m_renderTime = milliseconds(render / count);
+    m_swapTime = milliseconds(swap / count);
+    m_fps = recentFrames;
+
+    std::sort(frameTimes.begin(), frameTimes.end());
+    auto percentile = [&frameTimes](qreal fraction) {
+        return frameTimes.isEmpty()
+                ? 0.0
+                : frameTimes.at(qMin<int>(frameTimes.count() * fraction, frameTimes.count() - 1));
+    };
+    m_medianFrameTime = percentile(0.5);
+    m_frameTime95 = percentile(0.95);
+    m_frameTime99 = percentile(0.99);
+
+    emit statisticsChanged();
+}
+
+void DeclarativeFrameRate::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() == m_statisticsTimer.timerId()) {
+        readFrames();
+        updateStatistics();
+        if (isVisible()) {
+            update();
+        }
         return;
     }
+    QQuickItem::timerEvent(event);
+}
 
-    qint64 currentTime = timer.nsecsElapsed();
-    qint64 frameDuration = currentTime - m_lastFrameTime;
+bool DeclarativeFrameRate::saveTrace(const QString &path)
+{
+    readFrames();
 
-    m_frameTimes.append(frameDuration);
+    QJsonArray events;
+    appendThreadName(&events, GuiThreadTrack, QStringLiteral("GUI"));
+    appendThreadName(&events, RenderThreadTrack, QStringLiteral("Render"));
 
-    // Keep only the last FRAME_BUFFER_SIZE frames
-    if (m_frameTimes.size() > FRAME_BUFFER_SIZE) {
-        m_frameTimes.removeFirst();
+    for (const FrameRecord &frame : m_frames) {
+        // From the animation tick to sync, which includes polishing items.
+        appendTraceEvent(&events, QStringLiteral("animate"), GuiThreadTrack, frame.animated, frame.syncStart);
+        appendTraceEvent(&events, QStringLiteral("sync"), RenderThreadTrack, frame.syncStart, frame.syncEnd);
+        appendTraceEvent(&events, QStringLiteral("render"), RenderThreadTrack, frame.renderStart, frame.renderEnd);
+        appendTraceEvent(&events, QStringLiteral("swap"), RenderThreadTrack, frame.renderEnd, frame.swapped);
     }
 
-    m_lastFrameTime = currentTime;
+    QJsonObject trace;
+    trace.insert(QStringLiteral("traceEvents"), events);
+    trace.insert(QStringLiteral("displayTimeUnit"), QStringLiteral("ms"));
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    const QByteArray data = QJsonDocument(trace).toJson(QJsonDocument::Compact);
+    return file.write(data) == data.size();
 }
 
-void DeclarativeFrameRate::renderHUD()
+QSGNode *DeclarativeFrameRate::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *)
 {
-    if (!m_enabled || !m_window || m_frameTimes.isEmpty()) {
-        return;
+    QSGGeometryNode *node = static_cast<QSGGeometryNode *>(oldNode);
+
+    if (m_frames.isEmpty() || width() <= 0 || height() <= 0) {
+        delete node;
+        return nullptr;
     }
 
-    // Calculate average frame time and FPS
-    qint64 totalTime = 0;
-    for (qint64 time : m_frameTimes) {
-        totalTime += time;
+    if (!node) {
+        node = new QSGGeometryNode;
+        QSGGeometry *geometry = new QSGGeometry(QSGGeometry::defaultAttributes_ColoredPoint2D(), 0);
+        geometry->setDrawingMode(QSGGeometry::DrawTriangles);
+        node->setGeometry(geometry);
+        node->setFlag(QSGNode::OwnsGeometry);
+        node->setMaterial(new QSGVertexColorMaterial);
+        node->setFlag(QSGNode::OwnsMaterial);
     }
 
-    qint64 avgFrameTime = totalTime / m_frameTimes.size();
-    double fps = 1000000000.0 / avgFrameTime; // Convert nanoseconds to FPS
+    // One bar per frame and a line marking the frame budget.
+    QSGGeometry *geometry = node->geometry();
+    geometry->allocate(6 * (m_frames.count() + 1));
+    QSGGeometry::ColoredPoint2D *vertices = geometry->vertexDataAsColoredPoint2D();
 
-    // TODO: Render HUD using QSG
-    // This would involve creating a custom QSG node with simple geometry
-    // (bars/lines) to display the framerate information
+    const qreal budget = frameBudget();
+    const float barWidth = width() / FrameBufferSize;
+    const float scale = height() / (2 * budget);
+    const float x = width() - barWidth * m_frames.count();
+
+    for (int i = 0; i < m_frames.count(); ++i) {
+        const qreal frameTime = milliseconds(m_frames.at(i).interval);
+        const float barHeight = qMin<float>(height(), frameTime * scale);
+        const QColor color = frameTime <= budget * JankFactor
+                ? QColor(0, 200, 0, 200)
+                : frameTime <= 2 * budget * JankFactor
+                ? QColor(230, 200, 0, 200)
+                : QColor(230, 0, 0, 200);
+
+        setBar(vertices + 6 * i, x + i * barWidth, height() - barHeight, qMax(1.0f, barWidth - 1), barHeight, color);
+    }
+    setBar(vertices + 6 * m_frames.count(), 0, height() / 2, width(), 1, QColor(255, 255, 255, 160));
 
-    // For now, just log the FPS
-    qDebug() << "FPS:" << fps << "Avg frame time:" << avgFrameTime / 1000000.0 << "ms";
+    node->markDirty(QSGNode::DirtyGeometry);
+    return node;
 }
@@ -3,37 +3,141 @@
 #ifndef SAILFISH_SILICA_PLUGIN_DECLARATIVEFRAMERATE_H
 #define SAILFISH_SILICA_PLUGIN_DECLARATIVEFRAMERATE_H
 
-#include <QObject>
-#include <QQuickWindow>
-#include <QTimer>
+#include <QAtomicInteger>
+#include <QBasicTimer>
+#include <QElapsedTimer>
+#include <QQuickItem>
+#include <QVector>
 
-class DeclarativeFrameRate : public QObject
+class QQuickWindow;
+
+// Measures the frames of the window the item is in and draws the most recent
+// frame times as bars, one per frame, scaled so the frame budget is half the
+// height of the item.
+//
+// Timestamps are taken from the window's scene graph signals, mostly on the
+// render thread, and published through a ring buffer which the GUI thread
+// reads to update the statistics a few times a second.
+class DeclarativeFrameRate : public QQuickItem
 {
     Q_OBJECT
+    Q_PROPERTY(bool running READ running WRITE setRunning NOTIFY runningChanged)
+    Q_PROPERTY(qreal fps READ fps NOTIFY statisticsChanged)
+    Q_PROPERTY(qreal medianFrameTime READ medianFrameTime NOTIFY statisticsChanged)
+    Q_PROPERTY(qreal frameTime95 READ frameTime95 NOTIFY statisticsChanged)
+    Q_PROPERTY(qreal frameTime99 READ frameTime99 NOTIFY statisticsChanged)
+    Q_PROPERTY(qreal animateTime READ animateTime NOTIFY statisticsChanged)
+    Q_PROPERTY(qreal syncTime READ syncTime NOTIFY statisticsChanged)
+    Q_PROPERTY(qreal renderTime READ renderTime NOTIFY statisticsChanged)
+    Q_PROPERTY(qreal swapTime READ swapTime NOTIFY statisticsChanged)
+    Q_PROPERTY(int jankCount READ jankCount NOTIFY statisticsChanged)
+    Q_PROPERTY(QList<int> histogram READ histogram NOTIFY statisticsChanged)
 
 public:
-    explicit DeclarativeFrameRate(QObject *parent = nullptr);
+    enum {
+        FrameBufferSize = 128,
+        HistogramBuckets = 16,
+        HistogramBucketWidth = 2 // ms
+    };
+
+    explicit DeclarativeFrameRate(QQuickItem *parent = nullptr);
     ~DeclarativeFrameRate();
 
+    // Defaults to the debug/framerate setting.
+    bool running() const { return m_running; }
+    void setRunning(bool running);
+
+    // Statistics of the frames recorded in the last FrameBufferSize frames,
+    // times are in milliseconds.
+    qreal fps() const { return m_fps; }
+    qreal medianFrameTime() const { return m_medianFrameTime; }
+    qreal frameTime95() const { return m_frameTime95; }
+    qreal frameTime99() const { return m_frameTime99; }
+    qreal animateTime() const { return m_animateTime; }
+    qreal syncTime() const { return m_syncTime; }
+    qreal renderTime() const { return m_renderTime; }
+    qreal swapTime() const { return m_swapTime; }
+    // Frames which took longer than one and a half refresh intervals.
+    int jankCount() const { return m_jankCount; }
+    // Frame time counts in HistogramBucketWidth ms buckets, the last bucket
+    // also counts all longer frames.
+    QList<int> histogram() const { return m_histogram; }
+
+    // Writes the recorded frames as a Chrome trace event file.
+    Q_INVOKABLE bool saveTrace(const QString &path);
+
+Q_SIGNALS:
+    void runningChanged();
+    void statisticsChanged();
+
+protected:
+    void itemChange(ItemChange change, const ItemChangeData &data) override;
+    void timerEvent(QTimerEvent *event) override;
+    QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data) override;
+
+private:
+    // Timestamps of one frame in nanoseconds since the item was created.
+    struct FrameRecord {
+        qint64 animated = 0;
+        qint64 syncStart = 0;
+        qint64 syncEnd = 0;
+        qint64 renderStart = 0;
+        qint64 renderEnd = 0;
+        qint64 swapped = 0;
+        // Time from the previous frame's swap.
+        qint64 interval = 0;
+    };
+
     void setWindow(QQuickWindow *window);
-    void setEnabled(bool enabled);
+    void connectWindow();
 
-private slots:
+    void onAfterAnimating();
+    void onBeforeSynchronizing();
+    void onAfterSynchronizing();
     void onBeforeRendering();
     void onAfterRendering();
-    void onBeforeSynchronizing();
+    void onFrameSwapped();
     void onSceneGraphInvalidated();
 
-private:
-    void updateFrameTime();
-    void renderHUD();
+    void readFrames();
+    void updateStatistics();
+    qreal frameBudget() const;
 
     QQuickWindow *m_window = nullptr;
-    QTimer *m_timer = nullptr;
-    QList<qint64> m_frameTimes;
-    qint64 m_lastFrameTime = 0;
-    bool m_enabled = false;
-    static const int FRAME_BUFFER_SIZE = 120;
+    QElapsedTimer m_clock;
+    QBasicTimer m_statisticsTimer;
+    bool m_running = false;
+
+    // Written on the GUI thread, picked up when the frame is synchronized.
+    QAtomicInteger<qint64> m_animated;
+    // Incremented by the GUI thread when the window or running state changes,
+    // the render thread then starts over from the next frame.
+    QAtomicInteger<quint32> m_generation;
+
+    // Owned by the render thread.
+    FrameRecord m_current;
+    qint64 m_lastSwap = 0;
+    quint32 m_currentGeneration = 0;
+
+    // Single producer ring buffer, m_written counts the records ever written
+    // and is only incremented once a record is complete.
+    FrameRecord m_ring[FrameBufferSize];
+    QAtomicInteger<quint32> m_written;
+    quint32 m_read = 0;
+
+    // GUI thread copy of the most recent frames, oldest first.
+    QVector<FrameRecord> m_frames;
+
+    qreal m_fps = 0;
+    qreal m_medianFrameTime = 0;
+    qreal m_frameTime95 = 0;
+    qreal m_frameTime99 = 0;
+    qreal m_animateTime = 0;
+    qreal m_syncTime = 0;
+    qreal m_renderTime = 0;
+    qreal m_swapTime = 0;
+    int m_jankCount = 0;
+    QList<int> m_histogram;
 };
 
 #endif // SAILFISH_SILICA_PLUGIN_DECLARATIVEFRAMERATE_H
@@ -4,15 +4,66 @@
 #include <QVariantAnimation>
 #include <QMetaType>
 
+namespace {
+
+int components(const QVariant &value, int type, qreal *components)
+{
+    switch (type) {
+    case QMetaType::Int:
+    case QMetaType::UInt:
+    case QMetaType::LongLong:
+    case QMetaType::ULongLong:
+    case QMetaType::Float:
+    case QMetaType::Double:
+        components[0] = value.toReal();
+        return 1;
+    case QMetaType::QColor:
+        value.value<QColor>().getRgbF(&components[0], &components[1], &components[2], &components[3]);
+        return 4;
+    case QMetaType::QPoint:
+    case QMetaType::QPointF: {
+        const QPointF point = value.toPointF();
+        components[0] = point.x();
+        components[1] = point.y();
+        return 2;
+    }
+    case QMetaType::QSize:
+    case QMetaType::QSizeF: {
+        const QSizeF size = value.toSizeF();
+        components[0] = size.width();
+        components[1] = size.height();
+        return 2;
+    }
+    case QMetaType::QRect:
+    case QMetaType::QRectF: {
+        const QRectF rect = value.toRectF();
+        components[0] = rect.x();
+        components[1] = rect.y();
+        components[2] = rect.width();
+        components[3] = rect.height();
+        return 4;
+    }
+    default:
+        return 0;
+    }
+}
+
+}
+
 DeclarativeVariantInterpolator::DeclarativeVariantInterpolator(QObject *parent)
     : QObject(parent)
 {
 }
 
+DeclarativeVariantInterpolator::~DeclarativeVariantInterpolator()
+{
+}
+
 void DeclarativeVariantInterpolator::setFrom(const QVariant &from)
 {
     if (m_from != from) {
         m_from = from;
+        resolveType();
         updateValue();
         emit fromChanged();
     }
@@ -22,6 +73,7 @@ void DeclarativeVariantInterpolator::setTo(const QVariant &to)
 {
     if (m_to != to) {
         m_to = to;
+        resolveType();
         updateValue();
         emit toChanged();
     }
@@ -39,92 +91,118 @@ void DeclarativeVariantInterpolator::setProgress(qreal progress)
     }
 }
 
-void DeclarativeVariantInterpolator::updateValue()
+QVariant DeclarativeVariantInterpolator::value() const
 {
-    QVariant newValue = interpolate(m_from, m_to, m_progress);
-
-    if (m_value != newValue) {
-        m_value = newValue;
-        emit valueChanged();
+    const qreal *c = m_valueComponents;
+    switch (m_type) {
+    case Real:
+        return c[0];
+    case Color:
+        return QColor::fromRgbF(c[0], c[1], c[2], c[3]);
+    case Point:
+        return QPointF(c[0], c[1]);
+    case Size:
+        return QSizeF(c[0], c[1]);
+    case Rect:
+        return QRectF(c[0], c[1], c[2], c[3]);
+    case Other:
+        break;
     }
+    return m_value;
 }
 
-QVariant DeclarativeVariantInterpolator::interpolate(const QVariant &from, const QVariant &to, qreal progress)
+void DeclarativeVariantInterpolator::resolveType()
 {
-    if (!from.isValid() || !to.isValid()) {
-        return to;
-    }
-
-    // Try to use QVariantAnimation's interpolator first
-    QVariantAnimation animation;
-    animation.setStartValue(from);
-    animation.setEndValue(to);
-    animation.setCurrentTime(progress * animation.totalDuration());
+    m_type = Other;
+    m_componentCount = 0;
+    m_resolved = false;
 
-    QVariant interpolated = animation.currentValue();
-    if (interpolated.isValid()) {
-        return interpolated;
+    if (!m_from.isValid() || !m_to.isValid()) {
+        return;
     }
 
-    // Fallback interpolation for specific types
-    if (from.type() == to.type()) {
-        switch (from.type()) {
-            case QVariant::Int:
-            case QVariant::Double: {
-                qreal fromVal = from.toReal();
-                qreal toVal = to.toReal();
-                return fromVal + (toVal - fromVal) * progress;
-            }
-
-            case QVariant::Color: {
-                QColor fromColor = from.value<QColor>();
-                QColor toColor = to.value<QColor>();
-
-                return QColor(
-                    fromColor.red() + (toColor.red() - fromColor.red()) * progress,
-                    fromColor.green() + (toColor.green() - fromColor.green()) * progress,
-                    fromColor.blue() + (toColor.blue() - fromColor.blue()) * progress,
-                    fromColor.alpha() + (toColor.alpha() - fromColor.alpha()) * progress
-                );
-            }
-
-            case QVariant::PointF: {
-                QPointF fromPoint = from.toPointF();
-                QPointF toPoint = to.toPointF();
-
-                return QPointF(
-                    fromPoint.x() + (toPoint.x() - fromPoint.x()) * progress,
-                    fromPoint.y() + (toPoint.y() - fromPoint.y()) * progress
-                );
-            }
+    // Both ends are converted to the same components, e.g. an int and a real
+    // or a QPoint and a QPointF interpolate as reals.
+    qreal fromComponents[4];
+    qreal toComponents[4];
+    const int fromCount = components(m_from, m_from.userType(), fromComponents);
+    const int toCount = components(m_to, m_to.userType(), toComponents);
+    const bool colors = m_from.userType() == QMetaType::QColor;
+    if (fromCount > 0 && fromCount == toCount && colors == (m_to.userType() == QMetaType::QColor)) {
+        for (int i = 0; i < fromCount; ++i) {
+            m_fromComponents[i] = fromComponents[i];
+            m_toComponents[i] = toComponents[i];
+        }
+        m_componentCount = fromCount;
+
+        switch (m_from.userType()) {
+        case QMetaType::QColor:
+            m_type = Color;
+            break;
+        case QMetaType::QPoint:
+        case QMetaType::QPointF:
+            m_type = Point;
+            break;
+        case QMetaType::QSize:
+        case QMetaType::QSizeF:
+            m_type = Size;
+            break;
+        case QMetaType::QRect:
+        case QMetaType::QRectF:
+            m_type = Rect;
+            break;
+        default:
+            m_type = Real;
+            break;
+        }
+        return;
+    }
 
-            case QVariant::SizeF: {
-                QSizeF fromSize = from.toSizeF();
-                QSizeF toSize = to.toSizeF();
+    if (!m_animation) {
+        m_animation.reset(new QVariantAnimation);
+    }
+    m_animation->setStartValue(m_from);
+    m_animation->setEndValue(m_to);
+}
 
-                return QSizeF(
-                    fromSize.width() + (toSize.width() - fromSize.width()) * progress,
-                    fromSize.height() + (toSize.height() - fromSize.height()) * progress
-                );
+void DeclarativeVariantInterpolator::updateValue()
+{
+    bool changed = !m_resolved;
+    m_resolved = true;
+
+    if (m_type == Other) {
+        const QVariant value = interpolate();
+        if (m_value != value) {
+            m_value = value;
+            changed = true;
+        }
+    } else {
+        for (int i = 0; i < m_componentCount; ++i) {
+            const qreal value = m_fromComponents[i] + (m_toComponents[i] - m_fromComponents[i]) * m_progress;
+            if (m_valueComponents[i] != value) {
+                m_valueComponents[i] = value;
+                changed = true;
             }
+        }
+    }
 
-            case QVariant::RectF: {
-                QRectF fromRect = from.toRectF();
-                QRectF toRect = to.toRectF();
+    if (changed) {
+        emit valueChanged();
+    }
+}
 
-                return QRectF(
-                    fromRect.x() + (toRect.x() - fromRect.x()) * progress,
-                    fromRect.y() + (toRect.y() - fromRect.y()) * progress,
-                    fromRect.width() + (toRect.width() - fromRect.width()) * progress,
-                    fromRect.height() + (toRect.height() - fromRect.height()) * progress
-                );
-            }
+QVariant DeclarativeVariantInterpolator::interpolate()
+{
+    if (!m_from.isValid() || !m_to.isValid()) {
+        return m_to;
+    }
 
-            default:
-                break;
-        }
+    m_animation->setCurrentTime(m_progress * m_animation->totalDuration());
+    const QVariant interpolated = m_animation->currentValue();
+    if (interpolated.isValid()) {
+        return interpolated;
     }
 
     // Default fallback: choose 'to' when progress >= 0.5
-    return progress >= 0.5 ? to : from;
+    return m_progress >= 0.5 ? m_to : m_from;
 }
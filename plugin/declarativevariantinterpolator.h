@@ -9,7 +9,16 @@
 #include <QPointF>
 #include <QSizeF>
 #include <QRectF>
+#include <QScopedPointer>
 
+class QVariantAnimation;
+
+// Interpolates between from and to by progress. The value type is resolved
+// when from or to change, and reals, colors, points, sizes and rects are then
+// interpolated component-wise without allocating, as progress is typically
+// bound to a gesture or animation and changes every frame. Other types go
+// through a QVariantAnimation, created once and reused. Integer ends yield a
+// real value, and points, sizes and rects their floating point counterparts.
 class DeclarativeVariantInterpolator : public QObject
 {
     Q_OBJECT
@@ -20,6 +29,7 @@ class DeclarativeVariantInterpolator : public QObject
 
 public:
     explicit DeclarativeVariantInterpolator(QObject *parent = nullptr);
+    ~DeclarativeVariantInterpolator();
 
     QVariant from() const { return m_from; }
     void setFrom(const QVariant &from);
@@ -27,7 +37,7 @@ public:
     void setTo(const QVariant &to);
     qreal progress() const { return m_progress; }
     void setProgress(qreal progress);
-    QVariant value() const { return m_value; }
+    QVariant value() const;
 
 Q_SIGNALS:
     void fromChanged();
@@ -36,13 +46,25 @@ Q_SIGNALS:
     void valueChanged();
 
 private:
+    enum ValueType { Other, Real, Color, Point, Size, Rect };
+
+    void resolveType();
     void updateValue();
-    QVariant interpolate(const QVariant &from, const QVariant &to, qreal progress);
+    QVariant interpolate();
 
     QVariant m_from;
     QVariant m_to;
     qreal m_progress = 0.0;
+    ValueType m_type = Other;
+    bool m_resolved = false;
+    // Components of typed values, e.g. x, y, width and height of a rect.
+    int m_componentCount = 0;
+    qreal m_fromComponents[4] = {};
+    qreal m_toComponents[4] = {};
+    qreal m_valueComponents[4] = {};
+    // Value of other types.
     QVariant m_value;
+    QScopedPointer<QVariantAnimation> m_animation;
 };
 
 #endif // SAILFISH_SILICA_PLUGIN_DECLARATIVEVARIANTINTERPOLATOR_H
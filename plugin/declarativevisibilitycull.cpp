@@ -3,25 +3,32 @@
 #include "declarativevisibilitycull.h"
 #include <QQuickWindow>
 #include <QQuickItem>
+#include <QSet>
+#include <private/qquickflickable_p.h>
+#include <private/qquickitem_p.h>
+
+#include <algorithm>
 
 DeclarativeVisibilityCull::DeclarativeVisibilityCull(QQuickItem *parent)
     : QQuickItem(parent)
 {
-    connect(&m_syncTimer, &QTimer::timeout, this, &DeclarativeVisibilityCull::sync);
-    m_syncTimer.setSingleShot(true);
-    m_syncTimer.setInterval(16); // ~60fps
+}
+
+DeclarativeVisibilityCull::~DeclarativeVisibilityCull()
+{
+    restoreCulledItems();
 }
 
 void DeclarativeVisibilityCull::setTarget(QQuickItem *target)
 {
     if (m_target != target) {
-        restoreHiddenItems();
+        restoreCulledItems();
+        disconnectTarget();
         m_target = target;
+        connectTarget();
         emit targetChanged();
 
-        if (m_enabled && m_target) {
-            updateVisibility();
-        }
+        invalidate();
     }
 }
 
@@ -32,84 +39,265 @@ void DeclarativeVisibilityCull::setEnabled(bool enabled)
         emit enabledChanged();
 
         if (!m_enabled) {
-            restoreHiddenItems();
-        } else if (m_target) {
-            updateVisibility();
+            restoreCulledItems();
         }
+        invalidate();
     }
 }
 
 void DeclarativeVisibilityCull::itemChange(ItemChange change, const ItemChangeData &value)
 {
-    if (change == ItemSceneChange && m_enabled && m_target) {
-        updateVisibility();
+    if (change == ItemSceneChange) {
+        invalidate();
     }
 
     QQuickItem::itemChange(change, value);
 }
 
-void DeclarativeVisibilityCull::sync()
+QQuickItem *DeclarativeVisibilityCull::container() const
 {
-    if (m_enabled && m_target) {
-        updateVisibility();
+    if (QQuickFlickable *flickable = qobject_cast<QQuickFlickable *>(m_target)) {
+        return flickable->contentItem();
+    }
+    return m_target;
+}
+
+void DeclarativeVisibilityCull::connectTarget()
+{
+    if (!m_target) {
+        return;
+    }
+
+    if (QQuickFlickable *flickable = qobject_cast<QQuickFlickable *>(m_target)) {
+        connect(flickable, &QQuickFlickable::contentXChanged, this, &DeclarativeVisibilityCull::scroll);
+        connect(flickable, &QQuickFlickable::contentYChanged, this, &DeclarativeVisibilityCull::scroll);
+        connect(flickable, &QQuickFlickable::contentWidthChanged, this, &DeclarativeVisibilityCull::invalidate);
+        connect(flickable, &QQuickFlickable::contentHeightChanged, this, &DeclarativeVisibilityCull::invalidate);
+    }
+    connect(m_target, &QQuickItem::widthChanged, this, &DeclarativeVisibilityCull::invalidate);
+    connect(m_target, &QQuickItem::heightChanged, this, &DeclarativeVisibilityCull::invalidate);
+    connect(container(), &QQuickItem::childrenChanged, this, &DeclarativeVisibilityCull::invalidate);
+    connectAncestors();
+}
+
+void DeclarativeVisibilityCull::disconnectTarget()
+{
+    disconnectAncestors();
+    if (m_target) {
+        disconnect(m_target, nullptr, this, nullptr);
+        disconnect(container(), nullptr, this, nullptr);
+    }
+
+    for (const Extent &extent : m_byStart) {
+        if (extent.item) {
+            disconnect(extent.item, nullptr, this, nullptr);
+        }
     }
+    m_byStart.clear();
+    m_byEnd.clear();
+    m_valid = false;
 }
 
-void DeclarativeVisibilityCull::updateVisibility()
+void DeclarativeVisibilityCull::connectAncestors()
 {
-    if (!m_target || !m_enabled) {
+    if (!m_target || container() != m_target) {
         return;
     }
 
-    // Schedule sync for next frame
-    if (!m_syncTimer.isActive()) {
-        m_syncTimer.start();
+    // Moving any ancestor, including the content item of an enclosing
+    // Flickable, moves the window relative to the children.
+    for (QQuickItem *item = m_target; item; item = item->parentItem()) {
+        connect(item, &QQuickItem::xChanged, this, &DeclarativeVisibilityCull::scroll);
+        connect(item, &QQuickItem::yChanged, this, &DeclarativeVisibilityCull::scroll);
+        connect(item, &QQuickItem::parentChanged, this, &DeclarativeVisibilityCull::ancestorsChanged);
+        m_ancestors.append(item);
     }
+}
+
+void DeclarativeVisibilityCull::disconnectAncestors()
+{
+    for (const QPointer<QQuickItem> &item : m_ancestors) {
+        if (item) {
+            disconnect(item, &QQuickItem::xChanged, this, &DeclarativeVisibilityCull::scroll);
+            disconnect(item, &QQuickItem::yChanged, this, &DeclarativeVisibilityCull::scroll);
+            disconnect(item, &QQuickItem::parentChanged, this, &DeclarativeVisibilityCull::ancestorsChanged);
+        }
+    }
+    m_ancestors.clear();
+}
+
+void DeclarativeVisibilityCull::ancestorsChanged()
+{
+    disconnectAncestors();
+    connectAncestors();
+    invalidate();
+}
+
+void DeclarativeVisibilityCull::invalidate()
+{
+    m_valid = false;
+    if (m_enabled && m_target) {
+        polish();
+    }
+}
+
+void DeclarativeVisibilityCull::updatePolish()
+{
+    if (m_enabled && m_target && !m_valid) {
+        rebuild();
+    }
+}
+
+// The start and end along the scrolling axis of the area children are shown
+// in, in the container's coordinates.
+void DeclarativeVisibilityCull::viewport(qreal *start, qreal *end) const
+{
+    QQuickItem *content = container();
 
-    // Get the visible rect of the viewport
-    QRectF viewportRect;
-    if (QQuickWindow *window = m_target->window()) {
-        viewportRect = QRectF(0, 0, window->width(), window->height());
+    QRectF rect;
+    if (content != m_target) {
+        rect = content->mapRectFromItem(m_target, m_target->boundingRect());
+    } else if (QQuickWindow *window = m_target->window()) {
+        rect = m_target->mapRectFromScene(QRectF(0, 0, window->width(), window->height()));
     } else {
-        viewportRect = m_target->boundingRect();
+        rect = m_target->boundingRect();
+    }
+
+    *start = m_vertical ? rect.top() : rect.left();
+    *end = m_vertical ? rect.bottom() : rect.right();
+}
+
+void DeclarativeVisibilityCull::rebuild()
+{
+    m_valid = true;
+
+    QQuickFlickable *flickable = qobject_cast<QQuickFlickable *>(m_target);
+    m_vertical = !flickable
+            || !(flickable->contentWidth() > flickable->width()
+                 && flickable->contentHeight() <= flickable->height());
+
+    QQuickItem *content = container();
+    const QList<QQuickItem *> children = content->childItems();
+
+    QSet<QQuickItem *> childSet;
+    for (QQuickItem *child : children) {
+        childSet.insert(child);
     }
 
-    // Check each child of the target
-    QList<QQuickItem*> children = m_target->childItems();
-    QSet<QQuickItem*> currentlyHidden;
+    for (const Extent &extent : m_byStart) {
+        if (extent.item && !childSet.contains(extent.item)) {
+            disconnect(extent.item, nullptr, this, nullptr);
+        }
+    }
+    m_byStart.clear();
 
     for (QQuickItem *child : children) {
-        if (!child || !child->isVisible()) {
+        if (child == this) {
             continue;
         }
 
-        // Map child's bounding rect to viewport coordinates
-        QRectF childRect = child->mapRectToScene(child->boundingRect());
+        connect(child, &QQuickItem::xChanged, this, &DeclarativeVisibilityCull::invalidate, Qt::UniqueConnection);
+        connect(child, &QQuickItem::yChanged, this, &DeclarativeVisibilityCull::invalidate, Qt::UniqueConnection);
+        connect(child, &QQuickItem::widthChanged, this, &DeclarativeVisibilityCull::invalidate, Qt::UniqueConnection);
+        connect(child, &QQuickItem::heightChanged, this, &DeclarativeVisibilityCull::invalidate, Qt::UniqueConnection);
 
-        // Check if child intersects with viewport
-        if (!viewportRect.intersects(childRect)) {
-            // Hide the child
-            child->setVisible(false);
-            currentlyHidden.insert(child);
-        } else {
-            // Show the child if it was previously hidden by us
-            if (m_hiddenItems.contains(child)) {
-                child->setVisible(true);
+        const QRectF rect = child->mapRectToItem(content, child->boundingRect());
+        Extent extent;
+        extent.item = child;
+        extent.start = m_vertical ? rect.top() : rect.left();
+        extent.end = m_vertical ? rect.bottom() : rect.right();
+        m_byStart.append(extent);
+    }
+
+    m_byEnd = m_byStart;
+    std::sort(m_byStart.begin(), m_byStart.end(), [](const Extent &left, const Extent &right) {
+        return left.start < right.start;
+    });
+    std::sort(m_byEnd.begin(), m_byEnd.end(), [](const Extent &left, const Extent &right) {
+        return left.end < right.end;
+    });
+
+    viewport(&m_viewportStart, &m_viewportEnd);
+    for (const Extent &extent : m_byStart) {
+        updateExtent(extent);
+    }
+
+    // Items which left the container are shown again.
+    for (auto it = m_culledItems.begin(); it != m_culledItems.end();) {
+        if (!childSet.contains(it.key())) {
+            if (it.value()) {
+                QQuickItemPrivate::get(it.value())->setCulled(false);
             }
+            it = m_culledItems.erase(it);
+        } else {
+            ++it;
         }
     }
+}
+
+void DeclarativeVisibilityCull::scroll()
+{
+    if (!m_enabled || !m_valid) {
+        // A full update is already pending.
+        return;
+    }
+
+    const qreal previousStart = m_viewportStart;
+    const qreal previousEnd = m_viewportEnd;
+    viewport(&m_viewportStart, &m_viewportEnd);
+
+    // An item only changes from outside to inside of the viewport, or back,
+    // if its start is between the old and new end of the viewport or its end
+    // is between the old and new start.
+    auto first = std::lower_bound(m_byStart.constBegin(), m_byStart.constEnd(),
+                                  qMin(previousEnd, m_viewportEnd),
+                                  [](const Extent &extent, qreal position) { return extent.start < position; });
+    auto last = std::upper_bound(first, m_byStart.constEnd(),
+                                 qMax(previousEnd, m_viewportEnd),
+                                 [](qreal position, const Extent &extent) { return position < extent.start; });
+    for (auto it = first; it != last; ++it) {
+        updateExtent(*it);
+    }
+
+    first = std::lower_bound(m_byEnd.constBegin(), m_byEnd.constEnd(),
+                             qMin(previousStart, m_viewportStart),
+                             [](const Extent &extent, qreal position) { return extent.end < position; });
+    last = std::upper_bound(first, m_byEnd.constEnd(),
+                            qMax(previousStart, m_viewportStart),
+                            [](qreal position, const Extent &extent) { return position < extent.end; });
+    for (auto it = first; it != last; ++it) {
+        updateExtent(*it);
+    }
+}
+
+void DeclarativeVisibilityCull::updateExtent(const Extent &extent)
+{
+    if (extent.item) {
+        setItemCulled(extent.item, extent.start >= m_viewportEnd || extent.end <= m_viewportStart);
+    }
+}
+
+void DeclarativeVisibilityCull::setItemCulled(QQuickItem *item, bool culled)
+{
+    if (culled == m_culledItems.contains(item)) {
+        return;
+    }
 
-    // Update our hidden items set
-    m_hiddenItems = currentlyHidden;
+    QQuickItemPrivate::get(item)->setCulled(culled);
+    if (culled) {
+        m_culledItems.insert(item, item);
+    } else {
+        m_culledItems.remove(item);
+    }
 }
 
-void DeclarativeVisibilityCull::restoreHiddenItems()
+void DeclarativeVisibilityCull::restoreCulledItems()
 {
-    // Restore all items that we hid
-    for (QQuickItem *item : m_hiddenItems) {
+    // Restore all items that we culled
+    for (const QPointer<QQuickItem> &item : m_culledItems) {
         if (item) {
-            item->setVisible(true);
+            QQuickItemPrivate::get(item)->setCulled(false);
         }
     }
-    m_hiddenItems.clear();
+    m_culledItems.clear();
 }
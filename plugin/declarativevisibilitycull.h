@@ -3,10 +3,21 @@
 #ifndef SAILFISH_SILICA_PLUGIN_DECLARATIVEVISIBILITYCULL_H
 #define SAILFISH_SILICA_PLUGIN_DECLARATIVEVISIBILITYCULL_H
 
+#include <QHash>
+#include <QPointer>
 #include <QQuickItem>
-#include <QSet>
-#include <QTimer>
+#include <QVector>
 
+// Culls the children of a Flickable's content item while they are outside of
+// the Flickable along its scrolling axis. For other targets the children of
+// the target are culled while outside of the window, and are tested again
+// whenever the target or any of its ancestors moves, e.g. when an enclosing
+// Flickable scrolls.
+//
+// The children are kept sorted by where they start and end along the axis,
+// so scrolling only tests the items whose edges the viewport's edges passed.
+// Items are hidden with the scene graph's culled flag rather than their
+// visible property, so bindings and layouts depending on them are unaffected.
 class DeclarativeVisibilityCull : public QQuickItem
 {
     Q_OBJECT
@@ -15,6 +26,7 @@ class DeclarativeVisibilityCull : public QQuickItem
 
 public:
     explicit DeclarativeVisibilityCull(QQuickItem *parent = nullptr);
+    ~DeclarativeVisibilityCull();
 
     QQuickItem* target() const { return m_target; }
     void setTarget(QQuickItem *target);
@@ -27,18 +39,44 @@ Q_SIGNALS:
 
 protected:
     void itemChange(ItemChange change, const ItemChangeData &value) override;
+    void updatePolish() override;
 
 private Q_SLOTS:
-    void sync();
+    void invalidate();
+    void scroll();
 
 private:
-    void updateVisibility();
-    void restoreHiddenItems();
+    struct Extent {
+        QPointer<QQuickItem> item;
+        qreal start;
+        qreal end;
+    };
+
+    QQuickItem *container() const;
+    void viewport(qreal *start, qreal *end) const;
+    void connectTarget();
+    void disconnectTarget();
+    void connectAncestors();
+    void disconnectAncestors();
+    void ancestorsChanged();
+    void rebuild();
+    void updateExtent(const Extent &extent);
+    void setItemCulled(QQuickItem *item, bool culled);
+    void restoreCulledItems();
 
     QQuickItem *m_target = nullptr;
     bool m_enabled = false;
-    QSet<QQuickItem*> m_hiddenItems;
-    QTimer m_syncTimer;
+    bool m_vertical = true;
+    bool m_valid = false;
+    qreal m_viewportStart = 0;
+    qreal m_viewportEnd = 0;
+    // The children of the container, sorted by start and by end.
+    QVector<Extent> m_byStart;
+    QVector<Extent> m_byEnd;
+    QHash<QQuickItem *, QPointer<QQuickItem>> m_culledItems;
+    // The target and its ancestors, whose movement moves the window relative
+    // to the children of a target other than a Flickable.
+    QVector<QPointer<QQuickItem>> m_ancestors;
 };
 
 #endif // SAILFISH_SILICA_PLUGIN_DECLARATIVEVISIBILITYCULL_H
@@ -4,6 +4,7 @@
 #include <QMouseEvent>
 #include <QTouchEvent>
 #include <QVector2D>
+#include <QtMath>
 
 DrawingArea::DrawingArea(QQuickItem *parent)
     : LineItem(parent)
@@ -43,9 +44,7 @@ void DrawingArea::clear()
     m_drawing = false;
 
     // Clear all line series
-    for (int i = 0; i < m_strokes.size(); ++i) {
-        setPoints(i, QVector<QVector2D>());
-    }
+    clearSeries();
 }
 
 void DrawingArea::mousePressEvent(QMouseEvent *event)
@@ -108,6 +107,7 @@ void DrawingArea::handlePress(const QPointF &pos)
     m_currentStroke.clear();
     m_lastPoint = pos;
     m_drawing = true;
+    setPoints(m_strokes.count(), QVector<QVector2D>());
 
     // Emit arc started signal
     emit arcStarted(pos.x(), pos.y());
@@ -125,6 +125,9 @@ void DrawingArea::handleMove(const QPointF &pos)
         m_currentStroke.append(pos);
         m_lastPoint = pos;
 
+        // Only the new tail of the stroke is tessellated.
+        appendPoints(m_strokes.count(), QVector<QVector2D>() << QVector2D(pos));
+
         // Emit arc point added signal
         emit arcPointAdded(pos.x(), pos.y());
     }
@@ -144,6 +147,7 @@ void DrawingArea::handleRelease()
         emit arcFinished();
     } else {
         // Too few points, cancel the stroke
+        removeSeries(m_strokes.count());
         emit arcCanceled();
     }
 
@@ -165,22 +169,76 @@ bool DrawingArea::isPointInMask(const QPointF &pos) const
 
 void DrawingArea::addStroke(const QVector<QPointF> &points)
 {
+    const QVector<QPointF> simplified = simplify(points);
+
     // Convert QPointF to QVector2D
     QVector<QVector2D> linePoints;
-    linePoints.reserve(points.size());
+    linePoints.reserve(simplified.size());
 
-    for (const QPointF &point : points) {
+    for (const QPointF &point : simplified) {
         linePoints.append(QVector2D(point));
     }
 
-    // Add the stroke to our collection
-    m_strokes.append(points);
+    // Replace the stroke in progress with the simplified one.
+    setPoints(m_strokes.count(), linePoints);
+    m_strokes.append(simplified);
 
     // Remove oldest strokes if we exceed maximum count
-    while (m_strokes.size() > m_maximumStrokeCount) {
+    while (m_strokes.size() > qMax(0, m_maximumStrokeCount)) {
         m_strokes.removeFirst();
+        removeSeries(0);
+    }
+}
+
+// Ramer-Douglas-Peucker: keeps the point furthest from the line between the
+// ends of a range if it is further than the tolerance and repeats for the two
+// halves, using a stack rather than recursion for long strokes.
+QVector<QPointF> DrawingArea::simplify(const QVector<QPointF> &points) const
+{
+    if (points.size() < 3) {
+        return points;
     }
 
-    // Update the line series
-    setPoints(0, linePoints);
+    // Deviations under a quarter of the line width do not show.
+    const qreal tolerance = qMax<qreal>(0.5, lineWidth() / 4);
+
+    QVector<bool> keep(points.size(), false);
+    keep.first() = true;
+    keep.last() = true;
+
+    QVector<QPair<int, int>> ranges;
+    ranges.append(qMakePair(0, points.size() - 1));
+    while (!ranges.isEmpty()) {
+        const QPair<int, int> range = ranges.takeLast();
+        const QPointF &start = points.at(range.first);
+        const QPointF line = points.at(range.second) - start;
+        const qreal length = qSqrt(QPointF::dotProduct(line, line));
+
+        qreal furthest = 0;
+        int index = -1;
+        for (int i = range.first + 1; i < range.second; ++i) {
+            const QPointF offset = points.at(i) - start;
+            const qreal distance = length > 0
+                    ? qAbs(line.x() * offset.y() - line.y() * offset.x()) / length
+                    : qSqrt(QPointF::dotProduct(offset, offset));
+            if (distance > furthest) {
+                furthest = distance;
+                index = i;
+            }
+        }
+
+        if (index >= 0 && furthest > tolerance) {
+            keep[index] = true;
+            ranges.append(qMakePair(range.first, index));
+            ranges.append(qMakePair(index, range.second));
+        }
+    }
+
+    QVector<QPointF> simplified;
+    for (int i = 0; i < points.size(); ++i) {
+        if (keep.at(i)) {
+            simplified.append(points.at(i));
+        }
+    }
+    return simplified;
 }
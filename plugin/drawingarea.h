@@ -47,10 +47,13 @@ private:
     void handleRelease();
     bool isPointInMask(const QPointF &pos) const;
     void addStroke(const QVector<QPointF> &points);
+    QVector<QPointF> simplify(const QVector<QPointF> &points) const;
 
     qreal m_threshold = 5.0;
     QQuickItem *m_mask = nullptr;
     int m_maximumStrokeCount = 10;
+    // Completed strokes, each drawn as the series of the same index. The stroke
+    // in progress is drawn as the series after them.
     QVector<QVector<QPointF>> m_strokes;
     QVector<QPointF> m_currentStroke;
     QPointF m_lastPoint;
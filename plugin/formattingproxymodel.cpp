@@ -3,7 +3,9 @@
 #include "formattingproxymodel.h"
 #include "declarativeformatter.h"
 #include <QAbstractItemModel>
+#include <QDateTime>
 #include <QHash>
+#include <QQmlInfo>
 
 FormattingProxyModel::FormattingProxyModel(QObject *parent)
     : QIdentityProxyModel(parent)
@@ -14,18 +16,48 @@ FormattingProxyModel::FormattingProxyModel(QObject *parent)
 void FormattingProxyModel::setFormattedProperties(const QVariantList &properties)
 {
     if (m_formattedProperties != properties) {
+        beginResetModel();
         m_formattedProperties = properties;
-        buildLookup();
+        buildLookup(sourceModel());
+        endResetModel();
         emit formattedPropertiesChanged();
     }
 }
 
+void FormattingProxyModel::setSourceModel(QAbstractItemModel *model)
+{
+    if (sourceModel()) {
+        disconnect(sourceModel(), nullptr, this, nullptr);
+    }
+
+    // Connected before the base class forwards the signals, so the cache
+    // matches the source by the time views ask for data.
+    if (model) {
+        connect(model, &QAbstractItemModel::dataChanged, this, &FormattingProxyModel::sourceDataChanged);
+        connect(model, &QAbstractItemModel::rowsInserted, this, &FormattingProxyModel::sourceRowsInserted);
+        connect(model, &QAbstractItemModel::rowsRemoved, this, &FormattingProxyModel::sourceRowsRemoved);
+        connect(model, &QAbstractItemModel::rowsMoved, this, &FormattingProxyModel::clearCache);
+        connect(model, &QAbstractItemModel::layoutChanged, this, &FormattingProxyModel::clearCache);
+        connect(model, &QAbstractItemModel::modelReset, this, &FormattingProxyModel::clearCache);
+        connect(model, &QObject::destroyed, this, &FormattingProxyModel::clearCache);
+    }
+
+    // The base class resets the model, build the lookup for the new source
+    // before it does.
+    buildLookup(model);
+    QIdentityProxyModel::setSourceModel(model);
+}
+
 QHash<int, QByteArray> FormattingProxyModel::roleNames() const
 {
+    QHash<int, QByteArray> roles;
     if (sourceModel()) {
-        return sourceModel()->roleNames();
+        roles = sourceModel()->roleNames();
+        for (auto it = m_propertyRoles.constBegin(); it != m_propertyRoles.constEnd(); ++it) {
+            roles.insert(it.key(), it.value());
+        }
     }
-    return QHash<int, QByteArray>();
+    return roles;
 }
 
 QVariant FormattingProxyModel::data(const QModelIndex &index, int role) const
@@ -34,44 +66,200 @@ QVariant FormattingProxyModel::data(const QModelIndex &index, int role) const
         return QVariant();
     }
 
-    // Check if this role should be formatted
-    if (m_roleLookup.contains(role)) {
-        QVariant sourceData = sourceModel()->data(mapToSource(index), role);
+    const int formatIndex = m_roleLookup.value(role, -1);
+    if (formatIndex < 0) {
+        return sourceModel()->data(mapToSource(index), role);
+    }
+
+    // Only the first column of top level rows is cached.
+    if (index.parent().isValid() || index.column() != 0) {
+        return format(index, m_formats.at(formatIndex));
+    }
+
+    QVector<QVariant> &row = cachedRow(index.row());
+    if (!row.at(formatIndex).isValid()) {
+        row[formatIndex] = format(index, m_formats.at(formatIndex));
+    }
+    return row.at(formatIndex);
+}
+
+void FormattingProxyModel::prefetch(int first, int last)
+{
+    if (!sourceModel() || m_formats.isEmpty()) {
+        return;
+    }
+
+    first = qMax(0, first);
+    last = qMin(last, rowCount() - 1);
+    for (int i = first; i <= last; ++i) {
+        QVector<QVariant> &row = cachedRow(i);
+        const QModelIndex index = this->index(i, 0);
+        for (int j = 0; j < m_formats.count(); ++j) {
+            if (!row.at(j).isValid()) {
+                row[j] = format(index, m_formats.at(j));
+            }
+        }
+    }
+}
+
+QString FormattingProxyModel::format(const QModelIndex &index, const Format &format) const
+{
+    const QVariant value = sourceModel()->data(mapToSource(index), format.sourceRole);
+
+    switch (format.formatter) {
+    case Format::Date:
+        return m_formatter->formatDate(value.toDateTime(), DeclarativeFormatter::FormatType(format.formatType));
+    case Format::Duration:
+        return m_formatter->formatDuration(value.toInt(), DeclarativeFormatter::DurationType(format.formatType));
+    case Format::FileSize:
+        return m_formatter->formatFileSize(value.toLongLong(), format.parameter);
+    case Format::Text:
+        return m_formatter->formatText(value.toString(), DeclarativeFormatter::TextFormatType(format.formatType));
+    case Format::Auto:
+        break;
+    }
+
+    switch (value.type()) {
+    case QVariant::Date:
+    case QVariant::DateTime:
+        return m_formatter->formatDate(value.toDateTime(), DeclarativeFormatter::DateFull);
+    default:
+        return value.toString();
+    }
+}
 
-        // Format the data using DeclarativeFormatter
-        // For now, just return the source data as a formatted string
-        // TODO: Implement proper formatting based on the role type
-        return sourceData.toString();
+QVector<QVariant> &FormattingProxyModel::cachedRow(int row) const
+{
+    if (row >= m_cache.count()) {
+        m_cache.resize(qMax(row + 1, sourceModel()->rowCount()));
     }
 
-    // Return source data unchanged
-    return sourceModel()->data(mapToSource(index), role);
+    QVector<QVariant> &values = m_cache[row];
+    if (values.count() != m_formats.count()) {
+        values.resize(m_formats.count());
+    }
+    return values;
 }
 
-void FormattingProxyModel::buildLookup()
+void FormattingProxyModel::sourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight,
+                                             const QVector<int> &roles)
 {
+    if (m_formats.isEmpty()) {
+        return;
+    }
+
+    QVector<int> formatIndexes;
+    QVector<int> propertyRoles;
+    for (int i = 0; i < m_formats.count(); ++i) {
+        if (roles.isEmpty() || roles.contains(m_formats.at(i).sourceRole)) {
+            formatIndexes.append(i);
+        }
+    }
+    if (!roles.isEmpty()) {
+        for (auto it = m_roleLookup.constBegin(); it != m_roleLookup.constEnd(); ++it) {
+            if (m_propertyRoles.contains(it.key()) && formatIndexes.contains(it.value())) {
+                propertyRoles.append(it.key());
+            }
+        }
+    }
+
+    const int last = topLeft.parent().isValid() ? -1 : qMin(bottomRight.row(), m_cache.count() - 1);
+    for (int i = topLeft.row(); i <= last; ++i) {
+        QVector<QVariant> &row = m_cache[i];
+        for (int formatIndex : formatIndexes) {
+            if (formatIndex < row.count()) {
+                row[formatIndex] = QVariant();
+            }
+        }
+    }
+
+    // The source only reports its own roles, the formatted properties
+    // derived from them change too.
+    if (!propertyRoles.isEmpty()) {
+        emit dataChanged(mapFromSource(topLeft), mapFromSource(bottomRight), propertyRoles);
+    }
+}
+
+void FormattingProxyModel::sourceRowsInserted(const QModelIndex &parent, int first, int last)
+{
+    if (!parent.isValid() && first < m_cache.count()) {
+        m_cache.insert(first, last - first + 1, QVector<QVariant>());
+    }
+}
+
+void FormattingProxyModel::sourceRowsRemoved(const QModelIndex &parent, int first, int last)
+{
+    if (!parent.isValid() && first < m_cache.count()) {
+        m_cache.remove(first, qMin(last, m_cache.count() - 1) - first + 1);
+    }
+}
+
+void FormattingProxyModel::clearCache()
+{
+    m_cache.clear();
+}
+
+void FormattingProxyModel::buildLookup(QAbstractItemModel *model)
+{
+    m_formats.clear();
     m_roleLookup.clear();
+    m_propertyRoles.clear();
+    m_cache.clear();
 
-    if (!sourceModel()) {
+    if (!model) {
         return;
     }
 
-    QHash<int, QByteArray> roles = sourceModel()->roleNames();
+    const QHash<int, QByteArray> roles = model->roleNames();
+    int nextRole = Qt::UserRole;
+    for (auto it = roles.constBegin(); it != roles.constEnd(); ++it) {
+        nextRole = qMax(nextRole, it.key() + 1);
+    }
 
     for (const QVariant &property : m_formattedProperties) {
-        if (property.type() == QVariant::String) {
-            // Look up role by name
-            QString roleName = property.toString();
-            for (auto it = roles.begin(); it != roles.end(); ++it) {
-                if (it.value() == roleName.toUtf8()) {
-                    m_roleLookup[it.key()] = 0; // Format type 0 for now
-                    break;
-                }
+        Format format;
+        QVariant role = property;
+        QByteArray propertyName;
+
+        if (property.type() == QVariant::Map) {
+            const QVariantMap map = property.toMap();
+            const QString formatter = map.value(QStringLiteral("formatter")).toString();
+            role = map.value(QStringLiteral("role"));
+            propertyName = map.value(QStringLiteral("property")).toString().toUtf8();
+            format.formatType = map.value(QStringLiteral("formatType")).toInt();
+            format.parameter = map.value(QStringLiteral("parameter"), format.parameter).toInt();
+
+            if (formatter == QLatin1String("formatDate")) {
+                format.formatter = Format::Date;
+            } else if (formatter == QLatin1String("formatDuration")) {
+                format.formatter = Format::Duration;
+            } else if (formatter == QLatin1String("formatFileSize")) {
+                format.formatter = Format::FileSize;
+            } else if (formatter == QLatin1String("formatText")) {
+                format.formatter = Format::Text;
+            } else if (!formatter.isEmpty()) {
+                qmlInfo(this) << "Unknown formatter " << formatter;
             }
-        } else if (property.type() == QVariant::Int) {
+        }
+
+        if (role.type() == QVariant::String) {
+            // Look up role by name
+            format.sourceRole = roles.key(role.toString().toUtf8(), -1);
+        } else if (role.canConvert<int>()) {
             // Direct role ID
-            int roleId = property.toInt();
-            m_roleLookup[roleId] = 0; // Format type 0 for now
+            format.sourceRole = role.toInt();
+        }
+        if (format.sourceRole < 0) {
+            qmlInfo(this) << "Unknown role " << role.toString();
+            continue;
+        }
+
+        int proxyRole = format.sourceRole;
+        if (!propertyName.isEmpty()) {
+            proxyRole = nextRole++;
+            m_propertyRoles.insert(proxyRole, propertyName);
         }
+        m_roleLookup.insert(proxyRole, m_formats.count());
+        m_formats.append(format);
     }
 }
@@ -5,10 +5,23 @@
 
 #include <QIdentityProxyModel>
 #include <QVariantList>
+#include <QVector>
 #include <QHash>
 
 class DeclarativeFormatter;
 
+// Formats roles of the source model with DeclarativeFormatter.
+//
+// Each formatted property is a role name or number, formatted by the type of
+// its value, or an object such as
+//   { "role": "modified", "property": "modifiedText",
+//     "formatter": "formatDate", "formatType": Formatter.TimepointRelative }
+// where the optional property names a new role for the formatted value and
+// leaves the source role as it is. The parameter key sets the precision of
+// formatFileSize.
+//
+// Formatted values of top level rows are cached until the source reports the
+// row or role changed, so rows scrolled back into view aren't formatted again.
 class FormattingProxyModel : public QIdentityProxyModel
 {
     Q_OBJECT
@@ -21,17 +34,43 @@ public:
     QVariantList formattedProperties() const { return m_formattedProperties; }
     void setFormattedProperties(const QVariantList &properties);
 
+    void setSourceModel(QAbstractItemModel *sourceModel) override;
+
     QHash<int, QByteArray> roleNames() const override;
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
 
+    // Formats the rows from first to last ahead of use, e.g. the rows a
+    // ListView is about to create delegates for.
+    Q_INVOKABLE void prefetch(int first, int last);
+
 Q_SIGNALS:
     void formattedPropertiesChanged();
 
 private:
-    void buildLookup();
+    struct Format {
+        enum Formatter { Auto, Date, Duration, FileSize, Text };
+
+        int sourceRole = -1;
+        Formatter formatter = Auto;
+        int formatType = 0;
+        int parameter = 1;
+    };
+
+    void buildLookup(QAbstractItemModel *model);
+    QString format(const QModelIndex &index, const Format &format) const;
+    QVector<QVariant> &cachedRow(int row) const;
+
+    void sourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles);
+    void sourceRowsInserted(const QModelIndex &parent, int first, int last);
+    void sourceRowsRemoved(const QModelIndex &parent, int first, int last);
+    void clearCache();
 
     QVariantList m_formattedProperties;
-    QHash<int, int> m_roleLookup; // Maps role to formatting function
+    QVector<Format> m_formats;
+    QHash<int, int> m_roleLookup; // Maps role to its index in m_formats
+    QHash<int, QByteArray> m_propertyRoles;
+    // Formatted values of top level rows, by row and index in m_formats.
+    mutable QVector<QVector<QVariant>> m_cache;
     DeclarativeFormatter *m_formatter = nullptr;
 };
 
@@ -3,87 +3,242 @@
 #include "linegraph.h"
 #include <QVariant>
 #include <QVector2D>
+#include <QtMath>
+
+namespace {
+
+const int DefaultCapacity = 1024;
+// Padding from the edges of the item.
+const qreal Padding = 10.0;
+
+}
 
 LineGraph::LineGraph(QQuickItem *parent)
     : LineItem(parent)
+    , m_buffer(DefaultCapacity)
 {
 }
 
-void LineGraph::setValues(const QVariantList &values)
+QVariantList LineGraph::values() const
 {
-    if (m_values != values) {
-        m_values = values;
-        updateGraph();
-        emit valuesChanged();
+    QVariantList values;
+    values.reserve(m_count);
+    for (qint64 sequence = m_appended - m_count; sequence < m_appended; ++sequence) {
+        values.append(valueAt(sequence));
     }
+    return values;
 }
 
-void LineGraph::geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry)
+void LineGraph::setValues(const QVariantList &values)
 {
-    LineItem::geometryChanged(newGeometry, oldGeometry);
-    updateGraph();
+    const int oldCount = m_count;
+
+    QVector<qreal> numbers;
+    numbers.reserve(values.count());
+    for (const QVariant &value : values) {
+        bool ok;
+        const qreal number = value.toReal(&ok);
+        if (ok) {
+            numbers.append(number);
+        }
+    }
+
+    if (numbers.count() > capacity()) {
+        reset(numbers.count());
+        emit capacityChanged();
+    } else {
+        reset(capacity());
+    }
+    for (qreal number : numbers) {
+        push(number);
+    }
+    valuesUpdated(oldCount);
 }
 
-void LineGraph::updateGraph()
+void LineGraph::setCapacity(int capacity)
 {
-    if (m_values.isEmpty()) {
-        setPoints(0, QVector<QVector2D>());
+    capacity = qMax(1, capacity);
+    if (capacity == this->capacity()) {
         return;
     }
 
-    QVector<QVector2D> normalizedPoints = normalizeValues(m_values);
-    setPoints(0, normalizedPoints);
+    const int oldCount = m_count;
+    QVector<qreal> values;
+    values.reserve(qMin(m_count, capacity));
+    for (qint64 sequence = m_appended - qMin(m_count, capacity); sequence < m_appended; ++sequence) {
+        values.append(valueAt(sequence));
+    }
+    reset(capacity);
+    for (qreal value : values) {
+        push(value);
+    }
+    emit capacityChanged();
+    valuesUpdated(oldCount);
 }
 
-QVector<QVector2D> LineGraph::normalizeValues(const QVariantList &values) const
+void LineGraph::append(qreal value)
 {
-    if (values.isEmpty()) {
-        return QVector<QVector2D>();
+    const int oldCount = m_count;
+    push(value);
+    valuesUpdated(oldCount);
+}
+
+void LineGraph::appendBatch(const QList<qreal> &values)
+{
+    const int oldCount = m_count;
+    for (qreal value : values) {
+        push(value);
     }
+    valuesUpdated(oldCount);
+}
 
-    // Find min and max values
-    qreal minVal = std::numeric_limits<qreal>::max();
-    qreal maxVal = std::numeric_limits<qreal>::lowest();
+void LineGraph::clear()
+{
+    const int oldCount = m_count;
+    reset(capacity());
+    valuesUpdated(oldCount);
+}
 
-    for (const QVariant &value : values) {
-        bool ok;
-        qreal numValue = value.toReal(&ok);
-        if (ok) {
-            minVal = qMin(minVal, numValue);
-            maxVal = qMax(maxVal, numValue);
+void LineGraph::push(qreal value)
+{
+    if (!qIsFinite(value)) {
+        return;
+    }
+
+    if (m_count == capacity()) {
+        // The oldest value is the front of a window if it is an extreme.
+        const qint64 oldest = m_appended - m_count;
+        if (m_minima.front() == oldest) {
+            m_minima.pop_front();
+        }
+        if (m_maxima.front() == oldest) {
+            m_maxima.pop_front();
         }
+        --m_count;
     }
 
-    // Handle flat lines (min == max)
-    if (qFuzzyCompare(minVal, maxVal)) {
-        minVal = 0.0;
-        maxVal = 1.0;
+    const qint64 sequence = m_appended++;
+    m_buffer[sequence % capacity()] = value;
+    ++m_count;
+
+    // Values that can no longer become an extreme before they are dropped.
+    while (!m_minima.empty() && valueAt(m_minima.back()) >= value) {
+        m_minima.pop_back();
+    }
+    m_minima.push_back(sequence);
+    while (!m_maxima.empty() && valueAt(m_maxima.back()) <= value) {
+        m_maxima.pop_back();
     }
+    m_maxima.push_back(sequence);
+}
 
-    // Normalize values to [0,1] range and map to item coordinates
-    QVector<QVector2D> points;
-    points.reserve(values.size());
+void LineGraph::reset(int capacity)
+{
+    if (capacity != m_buffer.count()) {
+        m_buffer = QVector<qreal>(capacity);
+    }
+    m_appended = 0;
+    m_count = 0;
+    m_minima.clear();
+    m_maxima.clear();
+}
 
-    qreal width = boundingRect().width();
-    qreal height = boundingRect().height();
-    qreal padding = 10.0; // Padding from edges
+void LineGraph::valuesUpdated(int oldCount)
+{
+    if (m_count != oldCount) {
+        emit countChanged();
+    }
+    emit valuesChanged();
+    // Many appends within a frame build the graph once.
+    polish();
+}
 
-    for (int i = 0; i < values.size(); ++i) {
-        const QVariant &value = values[i];
-        bool ok;
-        qreal numValue = value.toReal(&ok);
+void LineGraph::geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry)
+{
+    LineItem::geometryChanged(newGeometry, oldGeometry);
+    polish();
+}
 
-        if (ok) {
-            // Normalize to [0,1]
-            qreal normalized = (numValue - minVal) / (maxVal - minVal);
+void LineGraph::updatePolish()
+{
+    LineItem::updatePolish();
+    updateGraph();
+}
+
+QVector2D LineGraph::pointAt(int index, qreal minimum, qreal maximum) const
+{
+    const qreal width = boundingRect().width();
+    const qreal height = boundingRect().height();
+    const qreal normalized = (valueAt(m_appended - m_count + index) - minimum) / (maximum - minimum);
+
+    // Map to item coordinates with padding
+    const qreal x = Padding + (width - 2 * Padding) * (m_count > 1 ? index / qreal(m_count - 1) : 0.0);
+    const qreal y = height - Padding - (height - 2 * Padding) * normalized;
+    return QVector2D(x, y);
+}
 
-            // Map to item coordinates with padding
-            qreal x = padding + (width - 2 * padding) * (i / qreal(values.size() - 1));
-            qreal y = height - padding - (height - 2 * padding) * normalized;
+void LineGraph::updateGraph()
+{
+    m_points.resize(0);
+    if (m_count == 0) {
+        setPoints(0, m_points);
+        return;
+    }
 
-            points.append(QVector2D(x, y));
+    qreal minimum = valueAt(m_minima.front());
+    qreal maximum = valueAt(m_maxima.front());
+    // Handle flat lines (min == max)
+    if (qFuzzyCompare(minimum, maximum)) {
+        minimum = 0.0;
+        maximum = 1.0;
+    }
+
+    // There is no point in more than a point per pixel.
+    const int threshold = qMax(3, qCeil(width() - 2 * Padding));
+    if (m_count <= threshold) {
+        m_points.reserve(m_count);
+        for (int i = 0; i < m_count; ++i) {
+            m_points.append(pointAt(i, minimum, maximum));
+        }
+        setPoints(0, m_points);
+        return;
+    }
+
+    // Largest triangle three buckets: the first and last points are kept and
+    // of the points between, split into threshold - 2 buckets, the one forming
+    // the largest triangle with the previously kept point and the average of
+    // the next bucket.
+    m_points.reserve(threshold);
+    const qreal bucketSize = qreal(m_count - 2) / (threshold - 2);
+
+    QVector2D previous = pointAt(0, minimum, maximum);
+    m_points.append(previous);
+    for (int bucket = 0; bucket < threshold - 2; ++bucket) {
+        const int nextStart = int((bucket + 1) * bucketSize) + 1;
+        const int nextEnd = qMin(int((bucket + 2) * bucketSize) + 1, m_count);
+        QVector2D average;
+        for (int i = nextStart; i < nextEnd; ++i) {
+            average += pointAt(i, minimum, maximum);
+        }
+        average /= nextEnd - nextStart;
+
+        const int start = int(bucket * bucketSize) + 1;
+        const int end = int((bucket + 1) * bucketSize) + 1;
+        float largestArea = -1;
+        QVector2D selected;
+        for (int i = start; i < end; ++i) {
+            const QVector2D point = pointAt(i, minimum, maximum);
+            const float area = qAbs((previous.x() - average.x()) * (point.y() - previous.y())
+                                    - (previous.x() - point.x()) * (average.y() - previous.y()));
+            if (area > largestArea) {
+                largestArea = area;
+                selected = point;
+            }
         }
+        m_points.append(selected);
+        previous = selected;
     }
+    m_points.append(pointAt(m_count - 1, minimum, maximum));
 
-    return points;
+    setPoints(0, m_points);
 }
@@ -7,28 +7,57 @@
 #include <QVariantList>
 #include <QVector2D>
 
+#include <deque>
+
 class LineGraph : public LineItem
 {
     Q_OBJECT
     Q_PROPERTY(QVariantList values READ values WRITE setValues NOTIFY valuesChanged)
+    Q_PROPERTY(int capacity READ capacity WRITE setCapacity NOTIFY capacityChanged)
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
 
 public:
     explicit LineGraph(QQuickItem *parent = nullptr);
 
-    QVariantList values() const { return m_values; }
+    QVariantList values() const;
+    // Replaces the values, raising the capacity if they do not fit.
     void setValues(const QVariantList &values);
+    int capacity() const { return m_buffer.count(); }
+    void setCapacity(int capacity);
+    int count() const { return m_count; }
+
+    // Appending to a full graph drops its oldest values.
+    Q_INVOKABLE void append(qreal value);
+    Q_INVOKABLE void appendBatch(const QList<qreal> &values);
+    Q_INVOKABLE void clear();
 
 Q_SIGNALS:
     void valuesChanged();
+    void capacityChanged();
+    void countChanged();
 
 protected:
     void geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry) override;
+    void updatePolish() override;
 
 private:
+    qreal valueAt(qint64 sequence) const { return m_buffer.at(sequence % m_buffer.count()); }
+    void push(qreal value);
+    void reset(int capacity);
+    void valuesUpdated(int oldCount);
     void updateGraph();
-    QVector<QVector2D> normalizeValues(const QVariantList &values) const;
-
-    QVariantList m_values;
+    QVector2D pointAt(int index, qreal minimum, qreal maximum) const;
+
+    // Ring buffer of the last m_count values, m_appended values were pushed in
+    // total and the value pushed as the nth is at n % capacity.
+    QVector<qreal> m_buffer;
+    qint64 m_appended = 0;
+    int m_count = 0;
+    // Sequence numbers of the sliding window minima and maxima, the front of
+    // each holds the current extreme.
+    std::deque<qint64> m_minima;
+    std::deque<qint64> m_maxima;
+    QVector<QVector2D> m_points;
 };
 
 #endif // SAILFISH_SILICA_PLUGIN_LINEGRAPH_H
@@ -4,6 +4,171 @@
 #include <QSGGeometry>
 #include <QSGFlatColorMaterial>
 #include <QQuickWindow>
+#include <QtMath>
+
+#include <cstring>
+
+namespace {
+
+// Miter joins longer than this many half widths are rounded instead.
+const float MiterLimit = 2.0f;
+// Segments used for a round join turning by half a circle.
+const int RoundJoinSegments = 8;
+
+// The points of a series with steps - 1 points interpolated on each segment,
+// computed as they are read rather than into a temporary.
+class SmoothedSeries
+{
+public:
+    SmoothedSeries(const QVector<QVector2D> &points, int steps)
+        : m_points(points)
+        , m_steps(steps)
+    {
+    }
+
+    int count() const
+    {
+        return m_points.count() > 1 ? (m_points.count() - 1) * m_steps + 1 : 0;
+    }
+
+    QVector2D at(int index) const
+    {
+        const int segment = index / m_steps;
+        const int step = index % m_steps;
+        if (step == 0) {
+            return m_points.at(segment);
+        }
+        const QVector2D &from = m_points.at(segment);
+        return from + (float(step) / m_steps) * (m_points.at(segment + 1) - from);
+    }
+
+private:
+    const QVector<QVector2D> &m_points;
+    const int m_steps;
+};
+
+// Appends triangle strip vertices from the given count on, or only counts
+// them without a buffer.
+class StrokeWriter
+{
+public:
+    StrokeWriter(QSGGeometry::Point2D *vertices, int count)
+        : m_vertices(vertices)
+        , m_count(count)
+    {
+        if (m_vertices && m_count > 0) {
+            m_last = QVector2D(m_vertices[m_count - 1].x, m_vertices[m_count - 1].y);
+        }
+    }
+
+    int count() const { return m_count; }
+
+    void add(const QVector2D &point)
+    {
+        if (m_vertices) {
+            m_vertices[m_count].set(point.x(), point.y());
+        }
+        m_last = point;
+        ++m_count;
+    }
+
+    // Adds the vertices either side of point, left first.
+    void addPair(const QVector2D &point, const QVector2D &offset)
+    {
+        add(point + offset);
+        add(point - offset);
+    }
+
+    // Collapses the rest of the buffer onto the last vertex, drawing nothing.
+    void pad(int count)
+    {
+        while (m_count < count) {
+            add(m_last);
+        }
+    }
+
+private:
+    QSGGeometry::Point2D *m_vertices;
+    QVector2D m_last;
+    int m_count;
+};
+
+inline QVector2D normal(const QVector2D &direction)
+{
+    return QVector2D(-direction.y(), direction.x());
+}
+
+void addJoin(StrokeWriter *writer, const QVector2D &point,
+             const QVector2D &incoming, const QVector2D &outgoing, float halfWidth)
+{
+    const QVector2D n0 = normal(incoming);
+    const QVector2D n1 = normal(outgoing);
+    const QVector2D bisector = n0 + n1;
+    const float bisectorLength = bisector.length();
+
+    // The miter is halfWidth / cos(turn / 2) long, and cos(turn / 2) is half the
+    // length of the bisector of the unit normals.
+    if (bisectorLength * MiterLimit > 2.0f) {
+        writer->addPair(point, bisector * (2.0f * halfWidth / (bisectorLength * bisectorLength)));
+        return;
+    }
+
+    // Round the outer side of the turn, the inner side stays at the point.
+    const float turn = qAtan2(incoming.x() * outgoing.y() - incoming.y() * outgoing.x(),
+                              QVector2D::dotProduct(incoming, outgoing));
+    const int segments = qMax(2, qCeil(qAbs(turn) * RoundJoinSegments / float(M_PI)));
+    writer->addPair(point, n0 * halfWidth);
+    for (int i = 1; i < segments; ++i) {
+        const float angle = turn * i / segments;
+        const float c = qCos(angle);
+        const float s = qSin(angle);
+        const QVector2D offset = QVector2D(n0.x() * c - n0.y() * s, n0.x() * s + n0.y() * c) * halfWidth;
+        if (turn > 0) {
+            writer->add(point);
+            writer->add(point - offset);
+        } else {
+            writer->add(point + offset);
+            writer->add(point);
+        }
+    }
+    writer->addPair(point, n1 * halfWidth);
+}
+
+template <typename State>
+void strokePoint(StrokeWriter *writer, State *state, const QVector2D &point, float halfWidth)
+{
+    if (!state->hasPoint) {
+        state->point = point;
+        state->hasPoint = true;
+        return;
+    }
+
+    const float length = (point - state->point).length();
+    if (length < 1e-4f) {
+        // Repeated points have no direction to offset along.
+        return;
+    }
+    const QVector2D direction = (point - state->point) / length;
+
+    if (!state->started) {
+        writer->addPair(state->point, normal(direction) * halfWidth);
+        state->started = true;
+    } else {
+        addJoin(writer, state->point, state->direction, direction, halfWidth);
+    }
+    state->point = point;
+    state->direction = direction;
+}
+
+template <typename State>
+void strokeEnd(StrokeWriter *writer, const State &state, float halfWidth)
+{
+    if (state.started) {
+        writer->addPair(state.point, normal(state.direction) * halfWidth);
+    }
+}
+
+}
 
 LineItem::LineItem(QQuickItem *parent)
     : QQuickItem(parent)
@@ -15,7 +180,7 @@ void LineItem::setCurveDensity(qreal density)
 {
     if (m_curveDensity != density) {
         m_curveDensity = density;
-        m_updatePoints = true;
+        rebuildSeries();
         update();
         emit curveDensityChanged();
     }
@@ -25,7 +190,7 @@ void LineItem::setLineWidth(qreal width)
 {
     if (m_lineWidth != width) {
         m_lineWidth = width;
-        m_updatePoints = true;
+        rebuildSeries();
         update();
         emit lineWidthChanged();
     }
@@ -35,115 +200,152 @@ void LineItem::setColor(const QColor &color)
 {
     if (m_color != color) {
         m_color = color;
+        m_colorChanged = true;
         update();
         emit colorChanged();
     }
 }
 
-void LineItem::setPoints(int series, const QVector<QVector2D> &points)
+LineItem::Series &LineItem::series(int index)
 {
-    if (series >= m_series.size()) {
-        m_series.resize(series + 1);
+    if (index >= m_series.size()) {
+        m_series.resize(index + 1);
     }
+    return m_series[index];
+}
 
-    m_series[series] = points;
-    m_updatePoints = true;
+void LineItem::rebuildSeries()
+{
+    for (Series &series : m_series) {
+        series.rebuild = true;
+        series.dirty = true;
+    }
+}
+
+void LineItem::setPoints(int index, const QVector<QVector2D> &points)
+{
+    Series &series = this->series(index);
+    series.points = points;
+    series.rebuild = true;
+    series.dirty = true;
     update();
 }
 
-QSGNode *LineItem::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *)
+void LineItem::appendPoints(int index, const QVector<QVector2D> &points)
 {
-    QSGGeometryNode *node = static_cast<QSGGeometryNode *>(oldNode);
+    Series &series = this->series(index);
+    series.points += points;
+    series.dirty = true;
+    update();
+}
 
-    if (!node) {
-        node = new QSGGeometryNode();
-        QSGFlatColorMaterial *material = new QSGFlatColorMaterial();
-        material->setColor(m_color);
-        node->setMaterial(material);
-        node->setFlag(QSGNode::OwnsMaterial);
-    } else {
-        QSGFlatColorMaterial *material = static_cast<QSGFlatColorMaterial *>(node->material());
-        material->setColor(m_color);
+void LineItem::removeSeries(int index)
+{
+    if (index >= 0 && index < m_series.size()) {
+        m_series.remove(index);
+        m_removedSeries.append(index);
+        update();
     }
+}
 
-    if (m_updatePoints) {
-        updateGeometry(node);
-        m_updatePoints = false;
+void LineItem::clearSeries()
+{
+    while (!m_series.isEmpty()) {
+        removeSeries(m_series.count() - 1);
     }
-
-    return node;
 }
 
-void LineItem::updateGeometry(QSGGeometryNode *node)
+QSGNode *LineItem::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *)
 {
-    if (m_series.isEmpty()) {
-        return;
+    QSGNode *root = oldNode;
+    if (!root) {
+        root = new QSGNode;
     }
 
-    // Calculate total number of vertices needed
-    int totalVertices = 0;
-    for (const QVector<QVector2D> &series : m_series) {
-        if (series.size() > 1) {
-            totalVertices += series.size();
+    for (int index : m_removedSeries) {
+        // Series added and removed again since the last update have no node.
+        if (index < root->childCount()) {
+            QSGNode *node = root->childAtIndex(index);
+            root->removeChildNode(node);
+            delete node;
         }
     }
+    m_removedSeries.clear();
 
-    if (totalVertices == 0) {
-        return;
+    while (root->childCount() < m_series.count()) {
+        QSGGeometryNode *node = new QSGGeometryNode();
+        QSGFlatColorMaterial *material = new QSGFlatColorMaterial();
+        material->setColor(m_color);
+        node->setMaterial(material);
+        node->setFlag(QSGNode::OwnsMaterial);
+        root->appendChildNode(node);
     }
 
-    // Create geometry for line strips
-    QSGGeometry *geometry = new QSGGeometry(QSGGeometry::defaultAttributes_Point2D(), totalVertices);
-    QSGGeometry::Point2D *vertices = geometry->vertexDataAsPoint2D();
-
-    int vertexIndex = 0;
-    for (const QVector<QVector2D> &series : m_series) {
-        if (series.size() > 1) {
-            QVector<QVector2D> smoothedPoints = smoothCurve(series);
-
-            for (const QVector2D &point : smoothedPoints) {
-                vertices[vertexIndex].set(point.x(), point.y());
-                vertexIndex++;
-            }
+    QSGNode *child = root->firstChild();
+    for (Series &series : m_series) {
+        QSGGeometryNode *node = static_cast<QSGGeometryNode *>(child);
+        if (m_colorChanged) {
+            static_cast<QSGFlatColorMaterial *>(node->material())->setColor(m_color);
+            node->markDirty(QSGNode::DirtyMaterial);
         }
+        if (series.dirty) {
+            updateGeometry(node, &series);
+        }
+        child = child->nextSibling();
     }
+    m_colorChanged = false;
 
-    geometry->setDrawingMode(QSGGeometry::DrawLineStrip);
-    geometry->setLineWidth(m_lineWidth);
-
-    node->setGeometry(geometry);
-    node->setFlag(QSGNode::OwnsGeometry);
+    return root;
 }
 
-QVector<QVector2D> LineItem::smoothCurve(const QVector<QVector2D> &points) const
+void LineItem::updateGeometry(QSGGeometryNode *node, Series *series)
 {
-    if (points.size() < 2) {
-        return points;
-    }
+    // Each segment gets curveDensity - 1 interpolated points.
+    const int steps = m_curveDensity > 1.0 ? qMax(1, static_cast<int>(m_curveDensity - 1)) + 1 : 1;
+    const float halfWidth = m_lineWidth / 2;
+    const SmoothedSeries points(series->points, steps);
 
-    if (m_curveDensity <= 1.0) {
-        return points;
+    if (series->rebuild) {
+        series->stroke = StrokeState();
+        series->strokedPoints = 0;
+        series->stripLength = 0;
+        series->rebuild = false;
     }
+    series->dirty = false;
 
-    // Simple smoothing by adding intermediate points
-    QVector<QVector2D> smoothed;
-    smoothed.reserve(points.size() * m_curveDensity);
-
-    for (int i = 0; i < points.size() - 1; ++i) {
-        const QVector2D &p1 = points[i];
-        const QVector2D &p2 = points[i + 1];
-
-        smoothed.append(p1);
+    // Count the vertices the new points add, the end cap is replaced.
+    StrokeState state = series->stroke;
+    StrokeWriter counter(nullptr, series->stripLength);
+    for (int i = series->strokedPoints; i < points.count(); ++i) {
+        strokePoint(&counter, &state, points.at(i), halfWidth);
+    }
+    strokeEnd(&counter, state, halfWidth);
 
-        // Add intermediate points based on curve density
-        int intermediatePoints = qMax(1, static_cast<int>(m_curveDensity - 1));
-        for (int j = 1; j <= intermediatePoints; ++j) {
-            qreal t = j / qreal(intermediatePoints + 1);
-            QVector2D intermediate = p1 + t * (p2 - p1);
-            smoothed.append(intermediate);
+    QSGGeometry *geometry = node->geometry();
+    if (!geometry || geometry->vertexCount() < counter.count()) {
+        // Leave room to grow so appending points does not reallocate every
+        // update, and keep the vertices already stroked.
+        QSGGeometry *grown = new QSGGeometry(QSGGeometry::defaultAttributes_Point2D(),
+                                             counter.count() + counter.count() / 2);
+        grown->setDrawingMode(QSGGeometry::DrawTriangleStrip);
+        if (geometry) {
+            memcpy(grown->vertexData(), geometry->vertexData(),
+                   series->stripLength * sizeof(QSGGeometry::Point2D));
         }
+        node->setGeometry(grown);
+        node->setFlag(QSGNode::OwnsGeometry);
+        geometry = grown;
+    }
+
+    StrokeWriter writer(geometry->vertexDataAsPoint2D(), series->stripLength);
+    for (int i = series->strokedPoints; i < points.count(); ++i) {
+        strokePoint(&writer, &series->stroke, points.at(i), halfWidth);
     }
+    series->strokedPoints = points.count();
+    series->stripLength = writer.count();
+    strokeEnd(&writer, series->stroke, halfWidth);
+    writer.pad(geometry->vertexCount());
 
-    smoothed.append(points.last());
-    return smoothed;
+    geometry->markVertexDataDirty();
+    node->markDirty(QSGNode::DirtyGeometry);
 }
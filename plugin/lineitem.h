@@ -28,7 +28,12 @@ public:
     QColor color() const { return m_color; }
     void setColor(const QColor &color);
 
+    int seriesCount() const { return m_series.count(); }
     void setPoints(int series, const QVector<QVector2D> &points);
+    // Strokes only the new part of the series on the next update.
+    void appendPoints(int series, const QVector<QVector2D> &points);
+    void removeSeries(int series);
+    void clearSeries();
 
 Q_SIGNALS:
     void curveDensityChanged();
@@ -39,14 +44,41 @@ protected:
     QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *) override;
 
 private:
-    void updateGeometry(QSGGeometryNode *node);
-    QVector<QVector2D> smoothCurve(const QVector<QVector2D> &points) const;
+    // Where stroking a series left off, at the last point before its end cap.
+    struct StrokeState
+    {
+        QVector2D point;
+        QVector2D direction;
+        bool hasPoint = false;
+        bool started = false;
+    };
+
+    struct Series
+    {
+        QVector<QVector2D> points;
+        StrokeState stroke;
+        // Interpolated points stroked so far and the vertices they produced,
+        // the end cap follows them.
+        int strokedPoints = 0;
+        int stripLength = 0;
+        bool rebuild = true;
+        bool dirty = true;
+    };
+
+    Series &series(int index);
+    void rebuildSeries();
+    // Strokes each series as a triangle strip in its own node, continuing from
+    // where the last update left off unless the series was rebuilt. The node's
+    // geometry is reused unless it has to grow.
+    void updateGeometry(QSGGeometryNode *node, Series *series);
 
     qreal m_curveDensity = 1.0;
     qreal m_lineWidth = 1.0;
     QColor m_color = Qt::black;
-    QVector<QVector<QVector2D>> m_series;
-    bool m_updatePoints = true;
+    QVector<Series> m_series;
+    // Series removed since the last update, their nodes go in the same order.
+    QVector<int> m_removedSeries;
+    bool m_colorChanged = true;
 };
 
 #endif // SAILFISH_SILICA_PLUGIN_LINEITEM_H
@@ -0,0 +1,394 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+
+#include "linkparser.h"
+#include <QCache>
+
+namespace {
+
+// Cached results, in characters of text and result.
+const int LinkCacheCost = 512 * 1024;
+const int MinimumPhoneDigits = 7;
+const int MaximumPhoneDigits = 15;
+
+typedef QCache<QString, QString> LinkCache;
+Q_GLOBAL_STATIC_WITH_ARGS(LinkCache, linkCache, (LinkCacheCost))
+
+inline bool isAsciiLetter(QChar c)
+{
+    return (c >= QLatin1Char('a') && c <= QLatin1Char('z'))
+            || (c >= QLatin1Char('A') && c <= QLatin1Char('Z'));
+}
+
+inline bool isAsciiDigit(QChar c)
+{
+    return c >= QLatin1Char('0') && c <= QLatin1Char('9');
+}
+
+inline bool isWordCharacter(QChar c)
+{
+    return c.isLetterOrNumber() || c == QLatin1Char('_');
+}
+
+bool isUrlCharacter(QChar c)
+{
+    if (c.isLetterOrNumber()) {
+        return true;
+    }
+
+    switch (c.unicode()) {
+    case '-': case '.': case '_': case '~': case ':': case '/': case '?': case '#':
+    case '[': case ']': case '@': case '!': case '$': case '&': case '\'': case '(':
+    case ')': case '*': case '+': case ',': case ';': case '=': case '%':
+        return true;
+    default:
+        return false;
+    }
+}
+
+inline bool isLocalPartCharacter(QChar c)
+{
+    return isAsciiLetter(c) || isAsciiDigit(c)
+            || c == QLatin1Char('.') || c == QLatin1Char('_') || c == QLatin1Char('%')
+            || c == QLatin1Char('+') || c == QLatin1Char('-');
+}
+
+inline bool isDomainCharacter(QChar c)
+{
+    return isAsciiLetter(c) || isAsciiDigit(c) || c == QLatin1Char('.') || c == QLatin1Char('-');
+}
+
+inline bool isPhoneSeparator(QChar c)
+{
+    return c == QLatin1Char(' ') || c == QLatin1Char('-') || c == QLatin1Char('(') || c == QLatin1Char(')');
+}
+
+void appendEscaped(QString *out, const QChar *begin, const QChar *end)
+{
+    const QChar *run = begin;
+    for (const QChar *c = begin; c != end; ++c) {
+        const char *replacement = nullptr;
+        switch (c->unicode()) {
+        case '&': replacement = "&amp;"; break;
+        case '<': replacement = "&lt;"; break;
+        case '>': replacement = "&gt;"; break;
+        case '"': replacement = "&quot;"; break;
+        case '\n': replacement = "<br>"; break;
+        default: continue;
+        }
+        out->append(run, c - run);
+        out->append(QLatin1String(replacement));
+        run = c + 1;
+    }
+    out->append(run, end - run);
+}
+
+// A single forward scan over the text. Link starts are only looked for at
+// word boundaries, and e-mail addresses are found from their @ using the run
+// of local part characters tracked on the way, so the scan never returns to
+// characters before its current position.
+class LinkScanner
+{
+public:
+    LinkScanner(const QString &text, bool shortenUrl)
+        : m_text(text)
+        , m_data(text.constData())
+        , m_length(text.length())
+        , m_shortenUrl(shortenUrl)
+    {
+    }
+
+    QString run();
+
+private:
+    int matchUrl(int position) const;
+    int matchPhone(int position, int *scanned) const;
+    int matchEmail(int at) const;
+
+    bool startsWith(int position, QLatin1String prefix) const;
+    void appendText(int end);
+    void appendLink(const QString &href, int start, int end, bool shorten);
+
+    const QString &m_text;
+    const QChar *m_data;
+    const int m_length;
+    const bool m_shortenUrl;
+    QString m_result;
+    int m_written = 0;
+};
+
+QString LinkScanner::run()
+{
+    m_result.reserve(m_length + m_length / 8);
+
+    // Start of the run of e-mail local part characters before the position.
+    int localStart = -1;
+    // End of the digits and separators the last phone number match scanned.
+    int phoneEnd = 0;
+
+    for (int i = 0; i < m_length;) {
+        const QChar c = m_data[i];
+
+        if (i == 0 || !isWordCharacter(m_data[i - 1])) {
+            int end = matchUrl(i);
+            if (end > i) {
+                QString href = m_text.mid(i, end - i);
+                if (startsWith(i, QLatin1String("www."))) {
+                    href.prepend(QLatin1String("http://"));
+                }
+                appendLink(href, i, end, m_shortenUrl);
+                localStart = -1;
+                i = end;
+                continue;
+            }
+
+            // A phone number starting within a run that didn't match would
+            // end the same way, so each run is only scanned once.
+            end = i >= phoneEnd ? matchPhone(i, &phoneEnd) : -1;
+            if (end > i) {
+                QString href = QStringLiteral("tel:");
+                for (int j = i; j < end; ++j) {
+                    if (isAsciiDigit(m_data[j]) || m_data[j] == QLatin1Char('+')) {
+                        href.append(m_data[j]);
+                    }
+                }
+                appendLink(href, i, end, false);
+                localStart = -1;
+                i = end;
+                continue;
+            }
+        }
+
+        if (c == QLatin1Char('@') && localStart >= 0) {
+            // A local part doesn't start with a dot.
+            while (localStart < i && m_data[localStart] == QLatin1Char('.')) {
+                ++localStart;
+            }
+            const int end = localStart < i ? matchEmail(i) : -1;
+            if (end > i) {
+                appendLink(QStringLiteral("mailto:") + m_text.mid(localStart, end - localStart),
+                           localStart, end, false);
+                localStart = -1;
+                i = end;
+                continue;
+            }
+        }
+
+        if (isLocalPartCharacter(c)) {
+            if (localStart < 0) {
+                localStart = i;
+            }
+        } else {
+            localStart = -1;
+        }
+        ++i;
+    }
+
+    appendText(m_length);
+    return m_result;
+}
+
+bool LinkScanner::startsWith(int position, QLatin1String prefix) const
+{
+    return m_length - position >= prefix.size()
+            && m_text.midRef(position, prefix.size()).compare(prefix, Qt::CaseInsensitive) == 0;
+}
+
+int LinkScanner::matchUrl(int position) const
+{
+    int start;
+    if (startsWith(position, QLatin1String("http://"))) {
+        start = position + 7;
+    } else if (startsWith(position, QLatin1String("https://"))) {
+        start = position + 8;
+    } else if (startsWith(position, QLatin1String("www."))) {
+        start = position + 4;
+    } else {
+        return -1;
+    }
+
+    int end = start;
+    int open = 0;
+    int close = 0;
+    for (; end < m_length && isUrlCharacter(m_data[end]); ++end) {
+        if (m_data[end] == QLatin1Char('(')) {
+            ++open;
+        } else if (m_data[end] == QLatin1Char(')')) {
+            ++close;
+        }
+    }
+
+    // Trailing punctuation ends the sentence, and an unmatched closing
+    // parenthesis encloses the address, rather than being part of it.
+    while (end > start) {
+        const QChar c = m_data[end - 1];
+        if (c == QLatin1Char('.') || c == QLatin1Char(',') || c == QLatin1Char(':')
+                || c == QLatin1Char(';') || c == QLatin1Char('!') || c == QLatin1Char('?')
+                || c == QLatin1Char('\'')) {
+            --end;
+        } else if (c == QLatin1Char(')') && close > open) {
+            --close;
+            --end;
+        } else {
+            break;
+        }
+    }
+
+    return end > start ? end : -1;
+}
+
+// Sets scanned to the end of the run of digits and separators it looked at.
+int LinkScanner::matchPhone(int position, int *scanned) const
+{
+    int p = position;
+    const bool international = m_data[p] == QLatin1Char('+');
+    if (international) {
+        ++p;
+    }
+    if (p >= m_length || !isAsciiDigit(m_data[p])) {
+        return -1;
+    }
+
+    // Digits in groups separated by at most two separators, e.g. "+1 (555)".
+    int digits = 0;
+    int separators = 0;
+    int end = p;
+    for (; p < m_length; ++p) {
+        const QChar c = m_data[p];
+        if (isAsciiDigit(c)) {
+            ++digits;
+            separators = 0;
+            end = p + 1;
+        } else if (isPhoneSeparator(c) && separators < 2) {
+            ++separators;
+        } else {
+            break;
+        }
+    }
+    *scanned = p;
+
+    // Too long a run isn't a phone number, nor is any part of it.
+    if (digits < MinimumPhoneDigits || digits > MaximumPhoneDigits) {
+        return -1;
+    }
+    // Part of a longer word or the local part of an e-mail address.
+    if (end < m_length && (isWordCharacter(m_data[end]) || m_data[end] == QLatin1Char('@'))) {
+        return -1;
+    }
+    // A date, e.g. 2024-01-31.
+    if (!international && end - position == 10
+            && m_data[position + 4] == QLatin1Char('-') && m_data[position + 7] == QLatin1Char('-')) {
+        return -1;
+    }
+    return end;
+}
+
+int LinkScanner::matchEmail(int at) const
+{
+    const int start = at + 1;
+    int end = start;
+    while (end < m_length && isDomainCharacter(m_data[end])) {
+        ++end;
+    }
+    while (end > start && (m_data[end - 1] == QLatin1Char('.') || m_data[end - 1] == QLatin1Char('-'))) {
+        --end;
+    }
+
+    // The domain needs a name and a top level domain of two or more letters.
+    int letters = 0;
+    int dot = end - 1;
+    for (; dot > start && m_data[dot] != QLatin1Char('.'); --dot) {
+        if (!isAsciiLetter(m_data[dot])) {
+            return -1;
+        }
+        ++letters;
+    }
+    return dot > start && letters >= 2 ? end : -1;
+}
+
+void LinkScanner::appendText(int end)
+{
+    appendEscaped(&m_result, m_data + m_written, m_data + end);
+    m_written = end;
+}
+
+void LinkScanner::appendLink(const QString &href, int start, int end, bool shorten)
+{
+    appendText(start);
+
+    QString label = m_text.mid(start, end - start);
+    if (shorten) {
+        // Keep scheme/host, elide path
+        const int scheme = label.indexOf(QLatin1String("://"));
+        const int slash = label.indexOf(QLatin1Char('/'), scheme >= 0 ? scheme + 3 : 0);
+        if (slash > 0 && slash < label.size() - 1) {
+            label = label.left(slash + 1) + QChar(0x2026);
+        }
+    }
+
+    m_result += QLatin1String("<a href=\"");
+    appendEscaped(&m_result, href.constData(), href.constData() + href.size());
+    m_result += QLatin1String("\">");
+    appendEscaped(&m_result, label.constData(), label.constData() + label.size());
+    m_result += QLatin1String("</a>");
+    m_written = end;
+}
+
+}
+
+LinkParser::LinkParser(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void LinkParser::setText(const QString &text)
+{
+    if (m_text != text) {
+        m_text = text;
+        emit textChanged();
+        update();
+    }
+}
+
+void LinkParser::setShortenUrl(bool shorten)
+{
+    if (m_shortenUrl != shorten) {
+        m_shortenUrl = shorten;
+        emit shortenUrlChanged();
+        update();
+    }
+}
+
+void LinkParser::update()
+{
+    const QString linkedText = parse(m_text, m_shortenUrl);
+    if (m_linkedText != linkedText) {
+        m_linkedText = linkedText;
+        emit linkedTextChanged();
+    }
+}
+
+QStringList LinkParser::parse(const QStringList &texts) const
+{
+    QStringList result;
+    result.reserve(texts.count());
+    for (const QString &text : texts) {
+        result.append(parse(text, m_shortenUrl));
+    }
+    return result;
+}
+
+QString LinkParser::parse(const QString &text, bool shortenUrl)
+{
+    if (text.isEmpty()) {
+        return text;
+    }
+
+    const QString key = (shortenUrl ? QLatin1Char('1') : QLatin1Char('0')) + text;
+    if (const QString *cached = linkCache->object(key)) {
+        return *cached;
+    }
+
+    const QString result = LinkScanner(text, shortenUrl).run();
+    linkCache->insert(key, new QString(result), key.size() + result.size());
+    return result;
+}
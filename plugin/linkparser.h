@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: LGPL-2.1-only
+
+#ifndef SAILFISH_SILICA_PLUGIN_LINKPARSER_H
+#define SAILFISH_SILICA_PLUGIN_LINKPARSER_H
+
+#include <QObject>
+#include <QStringList>
+
+// Converts plain text to styled text with web addresses, e-mail addresses
+// and phone numbers as links. The text is HTML escaped and newlines become
+// line breaks in the same pass.
+//
+// Links are found by a single forward scan which never revisits more than a
+// few characters, rather than by regular expressions, and results are cached
+// so the same text shown by many delegates is only parsed once.
+class LinkParser : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QString text READ text WRITE setText NOTIFY textChanged)
+    Q_PROPERTY(bool shortenUrl READ shortenUrl WRITE setShortenUrl NOTIFY shortenUrlChanged)
+    Q_PROPERTY(QString linkedText READ linkedText NOTIFY linkedTextChanged)
+
+public:
+    explicit LinkParser(QObject *parent = nullptr);
+
+    QString text() const { return m_text; }
+    void setText(const QString &text);
+    bool shortenUrl() const { return m_shortenUrl; }
+    void setShortenUrl(bool shorten);
+    QString linkedText() const { return m_linkedText; }
+
+    // Parses several texts at once, e.g. for the rows of a model.
+    Q_INVOKABLE QStringList parse(const QStringList &texts) const;
+
+    static QString parse(const QString &text, bool shortenUrl);
+
+Q_SIGNALS:
+    void textChanged();
+    void shortenUrlChanged();
+    void linkedTextChanged();
+
+private:
+    void update();
+
+    QString m_text;
+    QString m_linkedText;
+    bool m_shortenUrl = false;
+};
+
+#endif // SAILFISH_SILICA_PLUGIN_LINKPARSER_H
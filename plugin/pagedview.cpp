@@ -4,10 +4,12 @@
 #include <QQmlEngine>
 #include <QQmlContext>
 #include <QQmlComponent>
+#include <QHash>
 #include <QMouseEvent>
 #include <QPropertyAnimation>
 #include <QTimer>
 #include <QtMath>
+#include <private/qqmlchangeset_p.h>
 #include <private/qqmldelegatemodel_p.h>
 
 PagedView::PagedView(QQuickItem *parent)
@@ -23,6 +25,7 @@ PagedView::PagedView(QQuickItem *parent)
 
 PagedView::~PagedView()
 {
+    releaseItems();
     destroyContentItem();
     if (m_delegateModel) {
         delete m_delegateModel;
@@ -39,6 +42,8 @@ void PagedView::setModel(const QVariant &model)
         m_model = model;
         emit modelChanged();
 
+        // Items belong to the delegate model that created them.
+        releaseItems();
         if (m_delegateModel) {
             delete m_delegateModel;
             m_delegateModel = nullptr;
@@ -49,10 +54,16 @@ void PagedView::setModel(const QVariant &model)
             QQmlContext *context = qmlContext(this);
             if (context) {
                 m_delegateModel = new QQmlDelegateModel(context, this);
+                m_delegateModel->setDelegate(m_delegate);
                 m_delegateModel->setModel(m_model);
+                if (isComponentComplete()) {
+                    m_delegateModel->componentComplete();
+                }
 
                 // Connect to model signals
                 connect(m_delegateModel, &QQmlDelegateModel::countChanged, this, &PagedView::onModelCountChanged);
+                connect(m_delegateModel, &QQmlInstanceModel::modelUpdated, this, &PagedView::onModelUpdated);
+                connect(m_delegateModel, &QQmlInstanceModel::createdItem, this, &PagedView::onItemCreated);
 
                 m_count = m_delegateModel->count();
             } else {
@@ -80,6 +91,12 @@ void PagedView::setDelegate(QQmlComponent *delegate)
     if (m_delegate != delegate) {
         m_delegate = delegate;
         emit delegateChanged();
+
+        // Every item comes from the old delegate.
+        releaseItems();
+        if (m_delegateModel) {
+            m_delegateModel->setDelegate(m_delegate);
+        }
         updateLayout();
     }
 }
@@ -89,7 +106,7 @@ void PagedView::setDirection(Direction direction)
     if (m_direction != direction) {
         m_direction = direction;
         emit directionChanged();
-        updateLayout();
+        relayoutItems();
     }
 }
 
@@ -98,7 +115,7 @@ void PagedView::setHorizontalAlignment(Qt::Alignment alignment)
     if (m_horizontalAlignment != alignment) {
         m_horizontalAlignment = alignment;
         emit horizontalAlignmentChanged();
-        updateLayout();
+        relayoutItems();
     }
 }
 
@@ -107,7 +124,7 @@ void PagedView::setVerticalAlignment(Qt::Alignment alignment)
     if (m_verticalAlignment != alignment) {
         m_verticalAlignment = alignment;
         emit verticalAlignmentChanged();
-        updateLayout();
+        relayoutItems();
     }
 }
 
@@ -116,7 +133,7 @@ void PagedView::setWrapMode(WrapMode mode)
     if (m_wrapMode != mode) {
         m_wrapMode = mode;
         emit wrapModeChanged();
-        updateLayout();
+        relayoutItems();
     }
 }
 
@@ -125,7 +142,7 @@ void PagedView::setHorizontalSpacing(qreal spacing)
     if (!qFuzzyCompare(m_horizontalSpacing, spacing)) {
         m_horizontalSpacing = spacing;
         emit horizontalSpacingChanged();
-        updateLayout();
+        relayoutItems();
     }
 }
 
@@ -134,7 +151,7 @@ void PagedView::setVerticalSpacing(qreal spacing)
     if (!qFuzzyCompare(m_verticalSpacing, spacing)) {
         m_verticalSpacing = spacing;
         emit verticalSpacingChanged();
-        updateLayout();
+        relayoutItems();
     }
 }
 
@@ -149,7 +166,7 @@ void PagedView::setCurrentIndex(int index)
             moveTo(m_currentIndex, Immediate);
         }
 
-        updateCurrentItem();
+        updateLayout();
     }
 }
 
@@ -199,6 +216,7 @@ void PagedView::setContentOffset(qreal offset)
     if (!qFuzzyCompare(m_contentOffset, offset)) {
         m_contentOffset = offset;
         updateItemPositions();
+        ensureExposedItems();
         emit contentOffsetChanged();
     }
 }
@@ -235,10 +253,7 @@ void PagedView::moveTo(int index, int transition)
 
 QQuickItem *PagedView::itemAt(int index)
 {
-    if (index >= 0 && index < m_items.size()) {
-        return m_items[index];
-    }
-    return nullptr;
+    return m_items.value(index);
 }
 
 PagedViewAttached *PagedView::qmlAttachedProperties(QObject *object)
@@ -249,6 +264,10 @@ PagedViewAttached *PagedView::qmlAttachedProperties(QObject *object)
 void PagedView::componentComplete()
 {
     Silica::Control::componentComplete();
+    if (m_delegateModel) {
+        m_delegateModel->componentComplete();
+        m_count = m_delegateModel->count();
+    }
     createContentItem();
     updateLayout();
 }
@@ -256,8 +275,8 @@ void PagedView::componentComplete()
 void PagedView::geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry)
 {
     Silica::Control::geometryChanged(newGeometry, oldGeometry);
-    m_layoutDirty = true;
-    updateLayout();
+    // The same items remain in the window, only their positions change.
+    relayoutItems();
 }
 
 void PagedView::mousePressEvent(QMouseEvent *event)
@@ -314,37 +333,131 @@ void PagedView::updatePolish()
 
 void PagedView::onModelCountChanged()
 {
-    // This will be called when we have proper model support
+    const int count = m_delegateModel ? m_delegateModel->count() : m_count;
+    if (m_count != count) {
+        m_count = count;
+        emit countChanged();
+    }
+    if (m_currentIndex >= m_count) {
+        setCurrentIndex(m_count - 1);
+    }
     updateLayout();
 }
 
 void PagedView::onModelDataChanged(int index, int count)
 {
+    // Delegates see their model data change through their bindings.
     Q_UNUSED(index)
     Q_UNUSED(count)
-    updateLayout();
 }
 
 void PagedView::onModelRowsInserted(int index, int count)
 {
-    Q_UNUSED(index)
-    Q_UNUSED(count)
-    updateLayout();
+    QQmlChangeSet changeSet;
+    changeSet.insert(index, count);
+    onModelUpdated(changeSet, false);
 }
 
 void PagedView::onModelRowsRemoved(int index, int count)
 {
-    Q_UNUSED(index)
-    Q_UNUSED(count)
-    updateLayout();
+    QQmlChangeSet changeSet;
+    changeSet.remove(index, count);
+    onModelUpdated(changeSet, false);
 }
 
 void PagedView::onModelRowsMoved(int from, int to, int count)
 {
-    Q_UNUSED(from)
-    Q_UNUSED(to)
-    Q_UNUSED(count)
-    updateLayout();
+    QQmlChangeSet changeSet;
+    changeSet.move(from, to, count, 0);
+    onModelUpdated(changeSet, false);
+}
+
+void PagedView::onModelUpdated(const QQmlChangeSet &changeSet, bool reset)
+{
+    int current = m_currentIndex;
+
+    if (reset) {
+        releaseItems();
+    } else {
+        // Removals apply in order before insertions. A move pairs a removal
+        // and an insertion with the same moveId, its items are carried over.
+        QHash<int, QMap<int, QQuickItem *>> moving;
+        int currentMoveId = -1;
+        int currentMoveOffset = 0;
+
+        for (const QQmlChangeSet::Change &remove : changeSet.removes()) {
+            const QMap<int, QQuickItem *> removed = takeItems(remove.index, remove.count);
+            shiftItems(remove.index + remove.count, -remove.count);
+
+            const bool removesCurrent = current >= remove.index && current < remove.index + remove.count;
+            if (remove.isMove()) {
+                QMap<int, QQuickItem *> &items = moving[remove.moveId];
+                for (auto it = removed.begin(); it != removed.end(); ++it) {
+                    items.insert(it.key() - remove.index + remove.offset, it.value());
+                }
+                if (removesCurrent) {
+                    currentMoveId = remove.moveId;
+                    currentMoveOffset = current - remove.index + remove.offset;
+                    current = -1;
+                }
+            } else {
+                for (QQuickItem *item : removed) {
+                    destroyItem(item);
+                }
+                if (removesCurrent) {
+                    // The next remaining item takes the place of the current one.
+                    current = remove.index;
+                }
+            }
+            if (current >= remove.index + remove.count) {
+                current -= remove.count;
+            }
+        }
+
+        for (const QQmlChangeSet::Change &insert : changeSet.inserts()) {
+            shiftItems(insert.index, insert.count);
+            if (current >= insert.index) {
+                current += insert.count;
+            }
+            if (!insert.isMove()) {
+                continue;
+            }
+
+            QMap<int, QQuickItem *> &items = moving[insert.moveId];
+            for (auto it = items.begin(); it != items.end();) {
+                const int offset = it.key() - insert.offset;
+                if (offset >= 0 && offset < insert.count) {
+                    m_items.insert(insert.index + offset, it.value());
+                    it = items.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            const int offset = currentMoveOffset - insert.offset;
+            if (insert.moveId == currentMoveId && offset >= 0 && offset < insert.count) {
+                current = insert.index + offset;
+            }
+        }
+
+        for (const QMap<int, QQuickItem *> &items : moving) {
+            for (QQuickItem *item : items) {
+                destroyItem(item);
+            }
+        }
+    }
+
+    // Pending requests are made again for the shifted indices.
+    m_incubating.clear();
+
+    if (current != m_currentIndex) {
+        m_currentIndex = current;
+        emit currentIndexChanged();
+        if (m_currentIndex >= 0 && !m_moving) {
+            setContentOffset(calculateItemPosition(m_currentIndex));
+        }
+    }
+
+    onModelCountChanged();
 }
 
 void PagedView::onAnimationFinished()
@@ -365,38 +478,154 @@ void PagedView::updateLayout()
         return;
     }
 
-    // Clear existing items
-    for (QQuickItem *item : m_items) {
-        if (item) {
-            if (m_delegateModel) {
-                // Release the item back to the delegate model
-                m_delegateModel->release(item);
-            } else {
-                item->setParentItem(nullptr);
-                item->deleteLater();
+    int startIndex = qMax(0, m_currentIndex - m_cacheSize);
+    int endIndex = qMin(m_count - 1, m_currentIndex + m_cacheSize);
+
+    // Release only the items that left the window.
+    for (auto it = m_items.begin(); it != m_items.end();) {
+        if (it.key() < startIndex || it.key() > endIndex) {
+            destroyItem(it.value());
+            it = m_items.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (auto it = m_incubating.begin(); it != m_incubating.end();) {
+        if (*it < startIndex || *it > endIndex) {
+            it = m_incubating.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // Create the items that entered it, nearest to the current index first as
+    // incubation completes in request order. Neighbours incubate over the
+    // following frames, only the pages in view are completed immediately.
+    const int center = qBound(startIndex, m_currentIndex, endIndex);
+    for (int distance = 0; center - distance >= startIndex || center + distance <= endIndex; ++distance) {
+        const int indices[] = { center - distance, center + distance };
+        for (int n = distance == 0 ? 1 : 0; n < 2; ++n) {
+            const int i = indices[n];
+            if (i < startIndex || i > endIndex || m_items.contains(i)) {
+                continue;
+            }
+            const bool immediate = i == m_currentIndex || isIndexExposed(i);
+            if (QQuickItem *item = createItem(i, immediate ? QQmlIncubator::Synchronous : QQmlIncubator::Asynchronous)) {
+                m_items.insert(i, item);
             }
         }
     }
-    m_items.clear();
 
-    // Create items for visible range
-    int startIndex = qMax(0, m_currentIndex - m_cacheSize);
-    int endIndex = qMin(m_count - 1, m_currentIndex + m_cacheSize);
+    relayoutItems();
+    updateCurrentItem();
+    updateReady();
+}
 
-    for (int i = startIndex; i <= endIndex; ++i) {
-        QQuickItem *item = createItem(i);
-        if (item) {
-            m_items.append(item);
-            positionItem(item, i);
-            updateAttachedProperties(item, i);
+void PagedView::onItemCreated(int index, QObject *object)
+{
+    Q_UNUSED(object)
+
+    // Items that left the window meanwhile are destroyed by the delegate model
+    // as nothing references them.
+    if (!m_incubating.contains(index)) {
+        return;
+    }
+
+    // Take a reference now that the item is complete.
+    if (QQuickItem *item = createItem(index, QQmlIncubator::Synchronous)) {
+        insertItem(index, item);
+    }
+    updateReady();
+}
+
+void PagedView::insertItem(int index, QQuickItem *item)
+{
+    m_items.insert(index, item);
+    positionItem(item, index);
+    updateAttachedProperties(item, index);
+    updateCurrentItem();
+    updateExposedItems();
+    emit itemReady(index);
+}
+
+void PagedView::ensureExposedItems()
+{
+    // A page scrolling into view can not wait for its turn to incubate.
+    const QList<int> incubating = m_incubating.values();
+    bool created = false;
+    for (int index : incubating) {
+        if (isIndexExposed(index)) {
+            if (QQuickItem *item = createItem(index, QQmlIncubator::Synchronous)) {
+                insertItem(index, item);
+                created = true;
+            }
         }
     }
+    if (created) {
+        updateReady();
+    }
+}
 
+bool PagedView::isIndexExposed(int index) const
+{
+    const qreal position = calculateItemPosition(index) - m_contentOffset;
+    const qreal size = m_direction == LTR || m_direction == RTL ? width() : height();
+    return size > 0 && position < size && position + size > 0;
+}
+
+void PagedView::updateReady()
+{
+    const bool ready = m_incubating.isEmpty();
+    if (m_ready != ready) {
+        m_ready = ready;
+        emit readyChanged();
+    }
+}
+
+void PagedView::relayoutItems()
+{
     updateContentSize();
-    updateCurrentItem();
+    for (auto it = m_items.constBegin(); it != m_items.constEnd(); ++it) {
+        positionItem(it.value(), it.key());
+        updateAttachedProperties(it.value(), it.key());
+    }
     updateExposedItems();
 }
 
+void PagedView::releaseItems()
+{
+    for (QQuickItem *item : m_items) {
+        destroyItem(item);
+    }
+    m_items.clear();
+    m_incubating.clear();
+    updateCurrentItem();
+    updateReady();
+}
+
+QMap<int, QQuickItem *> PagedView::takeItems(int index, int count)
+{
+    QMap<int, QQuickItem *> taken;
+    for (auto it = m_items.lowerBound(index); it != m_items.end() && it.key() < index + count;) {
+        taken.insert(it.key(), it.value());
+        it = m_items.erase(it);
+    }
+    return taken;
+}
+
+// Moves the items at or after index by delta.
+void PagedView::shiftItems(int index, int delta)
+{
+    if (delta == 0) {
+        return;
+    }
+    const QMap<int, QQuickItem *> shifted = takeItems(index, INT_MAX - index);
+    for (auto it = shifted.begin(); it != shifted.end(); ++it) {
+        m_items.insert(it.key() + delta, it.value());
+    }
+}
+
 void PagedView::updateCurrentItem()
 {
     QQuickItem *newCurrentItem = itemAt(m_currentIndex);
@@ -433,7 +662,7 @@ void PagedView::destroyContentItem()
     }
 }
 
-QQuickItem *PagedView::createItem(int index)
+QQuickItem *PagedView::createItem(int index, QQmlIncubator::IncubationMode mode)
 {
     if (!m_delegate) {
         return nullptr;
@@ -447,10 +676,27 @@ QQuickItem *PagedView::createItem(int index)
     QQuickItem *item = nullptr;
 
     if (m_delegateModel) {
-        // Use QQmlDelegateModel to create the item
-        item = qobject_cast<QQuickItem*>(m_delegateModel->object(index, QQmlIncubator::AsynchronousIfNested));
+        // Asynchronous incubation only progresses with an incubation controller,
+        // the window's one incubates in the time left over in each frame.
+        QQmlEngine *engine = qmlEngine(this);
+        if (engine && !engine->incubationController() && window()) {
+            engine->setIncubationController(window()->incubationController());
+        }
+        if (mode == QQmlIncubator::Asynchronous && !(engine && engine->incubationController())) {
+            mode = QQmlIncubator::AsynchronousIfNested;
+        }
+
+        // Completing an incubation emits createdItem(), which must not take
+        // another reference.
+        m_incubating.remove(index);
+        QObject *object = m_delegateModel->object(index, mode);
+        item = qobject_cast<QQuickItem*>(object);
         if (item) {
             item->setParentItem(m_contentItem);
+        } else if (object) {
+            m_delegateModel->release(object);
+        } else {
+            m_incubating.insert(index);
         }
     } else {
         // Fallback: create item directly from delegate
@@ -475,7 +721,20 @@ QQuickItem *PagedView::createItem(int index)
 
 void PagedView::destroyItem(QQuickItem *item)
 {
-    if (item) {
+    if (!item) {
+        return;
+    }
+    PagedViewAttached *attached = qobject_cast<PagedViewAttached*>(qmlAttachedPropertiesObject<PagedView>(item, false));
+    if (attached) {
+        attached->setInCache(false);
+    }
+
+    if (m_delegateModel) {
+        // Release the item back to the delegate model, which may keep it.
+        if (!(m_delegateModel->release(item) & QQmlInstanceModel::Destroyed)) {
+            item->setParentItem(nullptr);
+        }
+    } else {
         item->setParentItem(nullptr);
         item->deleteLater();
     }
@@ -503,10 +762,8 @@ void PagedView::positionItem(QQuickItem *item, int index)
 
 void PagedView::updateItemPositions()
 {
-    for (int i = 0; i < m_items.size(); ++i) {
-        if (m_items[i]) {
-            positionItem(m_items[i], i);
-        }
+    for (auto it = m_items.constBegin(); it != m_items.constEnd(); ++it) {
+        positionItem(it.value(), it.key());
     }
 }
 
@@ -676,6 +933,7 @@ void PagedView::updateAttachedProperties(QQuickItem *item, int index)
         attached->setDirection(m_direction);
         attached->setIsCurrentItem(index == m_currentIndex);
         attached->setExposed(isItemVisible(item));
+        attached->setInCache(true);
     }
 }
 
@@ -732,3 +990,11 @@ void PagedViewAttached::setExposed(bool exposed)
         emit exposedChanged();
     }
 }
+
+void PagedViewAttached::setInCache(bool inCache)
+{
+    if (m_inCache != inCache) {
+        m_inCache = inCache;
+        emit inCacheChanged();
+    }
+}
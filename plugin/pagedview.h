@@ -5,13 +5,17 @@
 
 #include <silicacontrol.h>
 #include <QQmlComponent>
+#include <QQmlIncubator>
 #include <QQmlListProperty>
 #include <QQuickItem>
 #include <QPropertyAnimation>
 #include <QTimer>
 #include <QPointF>
+#include <QMap>
+#include <QSet>
 #include <qqml.h>
 
+class QQmlChangeSet;
 class QQmlDelegateModel;
 class PagedViewAttached;
 
@@ -39,6 +43,7 @@ class PagedView : public Silica::Control
     Q_PROPERTY(int cacheSize READ cacheSize WRITE setCacheSize NOTIFY cacheSizeChanged)
     Q_PROPERTY(QQmlListProperty<QObject> exposedItems READ exposedItems NOTIFY exposedItemsChanged)
     Q_PROPERTY(qreal contentOffset READ contentOffset WRITE setContentOffset NOTIFY contentOffsetChanged)
+    Q_PROPERTY(bool ready READ ready NOTIFY readyChanged)
 
 public:
     enum Direction {
@@ -102,9 +107,12 @@ public:
     QQmlListProperty<QObject> exposedItems();
     qreal contentOffset() const { return m_contentOffset; }
     void setContentOffset(qreal offset);
+    // False while delegates within the cache window are still incubating.
+    bool ready() const { return m_ready; }
 
     Q_INVOKABLE void moveTo(int index, int transition = Animated);
     Q_INVOKABLE QQuickItem *itemAt(int index);
+    Q_INVOKABLE bool isItemReady(int index) const { return m_items.contains(index); }
 
     static PagedViewAttached *qmlAttachedProperties(QObject *object);
 
@@ -130,6 +138,8 @@ Q_SIGNALS:
     void cacheSizeChanged();
     void exposedItemsChanged();
     void contentOffsetChanged();
+    void readyChanged();
+    void itemReady(int index);
 
 protected:
     void componentComplete() override;
@@ -145,15 +155,25 @@ private slots:
     void onModelRowsInserted(int index, int count);
     void onModelRowsRemoved(int index, int count);
     void onModelRowsMoved(int from, int to, int count);
+    void onModelUpdated(const QQmlChangeSet &changeSet, bool reset);
+    void onItemCreated(int index, QObject *object);
     void onAnimationFinished();
 
 private:
     void updateLayout();
+    void relayoutItems();
+    void releaseItems();
+    QMap<int, QQuickItem *> takeItems(int index, int count);
+    void shiftItems(int index, int delta);
     void updateCurrentItem();
     void updateExposedItems();
     void createContentItem();
     void destroyContentItem();
-    QQuickItem *createItem(int index);
+    QQuickItem *createItem(int index, QQmlIncubator::IncubationMode mode);
+    void insertItem(int index, QQuickItem *item);
+    void ensureExposedItems();
+    bool isIndexExposed(int index) const;
+    void updateReady();
     void destroyItem(QQuickItem *item);
     void positionItem(QQuickItem *item, int index);
     void updateItemPositions();
@@ -191,7 +211,12 @@ private:
 
     // Private implementation details
     QQmlDelegateModel *m_delegateModel = nullptr;
-    QList<QQuickItem*> m_items;
+    // Instantiated items by model index, covering at most the cacheSize window
+    // around the current index.
+    QMap<int, QQuickItem *> m_items;
+    // Indices requested from the delegate model that are still incubating.
+    QSet<int> m_incubating;
+    bool m_ready = true;
     QPropertyAnimation *m_animation = nullptr;
     QPointF m_pressPos;
     QPointF m_lastPos;
@@ -213,6 +238,7 @@ class PagedViewAttached : public QObject
     Q_PROPERTY(qreal contentHeight READ contentHeight NOTIFY contentHeightChanged)
     Q_PROPERTY(bool isCurrentItem READ isCurrentItem NOTIFY isCurrentItemChanged)
     Q_PROPERTY(bool exposed READ exposed NOTIFY exposedChanged)
+    Q_PROPERTY(bool inCache READ inCache NOTIFY inCacheChanged)
 
 public:
     explicit PagedViewAttached(QObject *parent = nullptr);
@@ -229,6 +255,8 @@ public:
     void setIsCurrentItem(bool current);
     bool exposed() const { return m_exposed; }
     void setExposed(bool exposed);
+    bool inCache() const { return m_inCache; }
+    void setInCache(bool inCache);
 
 Q_SIGNALS:
     void directionChanged();
@@ -237,6 +265,7 @@ Q_SIGNALS:
     void contentHeightChanged();
     void isCurrentItemChanged();
     void exposedChanged();
+    void inCacheChanged();
 
 private:
     PagedView::Direction m_direction = PagedView::LTR;
@@ -245,6 +274,7 @@ private:
     qreal m_contentHeight = 0.0;
     bool m_isCurrentItem = false;
     bool m_exposed = false;
+    bool m_inCache = false;
 };
 
 QML_DECLARE_TYPEINFO(PagedView, QML_HAS_ATTACHED_PROPERTIES)
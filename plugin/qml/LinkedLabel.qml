@@ -46,7 +46,7 @@ SilicaText {
     color: palette.highlightColor
     linkColor: palette.primaryColor
     font.pixelSize: Theme.fontSizeMedium
-    text: parser.linkedText.replace(/\n/g, '<br>')
+    text: parser.linkedText
     textFormat: Text.StyledText
     wrapMode: Text.Wrap
 
@@ -58,6 +58,5 @@ SilicaText {
 
     LinkParser {
         id: parser
-        text: root.text
     }
 }
@@ -55,50 +55,37 @@
 
 import QtQuick 2.0
 import Sailfish.Silica 1.0
+import Sailfish.Silica.private 1.0 as Private
 
-Row {
-    property real time
-    property int frame
-    property real fps
+Private.FrameRate {
+    id: monitor
+
+    width: Theme.itemSizeHuge * 2
+    height: Theme.itemSizeSmall
+    running: Qt.application.active
 
-    spacing: Math.round(Theme.paddingSmall/2)
     anchors {
         bottom: parent.bottom
         right: parent.right
         margins: Theme.paddingLarge
     }
 
-    onTimeChanged: {
-        update() // force continuous animation
-        ++frame
-    }
-
-    NumberAnimation on time {
-        running: Qt.application.active
-        from: 0
-        to: 100
-        loops: Animation.Infinite
-    }
-
-    Timer {
-        repeat: true
-        interval: 1000
-        running: Qt.application.active
-        onTriggered: {
-            label.text = fps
-            fps = frame
-            frame = 0
+    Row {
+        spacing: Math.round(Theme.paddingSmall/2)
+        anchors {
+            top: parent.top
+            left: parent.left
         }
-    }
 
-    Label {
-        id: label
-        font.pixelSize: Theme.fontSizeSmall
-    }
-    Label {
-        text: "FPS"
-        font.pixelSize: Theme.fontSizeTiny
-        anchors.baseline: label.baseline
+        Label {
+            id: label
+            text: Math.round(monitor.fps)
+            font.pixelSize: Theme.fontSizeSmall
+        }
+        Label {
+            text: "FPS  p95 " + monitor.frameTime95.toFixed(1) + " ms  jank " + monitor.jankCount
+            font.pixelSize: Theme.fontSizeTiny
+            anchors.baseline: label.baseline
+        }
     }
 }
-
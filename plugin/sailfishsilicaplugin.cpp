@@ -68,6 +68,7 @@
 
 #include "linegraph.h"
 #include "lineitem.h"
+#include "linkparser.h"
 #include "declarativeglassitem.h"
 #include "minversemousearea.h"
 #include "notice.h"
@@ -182,6 +183,7 @@ public:
             qmlRegisterType<ApplicationBackground>(uri, 1, 0, "ApplicationBackground");
             qmlRegisterType<DeclarativeCoverActionArea>(uri, 1, 0, "CoverActionArea");
             qmlRegisterType<DeclarativeCoverWindow>(uri, 1, 0, "CoverWindow");
+            qmlRegisterType<DeclarativeFrameRate>(uri, 1, 0, "FrameRate");
             qmlRegisterType<DeclarativePreeditText>(uri, 1, 0, "PreeditText");
             qmlRegisterType<DeclarativeQuickScrollButtonBase>(uri, 1, 0, "QuickScrollButtonBase");
             qmlRegisterType<DeclarativeTextBaseItem>(uri, 1, 0, "TextBaseItem");
@@ -193,6 +195,7 @@ public:
             qmlRegisterType<DrawingArea>(uri, 1, 0, "DrawingArea");
             qmlRegisterType<LineGraph>(uri, 1, 0, "LineGraph");
             qmlRegisterType<LineItem>(uri, 1, 0, "LineItem");
+            qmlRegisterType<LinkParser>(uri, 1, 0, "LinkParser");
             qmlRegisterType<Silica::ThemeTransaction>(uri, 1, 0, "ThemeTransaction");
 
             // Private uncreatable types
@@ -228,6 +231,9 @@ public:
         // Expose useful context properties for QML
         engine->rootContext()->setContextProperty("screen", Silica::Screen::instance());
         engine->rootContext()->setContextProperty("_defaultLabelFormat", Qt::PlainText);
+
+        // Re-evaluates time bindings when the system time zone changes
+        new TimezoneUpdater(engine, engine);
     }
 };
 
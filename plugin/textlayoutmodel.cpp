@@ -1,19 +1,62 @@
 // SPDX-License-Identifier: LGPL-2.1-only
 
 #include "textlayoutmodel.h"
+#include <QCache>
 #include <QTextLayout>
 #include <QTextOption>
+#include <QTimerEvent>
+#include <QtConcurrent>
+
+namespace {
+
+// Shaped layouts shared by all models, so that recreated delegates and views
+// showing the same text do not shape it again.
+const int LayoutCacheSize = 64;
+typedef QCache<TextLayoutKey, QList<TextLineInfo>> LayoutCache;
+Q_GLOBAL_STATIC_WITH_ARGS(LayoutCache, layoutCache, (LayoutCacheSize))
+
+}
+
+bool TextLineInfo::operator==(const TextLineInfo &other) const
+{
+    return lineNumber == other.lineNumber
+            && length == other.length
+            && elided == other.elided
+            && qFuzzyCompare(width, other.width)
+            && qFuzzyCompare(height, other.height)
+            && text == other.text;
+}
+
+bool TextLayoutKey::operator==(const TextLayoutKey &other) const
+{
+    return width == other.width
+            && wrapMode == other.wrapMode
+            && maximumLineCount == other.maximumLineCount
+            && font == other.font
+            && text == other.text;
+}
+
+uint qHash(const TextLayoutKey &key, uint seed)
+{
+    uint hash = qHash(key.text, seed);
+    hash = 31 * hash + qHash(key.font, seed);
+    hash = 31 * hash + qHash(key.width);
+    hash = 31 * hash + uint(key.wrapMode);
+    hash = 31 * hash + uint(key.maximumLineCount);
+    return hash;
+}
 
 TextLayoutModel::TextLayoutModel(QObject *parent)
     : QAbstractListModel(parent)
 {
+    connect(&m_watcher, &QFutureWatcherBase::finished, this, &TextLayoutModel::layoutFinished);
 }
 
 void TextLayoutModel::setText(const QString &text)
 {
     if (m_text != text) {
         m_text = text;
-        updateLayout();
+        scheduleLayout();
         emit textChanged();
     }
 }
@@ -22,7 +65,7 @@ void TextLayoutModel::setFont(const QFont &font)
 {
     if (m_font != font) {
         m_font = font;
-        updateLayout();
+        scheduleLayout();
         emit fontChanged();
     }
 }
@@ -31,7 +74,7 @@ void TextLayoutModel::setWidth(qreal width)
 {
     if (!qFuzzyCompare(m_width, width)) {
         m_width = width;
-        updateLayout();
+        scheduleLayout();
         emit widthChanged();
     }
 }
@@ -40,7 +83,7 @@ void TextLayoutModel::setWrapMode(int mode)
 {
     if (m_wrapMode != mode) {
         m_wrapMode = mode;
-        updateLayout();
+        scheduleLayout();
         emit wrapModeChanged();
     }
 }
@@ -49,11 +92,26 @@ void TextLayoutModel::setMaximumLineCount(int count)
 {
     if (m_maximumLineCount != count) {
         m_maximumLineCount = count;
-        updateLayout();
+        scheduleLayout();
         emit maximumLineCountChanged();
     }
 }
 
+void TextLayoutModel::setAsynchronous(bool asynchronous)
+{
+    if (m_asynchronous != asynchronous) {
+        m_asynchronous = asynchronous;
+        emit asynchronousChanged();
+    }
+}
+
+void TextLayoutModel::forceLayout()
+{
+    if (m_layoutTimer.isActive()) {
+        updateLayout();
+    }
+}
+
 int TextLayoutModel::rowCount(const QModelIndex &parent) const
 {
     if (parent.isValid()) {
@@ -100,22 +158,146 @@ QHash<int, QByteArray> TextLayoutModel::roleNames() const
     return roles;
 }
 
+void TextLayoutModel::classBegin()
+{
+    m_complete = false;
+}
+
+void TextLayoutModel::componentComplete()
+{
+    // Lay out the initial property values at once, so views see the lines
+    // as soon as they are bound to the model.
+    m_complete = true;
+    updateLayout();
+}
+
+void TextLayoutModel::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() == m_layoutTimer.timerId()) {
+        updateLayout();
+        return;
+    }
+    QAbstractListModel::timerEvent(event);
+}
+
+TextLayoutKey TextLayoutModel::layoutKey() const
+{
+    TextLayoutKey key;
+    key.text = m_text;
+    key.font = m_font;
+    key.width = m_width;
+    key.wrapMode = m_wrapMode;
+    key.maximumLineCount = m_maximumLineCount;
+    return key;
+}
+
+void TextLayoutModel::scheduleLayout()
+{
+    if (m_complete && !m_layoutTimer.isActive()) {
+        m_layoutTimer.start(0, this);
+    }
+}
+
 void TextLayoutModel::updateLayout()
 {
-    beginResetModel();
-    m_lines.clear();
+    m_layoutTimer.stop();
+
+    const TextLayoutKey key = layoutKey();
+
+    if (const QList<TextLineInfo> *lines = layoutCache->object(key)) {
+        setLines(*lines);
+        setBusy(false);
+    } else if (m_asynchronous && key.text.length() >= AsynchronousTextLength) {
+        // The previous lines are kept until the new layout is ready.
+        if (!m_watcher.isRunning() || !(m_runningKey == key)) {
+            m_runningKey = key;
+            m_watcher.setFuture(QtConcurrent::run(&TextLayoutModel::layoutLines, key));
+        }
+        setBusy(true);
+    } else {
+        QList<TextLineInfo> *lines = new QList<TextLineInfo>(layoutLines(key));
+        setLines(*lines);
+        layoutCache->insert(key, lines);
+        setBusy(false);
+    }
+}
+
+void TextLayoutModel::layoutFinished()
+{
+    QList<TextLineInfo> *lines = new QList<TextLineInfo>(m_watcher.result());
+
+    // The properties may have changed again while the layout was running, in
+    // which case the result is only cached.
+    if (m_runningKey == layoutKey()) {
+        setLines(*lines);
+        setBusy(false);
+    }
+    layoutCache->insert(m_runningKey, lines);
+}
 
-    if (m_text.isEmpty() || m_width <= 0) {
-        endResetModel();
+void TextLayoutModel::setBusy(bool busy)
+{
+    if (m_busy != busy) {
+        m_busy = busy;
+        emit busyChanged();
+    }
+}
+
+// Applies a new layout as the minimal set of row changes, so that views keep
+// the delegates of lines which did not change.
+void TextLayoutModel::setLines(const QList<TextLineInfo> &lines)
+{
+    const int oldCount = m_lines.count();
+    const int newCount = lines.count();
+    const int common = qMin(oldCount, newCount);
+
+    int first = 0;
+    while (first < common && m_lines.at(first) == lines.at(first)) {
+        ++first;
+    }
+    int last = common - 1;
+    while (last >= first && m_lines.at(last) == lines.at(last)) {
+        --last;
+    }
+
+    if (newCount < oldCount) {
+        beginRemoveRows(QModelIndex(), newCount, oldCount - 1);
+        m_lines.erase(m_lines.begin() + newCount, m_lines.end());
+        endRemoveRows();
+    }
+
+    if (first <= last) {
+        for (int i = first; i <= last; ++i) {
+            m_lines[i] = lines.at(i);
+        }
+        emit dataChanged(index(first), index(last));
+    }
+
+    if (newCount > oldCount) {
+        beginInsertRows(QModelIndex(), oldCount, newCount - 1);
+        m_lines.append(lines.mid(oldCount));
+        endInsertRows();
+    }
+
+    if (newCount != oldCount) {
         emit lineCountChanged();
-        return;
+    }
+}
+
+// Called from worker threads in asynchronous mode, so must only use the key.
+QList<TextLineInfo> TextLayoutModel::layoutLines(const TextLayoutKey &key)
+{
+    QList<TextLineInfo> lines;
+
+    if (key.text.isEmpty() || key.width <= 0) {
+        return lines;
     }
 
-    QTextLayout layout(m_text, m_font);
+    QTextLayout layout(key.text, key.font);
     QTextOption option;
 
     // Set wrap mode
-    switch (m_wrapMode) {
+    switch (key.wrapMode) {
     case 1: // WordWrap
         option.setWrapMode(QTextOption::WordWrap);
         break;
@@ -133,18 +315,18 @@ void TextLayoutModel::updateLayout()
     int lineNumber = 0;
     QTextLine line = layout.createLine();
 
-    while (line.isValid() && (m_maximumLineCount == -1 || lineNumber < m_maximumLineCount)) {
-        line.setLineWidth(m_width);
+    while (line.isValid() && (key.maximumLineCount == -1 || lineNumber < key.maximumLineCount)) {
+        line.setLineWidth(key.width);
 
         TextLineInfo lineInfo;
         lineInfo.lineNumber = lineNumber;
-        lineInfo.text = m_text.mid(line.textStart(), line.textLength());
+        lineInfo.text = key.text.mid(line.textStart(), line.textLength());
         lineInfo.length = line.textLength();
         lineInfo.width = line.naturalTextWidth();
         lineInfo.height = line.height();
         lineInfo.elided = false;
 
-        m_lines.append(lineInfo);
+        lines.append(lineInfo);
 
         lineNumber++;
         line = layout.createLine();
@@ -153,12 +335,11 @@ void TextLayoutModel::updateLayout()
     layout.endLayout();
 
     // Check if we need to elide the last line
-    if (m_maximumLineCount > 0 && m_lines.size() >= m_maximumLineCount && line.isValid()) {
-        if (!m_lines.isEmpty()) {
-            m_lines.last().elided = true;
+    if (key.maximumLineCount > 0 && lines.size() >= key.maximumLineCount && line.isValid()) {
+        if (!lines.isEmpty()) {
+            lines.last().elided = true;
         }
     }
 
-    endResetModel();
-    emit lineCountChanged();
+    return lines;
 }
@@ -4,7 +4,10 @@
 #define SAILFISH_SILICA_PLUGIN_TEXTLAYOUTMODEL_H
 
 #include <QAbstractListModel>
+#include <QBasicTimer>
 #include <QFont>
+#include <QFutureWatcher>
+#include <QQmlParserStatus>
 #include <QTextLayout>
 #include <QList>
 
@@ -15,17 +18,36 @@ struct TextLineInfo {
     qreal width;
     qreal height;
     bool elided;
+
+    bool operator==(const TextLineInfo &other) const;
+    bool operator!=(const TextLineInfo &other) const { return !(*this == other); }
+};
+
+// Everything a layout depends on, used to look up previously shaped layouts.
+struct TextLayoutKey {
+    QString text;
+    QFont font;
+    qreal width = 0.0;
+    int wrapMode = 0;
+    int maximumLineCount = -1;
+
+    bool operator==(const TextLayoutKey &other) const;
 };
 
-class TextLayoutModel : public QAbstractListModel
+uint qHash(const TextLayoutKey &key, uint seed = 0);
+
+class TextLayoutModel : public QAbstractListModel, public QQmlParserStatus
 {
     Q_OBJECT
+    Q_INTERFACES(QQmlParserStatus)
     Q_PROPERTY(QString text READ text WRITE setText NOTIFY textChanged)
     Q_PROPERTY(QFont font READ font WRITE setFont NOTIFY fontChanged)
     Q_PROPERTY(qreal width READ width WRITE setWidth NOTIFY widthChanged)
     Q_PROPERTY(int wrapMode READ wrapMode WRITE setWrapMode NOTIFY wrapModeChanged)
     Q_PROPERTY(int maximumLineCount READ maximumLineCount WRITE setMaximumLineCount NOTIFY maximumLineCountChanged)
     Q_PROPERTY(int lineCount READ lineCount NOTIFY lineCountChanged)
+    Q_PROPERTY(bool asynchronous READ asynchronous WRITE setAsynchronous NOTIFY asynchronousChanged)
+    Q_PROPERTY(bool busy READ busy NOTIFY busyChanged)
 
 public:
     enum Roles {
@@ -51,11 +73,27 @@ public:
     void setMaximumLineCount(int count);
     int lineCount() const { return rowCount(); }
 
+    // When set, texts of at least AsynchronousTextLength characters are shaped
+    // on a worker thread and the previous lines are kept until the new ones are
+    // ready.
+    bool asynchronous() const { return m_asynchronous; }
+    void setAsynchronous(bool asynchronous);
+    bool busy() const { return m_busy; }
+
+    // Property changes are laid out together once control returns to the event
+    // loop. This lays out pending changes at once, e.g. to read lineCount right
+    // after setting properties from JavaScript.
+    Q_INVOKABLE void forceLayout();
+
     // QAbstractListModel interface
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
     QHash<int, QByteArray> roleNames() const override;
 
+    // QQmlParserStatus interface
+    void classBegin() override;
+    void componentComplete() override;
+
 Q_SIGNALS:
     void textChanged();
     void fontChanged();
@@ -63,16 +101,37 @@ Q_SIGNALS:
     void wrapModeChanged();
     void maximumLineCountChanged();
     void lineCountChanged();
+    void asynchronousChanged();
+    void busyChanged();
+
+protected:
+    void timerEvent(QTimerEvent *event) override;
 
 private:
+    enum { AsynchronousTextLength = 2000 };
+
+    static QList<TextLineInfo> layoutLines(const TextLayoutKey &key);
+
+    TextLayoutKey layoutKey() const;
+    void scheduleLayout();
     void updateLayout();
+    void layoutFinished();
+    void setBusy(bool busy);
+    void setLines(const QList<TextLineInfo> &lines);
 
     QString m_text;
     QFont m_font;
     qreal m_width = 0.0;
     int m_wrapMode = 0;
     int m_maximumLineCount = -1;
+    bool m_asynchronous = false;
+    bool m_complete = true;
+    bool m_busy = false;
     QList<TextLineInfo> m_lines;
+    // Coalesces property changes into a single layout pass.
+    QBasicTimer m_layoutTimer;
+    QFutureWatcher<QList<TextLineInfo>> m_watcher;
+    TextLayoutKey m_runningKey;
 };
 
 #endif // SAILFISH_SILICA_PLUGIN_TEXTLAYOUTMODEL_H
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: LGPL-2.1-only
 
 #include "timezoneupdater.h"
+#include "declarativedatetime.h"
 #include <QQmlEngine>
 #include <QTimeZone>
 
@@ -9,9 +10,8 @@ TimezoneUpdater::TimezoneUpdater(QQmlEngine *engine, QObject *parent)
     , m_engine(engine)
     , m_lastTimezone(QTimeZone::systemTimeZoneId())
 {
-    // Note: In a real implementation, this would connect to Maemo::Timed::WallClock
-    // For now, we'll use a simplified approach that monitors system timezone changes
-    // via QTimeZone::systemTimeZoneId()
+    // The shared wall clock checks the system time zone on its minute ticks.
+    connect(WallClock::instance(), &WallClock::timeZoneChanged, this, &TimezoneUpdater::onTimezoneChanged);
 }
 
 TimezoneUpdater::~TimezoneUpdater()